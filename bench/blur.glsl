@@ -0,0 +1,31 @@
+#version 430
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#include <microcompute/swizzle.glsl>
+
+layout(std430, binding = 0) buffer srcBuff {
+    float src[];
+};
+
+layout(std430, binding = 1) buffer dstBuff {
+    float dst[];
+};
+
+// a cross shaped box filter, the column reads of neighbouring workgroups only
+// hit the caches if those workgroups run at about the same time
+#define RADIUS 8
+
+void main(void) {
+    ivec2 pos = ivec2(mc_global_invocation_id());
+    ivec2 size = ivec2(gl_NumWorkGroups.xy * gl_WorkGroupSize.xy);
+
+    float sum = 0.0;
+    for (int d = -RADIUS; d <= RADIUS; d++) {
+        ivec2 v = clamp(pos + ivec2(0, d), ivec2(0), size - 1);
+        ivec2 h = clamp(pos + ivec2(d, 0), ivec2(0), size - 1);
+        sum += src[v.y * size.x + v.x] + src[h.y * size.x + h.x];
+    }
+
+    dst[pos.y * size.x + pos.x] = sum / float(4 * RADIUS + 2);
+}
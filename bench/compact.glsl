@@ -0,0 +1,21 @@
+#version 430
+
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) buffer optBuff {
+    uint threshold;
+};
+
+layout(std430, binding = 1) buffer keyBuff {
+    uint keys[];
+};
+
+layout(std430, binding = 2) buffer outBuff {
+    uint count;
+    uint values[];
+};
+
+void main(void) {
+    uint key = keys[gl_GlobalInvocationID.x];
+    if (key < threshold) values[atomicAdd(count, 1)] = key;
+}
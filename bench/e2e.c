@@ -0,0 +1,459 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "microcompute.h"
+#include "microcompute_extra.h"
+
+#define SHADER_DIR "../bench/"
+
+#define MAX_PROGRAMS 16
+
+// end-to-end benchmarks, using only the public api. Every benchmark reports
+// the throughput of the whole job (uploads, dispatches, readbacks, ...) and
+// the share of that time that was not spent waiting for a program to finish.
+
+typedef struct Bench {
+    double start;  // the wall clock time when the benchmark started
+    double device; // the time spent running programs, in seconds
+} Bench;
+
+static mc_Instance* instance;
+static mc_Device* dev;
+static mc_ProgramCode* codes[MAX_PROGRAMS];
+static uint32_t codeCount = 0;
+
+static mc_Program* load_program(const char* path, const char* name) {
+    char* source = read_file(path, NULL);
+    mc_ProgramCode* code
+        = mc_program_code_create_from_glsl(instance, name, source, "main");
+    free(source);
+    if (!code) return NULL;
+
+    codes[codeCount++] = code;
+    return mc_program_create(dev, code);
+}
+
+// same as load_program(), compiled for swizzled launches
+static mc_Program* load_swizzled_program(const char* path, const char* name) {
+    char* source = read_file(path, NULL);
+    mc_ProgramCode* code = mc_program_code_create_from_glsl(
+        instance,
+        name,
+        source,
+        "main",
+        (mc_CompileDefinition){"MC_SWIZZLE", "1"}
+    );
+    free(source);
+    if (!code) return NULL;
+
+    codes[codeCount++] = code;
+    return mc_program_create(dev, code);
+}
+
+static Bench bench_start(void) {
+    return (Bench){.start = mc_get_time(), .device = 0.0};
+}
+
+static void bench_report(Bench* b, const char* name, double n, char* unit) {
+    double wall = mc_get_time() - b->start;
+    double overhead = wall > 0.0 ? 1.0 - b->device / wall : 0.0;
+    printf(
+        "%-28s %10.2f ms %12.2f M%s/s   host overhead: %5.1f%%\n",
+        name,
+        wall * 1000.0,
+        n / wall / 1e6,
+        unit,
+        overhead * 100.0
+    );
+}
+
+// ==== mandelbrot ========================================================== //
+
+struct MandelbrotOpt {
+    float center[2];
+    float zoom;
+    int maxIter;
+};
+
+static void bench_mandelbrot(mc_Program* prog, int width, int height) {
+    struct MandelbrotOpt opt = {
+        .center = {-0.7615f, -0.08459f},
+        .zoom = 1000,
+        .maxIter = 500,
+    };
+    size_t imgSize = sizeof(int) * width * height;
+    void* img = malloc(imgSize);
+
+    Bench b = bench_start();
+
+    mc_HBuffer* optBuff = mc_hybrid_buffer_create_from(dev, sizeof opt, &opt);
+    mc_HBuffer* imgBuff = mc_hybrid_buffer_create(dev, imgSize);
+    b.device += mc_program_run(prog, width, height, 1, optBuff, imgBuff);
+    mc_hybrid_buffer_read(imgBuff, 0, imgSize, img);
+    mc_hybrid_buffer_destroy(optBuff);
+    mc_hybrid_buffer_destroy(imgBuff);
+
+    char name[64];
+    snprintf(name, sizeof name, "mandelbrot %dx%d", width, height);
+    bench_report(&b, name, (double)width * height, "px");
+
+    free(img);
+}
+
+// ==== ping-pong stencil =================================================== //
+
+typedef enum StencilMode {
+    STENCIL_RUN,      // one mc_program_run() per iteration
+    STENCIL_PREPARED, // one mc_dispatch_submit() per iteration
+    STENCIL_ITERATE,  // a single mc_program_iterate()
+} StencilMode;
+
+static void bench_stencil(
+    mc_Program* prog,
+    int size,
+    int iterations,
+    StencilMode mode
+) {
+    size_t gridSize = sizeof(float) * size * size;
+    float* grid = malloc(gridSize);
+    for (int i = 0; i < size * size; i++) grid[i] = (float)(i % size == 0);
+
+    Bench b = bench_start();
+
+    mc_HBuffer* buffs[2] = {
+        mc_hybrid_buffer_create_from(dev, gridSize, grid),
+        mc_hybrid_buffer_create(dev, gridSize),
+    };
+
+    mc_Buffer* ping[] = {(mc_Buffer*)buffs[0], (mc_Buffer*)buffs[1]};
+    mc_Buffer* pong[] = {(mc_Buffer*)buffs[1], (mc_Buffer*)buffs[0]};
+    int wgCount = size / 8;
+
+    if (mode == STENCIL_ITERATE) {
+        b.device += mc_program_iterate(
+            prog,
+            wgCount,
+            wgCount,
+            1,
+            iterations,
+            2,
+            ping,
+            pong,
+            NULL,
+            0,
+            NULL
+        );
+    } else if (mode == STENCIL_PREPARED) {
+        mc_Dispatch* dispatches[2] = {
+            mc_program_prepare(prog, wgCount, wgCount, 1, 2, ping),
+            mc_program_prepare(prog, wgCount, wgCount, 1, 2, pong),
+        };
+        for (int i = 0; i < iterations; i++)
+            b.device += mc_dispatch_submit(dispatches[i % 2]);
+        mc_dispatch_destroy(dispatches[0]);
+        mc_dispatch_destroy(dispatches[1]);
+    } else {
+        for (int i = 0; i < iterations; i++) {
+            mc_HBuffer* src = buffs[i % 2];
+            mc_HBuffer* dst = buffs[(i + 1) % 2];
+            b.device += mc_program_run(prog, wgCount, wgCount, 1, src, dst);
+        }
+    }
+
+    mc_hybrid_buffer_read(buffs[iterations % 2], 0, gridSize, grid);
+    mc_hybrid_buffer_destroy(buffs[0]);
+    mc_hybrid_buffer_destroy(buffs[1]);
+
+    char name[64];
+    const char* modeNames[] = {"", " (prepared)", " (iterate)"};
+    snprintf(
+        name,
+        sizeof name,
+        "stencil %dx%d x%d%s",
+        size,
+        size,
+        iterations,
+        modeNames[mode]
+    );
+    bench_report(&b, name, (double)size * size * iterations, "cell");
+
+    free(grid);
+}
+
+// ==== 2D launch order ===================================================== //
+
+static void bench_blur(
+    mc_Program* prog,
+    int size,
+    int iterations,
+    mc_LaunchOrder order
+) {
+    size_t imgSize = sizeof(float) * size * size;
+    float* img = malloc(imgSize);
+    for (int i = 0; i < size * size; i++) img[i] = (float)(i % 251);
+
+    Bench b = bench_start();
+
+    mc_HBuffer* src = mc_hybrid_buffer_create_from(dev, imgSize, img);
+    mc_HBuffer* dst = mc_hybrid_buffer_create(dev, imgSize);
+    mc_Buffer* buffs[] = {(mc_Buffer*)src, (mc_Buffer*)dst};
+
+    int wgCount = size / 8;
+    mc_Dispatch* dispatch = mc_program_prepare_swizzled(
+        prog,
+        wgCount,
+        wgCount,
+        order,
+        8,
+        2,
+        buffs
+    );
+    for (int i = 0; i < iterations; i++)
+        b.device += mc_dispatch_submit(dispatch);
+    mc_dispatch_destroy(dispatch);
+
+    mc_hybrid_buffer_read(dst, 0, imgSize, img);
+    mc_hybrid_buffer_destroy(src);
+    mc_hybrid_buffer_destroy(dst);
+
+    char name[64];
+    const char* orderNames[] = {"raster", "grouped rows", "morton"};
+    snprintf(
+        name,
+        sizeof name,
+        "blur %dx%d x%d (%s)",
+        size,
+        size,
+        iterations,
+        orderNames[order]
+    );
+    bench_report(&b, name, (double)size * size * iterations, "px");
+
+    free(img);
+}
+
+// ==== sort + compact + reduce ============================================= //
+
+static void bench_analytics(
+    mc_Program* sort,
+    mc_Program* compact,
+    mc_Program* reduce,
+    uint32_t n
+) {
+    uint32_t* keys = malloc(sizeof *keys * n);
+    srand(1);
+    for (uint32_t i = 0; i < n; i++) keys[i] = (uint32_t)rand();
+
+    uint32_t threshold = RAND_MAX / 4;
+    uint32_t expected = 0;
+    for (uint32_t i = 0; i < n; i++)
+        if (keys[i] < threshold) expected += keys[i] & 0xffff;
+
+    Bench b = bench_start();
+
+    uint32_t zero = 0, sum = 0;
+    uint64_t outSize = sizeof(uint32_t) * (n + 1);
+    mc_HBuffer* keyBuff
+        = mc_hybrid_buffer_create_from(dev, sizeof *keys * n, keys);
+    mc_HBuffer* optBuff = mc_hybrid_buffer_create(dev, 2 * sizeof(uint32_t));
+    mc_HBuffer* outBuff = mc_hybrid_buffer_create(dev, outSize);
+    mc_HBuffer* sumBuff = mc_hybrid_buffer_create_from(dev, 4, &zero);
+
+    for (uint32_t k = 2; k <= n; k <<= 1) {
+        for (uint32_t j = k >> 1; j > 0; j >>= 1) {
+            uint32_t opt[2] = {j, k};
+            mc_hybrid_buffer_write(optBuff, 0, sizeof opt, opt);
+            b.device += mc_program_run(sort, n / 64, 1, 1, optBuff, keyBuff);
+        }
+    }
+
+    mc_hybrid_buffer_write(optBuff, 0, sizeof threshold, &threshold);
+    mc_hybrid_buffer_write(outBuff, 0, sizeof zero, &zero);
+    b.device
+        += mc_program_run(compact, n / 64, 1, 1, optBuff, keyBuff, outBuff);
+    b.device += mc_program_run(reduce, n / 64, 1, 1, outBuff, sumBuff);
+    mc_hybrid_buffer_read(sumBuff, 0, sizeof sum, &sum);
+
+    mc_hybrid_buffer_destroy(keyBuff);
+    mc_hybrid_buffer_destroy(optBuff);
+    mc_hybrid_buffer_destroy(outBuff);
+    mc_hybrid_buffer_destroy(sumBuff);
+
+    char name[64];
+    snprintf(name, sizeof name, "sort+compact+reduce %u", n);
+    bench_report(&b, name, n, "key");
+    if (sum != expected) printf("  - wrong result: %u != %u\n", sum, expected);
+
+    free(keys);
+}
+
+// ==== chunked streaming transform ========================================= //
+
+static void bench_stream(mc_Program* prog, size_t totalSize, size_t chunkSize) {
+    FILE* in = tmpfile();
+    FILE* out = tmpfile();
+    uint32_t* chunk = malloc(chunkSize);
+
+    for (size_t done = 0; done < totalSize; done += chunkSize) {
+        for (size_t i = 0; i < chunkSize / 4; i++) chunk[i] = rand();
+        fwrite(chunk, 1, chunkSize, in);
+    }
+    rewind(in);
+
+    Bench b = bench_start();
+
+    mc_HBuffer* buff = mc_hybrid_buffer_create(dev, chunkSize);
+
+    size_t size;
+    while ((size = fread(chunk, 1, chunkSize, in)) > 0) {
+        uint32_t wgCount = (uint32_t)((size / 4 + 63) / 64);
+        mc_hybrid_buffer_write(buff, 0, size, chunk);
+        b.device += mc_program_run(prog, wgCount, 1, 1, buff);
+        mc_hybrid_buffer_read(buff, 0, size, chunk);
+        fwrite(chunk, 1, size, out);
+    }
+
+    fflush(out);
+    mc_hybrid_buffer_destroy(buff);
+
+    char name[64];
+    snprintf(name, sizeof name, "stream %zuMiB", totalSize >> 20);
+    bench_report(&b, name, (double)totalSize, "B");
+
+    free(chunk);
+    fclose(in);
+    fclose(out);
+}
+
+// ==== many small independent jobs ========================================= //
+
+static void bench_batch(mc_Program* prog, uint32_t count, bool batched) {
+    uint32_t words = 1024;
+    uint32_t* data = malloc(sizeof *data * words);
+    for (uint32_t i = 0; i < words; i++) data[i] = i;
+
+    mc_Buffer** buffs = malloc(sizeof *buffs * count);
+    for (uint32_t i = 0; i < count; i++) {
+        buffs[i] = (mc_Buffer*)mc_hybrid_buffer_create_from(
+            dev,
+            sizeof *data * words,
+            data
+        );
+    }
+
+    Bench b = bench_start();
+
+    if (batched) {
+        uint32_t wgCount = words / 64;
+        b.device += mc_program_run_batch(prog, wgCount, 1, 1, 1, buffs, count);
+    } else {
+        for (uint32_t i = 0; i < count; i++)
+            b.device += mc_program_run(prog, words / 64, 1, 1, buffs[i]);
+    }
+
+    char name[64];
+    snprintf(
+        name,
+        sizeof name,
+        "%u small jobs%s",
+        count,
+        batched ? " (batched)" : ""
+    );
+    bench_report(&b, name, (double)count * words, "word");
+
+    for (uint32_t i = 0; i < count; i++)
+        mc_hybrid_buffer_destroy((mc_HBuffer*)buffs[i]);
+    free(buffs);
+    free(data);
+}
+
+// ==== main ================================================================ //
+
+static mc_Device* pick_device(int argc, char** argv) {
+    uint32_t devCount = mc_instance_get_device_count(instance);
+    mc_Device** devs = mc_instance_get_devices(instance);
+    if (devCount == 0) return NULL;
+
+    if (argc > 1) {
+        uint32_t idx = (uint32_t)atoi(argv[1]);
+        return idx < devCount ? devs[idx] : NULL;
+    }
+
+    // prefer a CPU implementation, so the results are comparable across hosts
+    for (uint32_t i = 0; i < devCount; i++)
+        if (mc_device_get_type(devs[i]) == MC_DEVICE_TYPE_CPU) return devs[i];
+
+    return devs[0];
+}
+
+int main(int argc, char** argv) {
+    instance = mc_instance_create(NULL, NULL);
+    dev = pick_device(argc, argv);
+    if (!dev) {
+        printf("no device found\n");
+        mc_instance_destroy(instance);
+        return 1;
+    }
+
+    printf(
+        "device: %s (%s)\n\n",
+        mc_device_get_name(dev),
+        mc_device_type_to_str(mc_device_get_type(dev))
+    );
+
+    mc_Program* mandelbrot = load_program(
+        "../examples/mandelbrot.glsl",
+        "mandelbrot.glsl"
+    );
+    mc_Program* stencil = load_program(SHADER_DIR "stencil.glsl", "stencil");
+    mc_Program* sort = load_program(SHADER_DIR "sort.glsl", "sort");
+    mc_Program* compact = load_program(SHADER_DIR "compact.glsl", "compact");
+    mc_Program* reduce = load_program(SHADER_DIR "reduce.glsl", "reduce");
+    mc_Program* transform
+        = load_program(SHADER_DIR "transform.glsl", "transform");
+    mc_Program* blur = load_swizzled_program(SHADER_DIR "blur.glsl", "blur");
+
+    if (!mandelbrot || !stencil || !sort || !compact || !reduce || !transform
+        || !blur) {
+        printf("failed to load programs\n");
+        return 1;
+    }
+
+    // create the pipelines up front, so that they are not part of the timings
+    mc_Program* programs[] = {
+        mandelbrot,
+        stencil,
+        sort,
+        compact,
+        reduce,
+        transform,
+        blur,
+    };
+    uint32_t buffCounts[] = {2, 2, 2, 3, 2, 1, 2};
+    mc_program_warmup_wait(mc_program_warmup(programs, buffCounts, 7));
+
+    bench_mandelbrot(mandelbrot, 640, 360);
+    bench_mandelbrot(mandelbrot, 1920, 1080);
+    bench_mandelbrot(mandelbrot, 3840, 2160);
+    bench_stencil(stencil, 512, 100, STENCIL_RUN);
+    bench_stencil(stencil, 512, 100, STENCIL_PREPARED);
+    bench_stencil(stencil, 512, 100, STENCIL_ITERATE);
+    bench_blur(blur, 2048, 10, MC_LAUNCH_ORDER_RASTER);
+    bench_blur(blur, 2048, 10, MC_LAUNCH_ORDER_GROUPED_ROWS);
+    bench_blur(blur, 2048, 10, MC_LAUNCH_ORDER_MORTON);
+    bench_analytics(sort, compact, reduce, 1 << 20);
+    bench_stream(transform, 64 << 20, 4 << 20);
+    bench_batch(transform, 256, false);
+    bench_batch(transform, 256, true);
+
+    mc_program_destroy(mandelbrot);
+    mc_program_destroy(stencil);
+    mc_program_destroy(sort);
+    mc_program_destroy(compact);
+    mc_program_destroy(reduce);
+    mc_program_destroy(transform);
+    mc_program_destroy(blur);
+    for (uint32_t i = 0; i < codeCount; i++) mc_program_code_destroy(codes[i]);
+    mc_instance_destroy(instance);
+}
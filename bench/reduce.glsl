@@ -0,0 +1,29 @@
+#version 430
+
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) buffer inBuff {
+    uint count;
+    uint values[];
+};
+
+layout(std430, binding = 1) buffer sumBuff {
+    uint sum;
+};
+
+shared uint partial[64];
+
+void main(void) {
+    uint i = gl_GlobalInvocationID.x;
+    uint lid = gl_LocalInvocationID.x;
+
+    partial[lid] = i < count ? values[i] & 0xffffu : 0u;
+    barrier();
+
+    for (uint s = 32; s > 0; s >>= 1) {
+        if (lid < s) partial[lid] += partial[lid + s];
+        barrier();
+    }
+
+    if (lid == 0) atomicAdd(sum, partial[0]);
+}
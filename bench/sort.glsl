@@ -0,0 +1,29 @@
+#version 430
+
+// one compare-and-swap step of a bitonic sort
+
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) buffer optBuff {
+    uint j;
+    uint k;
+};
+
+layout(std430, binding = 1) buffer keyBuff {
+    uint keys[];
+};
+
+void main(void) {
+    uint i = gl_GlobalInvocationID.x;
+    uint l = i ^ j;
+    if (l <= i) return;
+
+    uint a = keys[i];
+    uint b = keys[l];
+    bool ascending = (i & k) == 0;
+
+    if ((a > b) == ascending) {
+        keys[i] = b;
+        keys[l] = a;
+    }
+}
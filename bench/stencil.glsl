@@ -0,0 +1,27 @@
+#version 430
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(std430, binding = 0) buffer srcBuff {
+    float src[];
+};
+
+layout(std430, binding = 1) buffer dstBuff {
+    float dst[];
+};
+
+void main(void) {
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = ivec2(gl_NumWorkGroups.xy * gl_WorkGroupSize.xy);
+    int idx = pos.y * size.x + pos.x;
+
+    if (pos.x == 0 || pos.y == 0 || pos.x == size.x - 1
+        || pos.y == size.y - 1) {
+        dst[idx] = src[idx];
+        return;
+    }
+
+    dst[idx] = 0.25
+             * (src[idx - 1] + src[idx + 1] + src[idx - size.x]
+                + src[idx + size.x]);
+}
@@ -0,0 +1,20 @@
+#version 430
+
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) buffer dataBuff {
+    uint data[];
+};
+
+void main(void) {
+    uint x = data[gl_GlobalInvocationID.x];
+
+    // integer hash, so that the transform is not purely bandwidth bound
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+
+    data[gl_GlobalInvocationID.x] = x;
+}
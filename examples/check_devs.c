@@ -29,6 +29,7 @@ int main(void) {
         mc_Device* dev = devs[i];
         printf("=== %s ===\n", mc_device_get_name(dev));
         printf("- type: %s\n", mc_device_type_to_str(mc_device_get_type(dev)));
+        printf("- compute queues: %d\n", mc_device_get_queue_count(dev));
         printf("- testing (values should be doubled every iteration):\n");
 
         float arr[] = {0.0f, 1.0f, 2.0f, 3.0f, 4.0f};
@@ -1,4 +1,6 @@
+#include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "microcompute.h"
 #include "microcompute_extra.h"
@@ -14,7 +16,7 @@ struct Opt {
     int maxIter;
 };
 
-int main(void) {
+int main(int argc, char** argv) {
     int width = 3840, height = 2160;
     size_t imgSize = sizeof(int) * width * height;
 
@@ -42,6 +44,32 @@ int main(void) {
     double time = mc_program_run(prog, width, height, 1, optBuff, imgBuff);
     printf("compute time: %f[s]\n", time);
 
+    // per-workgroup timing, to see how unevenly the work is spread
+    if (argc > 1 && strcmp(argv[1], "--profile") == 0) {
+        mc_WgProfiler* profiler = mc_wg_profiler_create(
+            dev,
+            SHADER_PATH,
+            programSource,
+            "main",
+            2
+        );
+        mc_Buffer* buffs[] = {(mc_Buffer*)optBuff, (mc_Buffer*)imgBuff};
+        if (mc_wg_profiler_run(profiler, width, height, 1, buffs) >= 0.0) {
+            mc_WgProfileSummary s = mc_wg_profiler_get_summary(profiler);
+            printf(
+                "workgroup ticks: min %" PRIu64 ", median %" PRIu64
+                ", p99 %" PRIu64 ", max %" PRIu64 "\n",
+                s.min,
+                s.median,
+                s.p99,
+                s.max
+            );
+            printf("imbalance (max / mean): %f\n", s.imbalance);
+            mc_wg_profiler_write_heatmap(profiler, "mandelbrot_heatmap.ppm");
+        }
+        mc_wg_profiler_destroy(profiler);
+    }
+
     void* img = malloc(imgSize);
     mc_hybrid_buffer_read(imgBuff, 0, imgSize, img);
     stbi_write_png("mandelbrot.png", width, height, 4, img, width * 4);
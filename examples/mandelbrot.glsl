@@ -1,4 +1,5 @@
 #version 430
+#include <microcompute/profile.glsl>
 
 layout(std430, binding = 0) buffer optBuff {
     vec2 center;
@@ -11,6 +12,8 @@ layout(std430, binding = 1) buffer imgBuff {
 };
 
 void main(void) {
+    MC_PROFILE_BEGIN();
+
     ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
     ivec2 size = ivec2(gl_NumWorkGroups.xy);
 
@@ -30,4 +33,6 @@ void main(void) {
     ivec3 c = clamp(ivec3(shade.xxx), 0, 255);
 
     img[pos.y * size.x + pos.x] = c.r << 0 | c.g << 8 | c.b << 16 | 255 << 24;
+
+    MC_PROFILE_END();
 }
\ No newline at end of file
@@ -40,6 +40,16 @@ typedef enum mc_BufferType {
     MC_BUFFER_TYPE_GPU, ///< Not accessible from CPU, but fast GPU access
 } mc_BufferType;
 
+/**
+ * The order in which the workgroups of a 2D dispatch are run, see
+ * `mc_program_run_swizzled()`.
+ */
+typedef enum mc_LaunchOrder {
+    MC_LAUNCH_ORDER_RASTER,       ///< Row by row (the default order)
+    MC_LAUNCH_ORDER_GROUPED_ROWS, ///< Column by column, in bands of rows
+    MC_LAUNCH_ORDER_MORTON,       ///< Z-order curve, in square tiles
+} mc_LaunchOrder;
+
 /**
  * Options to pass to mc_program_code_create_*.
  */
@@ -48,6 +58,16 @@ typedef struct mc_CompileDefinition {
     char* value; ///< The value
 } mc_CompileDefinition;
 
+/**
+ * Usage statistics of a device queue.
+ */
+typedef struct mc_QueueStats {
+    uint64_t submitCount;  ///< The number of submissions made to the queue
+    uint32_t pendingCount; ///< The number of submissions currently in flight
+    double busyTime;       ///< Time spent with work in flight, in seconds
+    double utilization;    ///< `busyTime` divided by the device's lifetime
+} mc_QueueStats;
+
 /**
  * The log callback type.
  * @param arg The value passed to `logArg` in `mc_instance_create()`
@@ -98,6 +118,23 @@ typedef struct mc_ProgramCode mc_ProgramCode;
  */
 typedef struct mc_Program mc_Program;
 
+/**
+ * A prepared dispatch of a program, with its buffers bound and its commands
+ * recorded, that can be submitted any number of times.
+ */
+typedef struct mc_Dispatch mc_Dispatch;
+
+/**
+ * A set of pipelines being created in the background.
+ */
+typedef struct mc_ProgramWarmup mc_ProgramWarmup;
+
+/**
+ * A GLSL source with a set of compile-time definitions, whose variants (one
+ * per tuple of definition values) are compiled on first use.
+ */
+typedef struct mc_ProgramFamily mc_ProgramFamily;
+
 /**
  * Create an instance of the library. If `log_fn` is `NULL`, no logs will be
  * from microcompute.
@@ -108,6 +145,23 @@ typedef struct mc_Program mc_Program;
  */
 mc_Instance* mc_instance_create(mc_log_fn* log_fn, void* logArg);
 
+/**
+ * Create an instance of the library, with up to `maxQueueCount` compute queues
+ * per device. Independent submissions (e.g. from different threads) are spread
+ * over the queues, picking the least loaded one. `mc_instance_create()` uses up
+ * to 4 queues.
+ *
+ * @param log_fn A function to call when there is a message from the library
+ * @param logArg A value to pass to the `arg` parameter of `log_fn`
+ * @param maxQueueCount The max number of queues per device, 0 for all queues
+ * @return A new instance success, `NULL` on error
+ */
+mc_Instance* mc_instance_create_with_queues(
+    mc_log_fn* log_fn,
+    void* logArg,
+    uint32_t maxQueueCount
+);
+
 /**
  * Destroy an instance of the library.
  * @param instance An instance of the library
@@ -156,6 +210,13 @@ uint32_t* mc_device_get_max_workgroup_size_shape(mc_Device* device);
  */
 uint32_t* mc_device_get_max_workgroup_count(mc_Device* device);
 
+/**
+ * Get the min alignment of storage buffer offsets of a device.
+ * @param device A device
+ * @return The alignment, in bytes
+ */
+uint64_t mc_device_get_storage_alignment(mc_Device* device);
+
 /**
  * Get the name of a device.
  * @param device A device
@@ -163,6 +224,43 @@ uint32_t* mc_device_get_max_workgroup_count(mc_Device* device);
  */
 char* mc_device_get_name(mc_Device* device);
 
+/**
+ * Get the number of compute queues created for a device.
+ * @param device A device
+ * @return The number of queues
+ */
+uint32_t mc_device_get_queue_count(mc_Device* device);
+
+/**
+ * Get the usage statistics of one of the queues of a device.
+ * @param device A device
+ * @param idx The index of the queue, less than `mc_device_get_queue_count()`
+ * @return The statistics of the queue (all zero on error)
+ */
+mc_QueueStats mc_device_get_queue_stats(mc_Device* device, uint32_t idx);
+
+/**
+ * Back the CPU buffers (including the staging buffers of hybrid buffers and
+ * copiers) created from now on with host memory allocated by the library,
+ * using hugepages and/or bound to a NUMA node, and imported into vulkan. This
+ * avoids cross-socket traffic and TLB misses for large transfers. Needs
+ * `VK_EXT_external_memory_host` and linux (with hugepages reserved by the
+ * system for page sizes above 4 KiB). Buffers smaller than a page, and
+ * buffers whose import fails, use driver allocated memory. The size of a
+ * buffer is not changed by the rounding of its memory to whole pages.
+ *
+ * @param device A device
+ * @param pageSize The page size, 4096, 2 MiB or 1 GiB, 0 to use driver
+ * allocated memory again
+ * @param numaNode The NUMA node to allocate the memory on, -1 for any node
+ * @return `true` on success, `false` if not supported
+ */
+bool mc_device_set_host_memory(
+    mc_Device* device,
+    uint64_t pageSize,
+    int32_t numaNode
+);
+
 /**
  * Create an empty buffer.
  * @param device A device
@@ -311,12 +409,332 @@ void mc_program_destroy(mc_Program* program);
 #define mc_program_run(program, dimX, dimY, dimZ, ...)                         \
     mc_program_run__(program, dimX, dimY, dimZ, ##__VA_ARGS__, NULL)
 
+/**
+ * Prepare a dispatch of a program. All the validation, descriptor updates and
+ * command recording is done once here, so that `mc_dispatch_submit()` only has
+ * to submit the recorded commands. The program and the buffers must outlive
+ * the dispatch.
+ *
+ * @param program A program
+ * @param dimX The number of workgroups to run in the x direction
+ * @param dimY The number of workgroups to run in the y direction
+ * @param dimZ The number of workgroups to run in the z direction
+ * @param buffCount The number of buffers
+ * @param buffs Buffers / hybrid buffers to pass to the program
+ * @return A new dispatch on success, `NULL` on error
+ */
+mc_Dispatch* mc_program_prepare(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    uint32_t dimZ,
+    uint32_t buffCount,
+    mc_Buffer** buffs
+);
+
+/**
+ * Prepare a batch of independent dispatches of a program, one per buffer set.
+ * All the dispatches are recorded into a single command buffer, so the whole
+ * batch costs one submission.
+ *
+ * @param program A program
+ * @param dimX The number of workgroups to run in the x direction
+ * @param dimY The number of workgroups to run in the y direction
+ * @param dimZ The number of workgroups to run in the z direction
+ * @param buffCount The number of buffers in each set
+ * @param buffSets `count` sets of `buffCount` buffers, one set after the other
+ * @param count The number of buffer sets
+ * @return A new dispatch on success, `NULL` on error
+ */
+mc_Dispatch* mc_program_prepare_batch(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    uint32_t dimZ,
+    uint32_t buffCount,
+    mc_Buffer** buffSets,
+    uint32_t count
+);
+
+/**
+ * Run a program once per buffer set, using a single submission. See
+ * `mc_program_prepare_batch()`.
+ *
+ * @param program A program
+ * @param dimX The number of workgroups to run in the x direction
+ * @param dimY The number of workgroups to run in the y direction
+ * @param dimZ The number of workgroups to run in the z direction
+ * @param buffCount The number of buffers in each set
+ * @param buffSets `count` sets of `buffCount` buffers, one set after the other
+ * @param count The number of buffer sets
+ * @return The time taken to run the batch, in seconds, -1.0 on error
+ */
+double mc_program_run_batch(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    uint32_t dimZ,
+    uint32_t buffCount,
+    mc_Buffer** buffSets,
+    uint32_t count
+);
+
+/**
+ * Prepare a 2D dispatch of a program whose workgroups are run in a cache
+ * friendly order, so that workgroups running at the same time access nearby
+ * data (for stencils, tiled matrix multiplications, image resampling, ...).
+ * The program must be compiled with `MC_SWIZZLE` defined, and get its
+ * workgroup id from the built-in `microcompute/swizzle.glsl` include (after
+ * the `local_size` layout), instead of `gl_WorkGroupID`:
+ *
+ * ```glsl
+ * #include <microcompute/swizzle.glsl>
+ *
+ * void main() {
+ *     uvec2 wg = mc_workgroup_id();           // instead of gl_WorkGroupID.xy
+ *     uvec2 pos = mc_global_invocation_id(); // gl_GlobalInvocationID.xy
+ * }
+ * ```
+ *
+ * The order is passed with push constants, so the same program can be run in
+ * any order. Without `MC_SWIZZLE`, the helpers return the regular ids.
+ *
+ * @param program A program
+ * @param dimX The number of workgroups to run in the x direction
+ * @param dimY The number of workgroups to run in the y direction
+ * @param order The order in which to run the workgroups
+ * @param groupSize The number of rows in a band (for grouped rows) or the
+ * width of a tile (for the Morton order, a power of two), in workgroups
+ * @param buffCount The number of buffers
+ * @param buffs Buffers / hybrid buffers to pass to the program
+ * @return A new dispatch on success, `NULL` on error
+ */
+mc_Dispatch* mc_program_prepare_swizzled(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    mc_LaunchOrder order,
+    uint32_t groupSize,
+    uint32_t buffCount,
+    mc_Buffer** buffs
+);
+
+/**
+ * Run a 2D dispatch of a program in a cache friendly order. See
+ * `mc_program_prepare_swizzled()`.
+ *
+ * @param program A program
+ * @param dimX The number of workgroups to run in the x direction
+ * @param dimY The number of workgroups to run in the y direction
+ * @param order The order in which to run the workgroups
+ * @param groupSize The number of rows in a band (for grouped rows) or the
+ * width of a tile (for the Morton order, a power of two), in workgroups
+ * @param buffCount The number of buffers
+ * @param buffs Buffers / hybrid buffers to pass to the program
+ * @return The time taken to run the program, in seconds, -1.0 on error
+ */
+double mc_program_run_swizzled(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    mc_LaunchOrder order,
+    uint32_t groupSize,
+    uint32_t buffCount,
+    mc_Buffer** buffs
+);
+
+/**
+ * Run a program with a number of workgroups read from a buffer on the device,
+ * for example a count computed by a previous program, without reading it back.
+ *
+ * @param program A program
+ * @param args A buffer containing the number of workgroups to run in the x, y
+ * and z directions, as 3 `uint`s
+ * @param offset The offset of the numbers in `args`, a multiple of 4
+ * @param buffCount The number of buffers
+ * @param buffs Buffers / hybrid buffers to pass to the program
+ * @return The time taken to run the program, in seconds, -1.0 on error
+ */
+double mc_program_run_indirect(
+    mc_Program* program,
+    mc_Buffer* args,
+    uint64_t offset,
+    uint32_t buffCount,
+    mc_Buffer** buffs
+);
+
+/**
+ * Run a program `iterations` times in a single submission, alternating between
+ * two sets of buffers (`ping` for even iterations, `pong` for odd ones), with
+ * a barrier between iterations.
+ *
+ * If `activeFlag` is not `NULL`, the program is expected to set the first
+ * `uint` of `activeFlag` to a non-zero value while it has not converged. The
+ * flag is checked (and cleared) on the device every `checkInterval`
+ * iterations, and the remaining iterations are skipped once it is found to be
+ * zero.
+ *
+ * @param program A program
+ * @param dimX The number of workgroups to run in the x direction
+ * @param dimY The number of workgroups to run in the y direction
+ * @param dimZ The number of workgroups to run in the z direction
+ * @param iterations The max number of iterations
+ * @param buffCount The number of buffers in `ping` and `pong`
+ * @param ping The buffers used in even iterations
+ * @param pong The buffers used in odd iterations
+ * @param activeFlag A buffer containing the active flag, or `NULL`
+ * @param checkInterval The number of iterations between flag checks
+ * @param iterationsRun Returns the number of iterations run, can be `NULL`
+ * @return The time taken to run the iterations, in seconds, -1.0 on error
+ */
+double mc_program_iterate(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    uint32_t dimZ,
+    uint32_t iterations,
+    uint32_t buffCount,
+    mc_Buffer** ping,
+    mc_Buffer** pong,
+    mc_Buffer* activeFlag,
+    uint32_t checkInterval,
+    uint32_t* iterationsRun
+);
+
+/**
+ * Run a prepared dispatch, and wait for it to finish. A dispatch must not be
+ * submitted from several threads at the same time.
+ *
+ * @param dispatch A dispatch
+ * @return The time taken to run the dispatch, in seconds, -1.0 on error
+ */
+double mc_dispatch_submit(mc_Dispatch* dispatch);
+
+/**
+ * Destroy a dispatch.
+ * @param dispatch A dispatch
+ */
+void mc_dispatch_destroy(mc_Dispatch* dispatch);
+
+/**
+ * Create the pipelines of some programs in the background, so that their first
+ * runs do not have to. Pipelines are created on a small pool of threads, with
+ * several pipelines per `vkCreateComputePipelines()` call. The programs must
+ * not be destroyed before `mc_program_warmup_wait()` returns.
+ *
+ * @param programs The programs to warm up
+ * @param buffCounts The number of buffers each program will be run with
+ * @param count The number of elements in `programs` and `buffCounts`
+ * @return A warmup handle on success, `NULL` on error
+ */
+mc_ProgramWarmup* mc_program_warmup(
+    mc_Program** programs,
+    uint32_t* buffCounts,
+    uint32_t count
+);
+
+/**
+ * Check if all the pipelines of a warmup have been created.
+ * @param warmup A warmup handle
+ * @return `true` if the warmup is done, `false` otherwise
+ */
+bool mc_program_warmup_is_done(mc_ProgramWarmup* warmup);
+
+/**
+ * Wait for a warmup to finish, and destroy the warmup handle.
+ * @param warmup A warmup handle
+ * @return `true` if all pipelines were created, `false` on error
+ */
+bool mc_program_warmup_wait(mc_ProgramWarmup* warmup);
+
+/**
+ * Create a program family. Nothing is compiled until a variant is requested.
+ * @param device A device
+ * @param name The name of the code (used in compile error messages)
+ * @param code The GLSL code, copied internally
+ * @param entry The entry point (the name of the "main" function)
+ * @param keyCount The number of compile-time definitions
+ * @param keys The names of the definitions, copied internally
+ * @param buffCount The number of buffers the variants will be run with, so
+ * that their pipelines can be created with them (0 to skip)
+ * @param maxLive The max number of variants to keep as programs, the least
+ * recently used ones are destroyed first (0 for no limit)
+ * @return A new program family on success, `NULL` on error
+ */
+mc_ProgramFamily* mc_program_family_create(
+    mc_Device* device,
+    const char* name,
+    const char* code,
+    const char* entry,
+    uint32_t keyCount,
+    const char** keys,
+    uint32_t buffCount,
+    uint32_t maxLive
+);
+
+/**
+ * Destroy a program family and all its programs. Must not be called while any
+ * of its programs are in use.
+ *
+ * @param family A program family
+ */
+void mc_program_family_destroy(mc_ProgramFamily* family);
+
+/**
+ * Get the program for a variant of a family, compiling it if needed. Threads
+ * requesting a variant that is being compiled wait for it instead of compiling
+ * it again. The program stays valid until `mc_program_family_release()` is
+ * called on it. Evicted variants are recreated without recompiling.
+ *
+ * @param family A program family
+ * @param values The value of each definition, in the order of the keys
+ * @return The program on success, `NULL` on error
+ */
+mc_Program* mc_program_family_get(
+    mc_ProgramFamily* family,
+    const int32_t* values
+);
+
+/**
+ * Release a program returned by `mc_program_family_get()`, allowing it to be
+ * evicted.
+ *
+ * @param family A program family
+ * @param program A program of the family
+ */
+void mc_program_family_release(mc_ProgramFamily* family, mc_Program* program);
+
+/**
+ * Compile some variants of a family in the background, in order, so that they
+ * are ready when requested.
+ *
+ * @param family A program family
+ * @param count The number of variants
+ * @param values `count` tuples of definition values, one after the other
+ * @return `true` on success, `false` on error
+ */
+bool mc_program_family_prefetch(
+    mc_ProgramFamily* family,
+    uint32_t count,
+    const int32_t* values
+);
+
 /**
  * Get the current time.
  * @return The current time in seconds
  */
 double mc_get_time();
 
+/**
+ * Restrict the calling thread to the CPUs of a NUMA node, for example the node
+ * set with `mc_device_set_host_memory()`, so that its copies stay local. Only
+ * supported on linux.
+ *
+ * @param numaNode The NUMA node
+ * @return `true` on success, `false` on error
+ */
+bool mc_pin_thread_to_numa_node(int32_t numaNode);
+
 /**
  * Convert a `mc_LogLevel` enum to a human readable string.
  * @param level A log level
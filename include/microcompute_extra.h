@@ -1,6 +1,7 @@
 #ifndef MICROCOMPUTE_EXTRA_H
 #define MICROCOMPUTE_EXTRA_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 /**
@@ -23,12 +24,160 @@ typedef struct mc_Buffer mc_Buffer;
  */
 typedef struct mc_Program mc_Program;
 
+/**
+ * A compression codec for transfers of `uint32_t` arrays between the host and
+ * the device. The data is split in blocks of 128 values, each encoded on its
+ * own.
+ */
+typedef enum mc_Codec {
+    MC_CODEC_NONE,     ///< No compression
+    MC_CODEC_DELTA,    ///< Bit-packed deltas, for sorted or smooth data
+    MC_CODEC_FOR,      ///< Bit-packed offsets from the min (frame of reference)
+    MC_CODEC_ZERO_RUN, ///< Only the non-zero values, for sparse data
+} mc_Codec;
+
+/**
+ * The type of the values of a column.
+ */
+typedef enum mc_ColumnType {
+    MC_COLUMN_TYPE_U32, ///< `uint32_t`
+    MC_COLUMN_TYPE_I32, ///< `int32_t`
+    MC_COLUMN_TYPE_F32, ///< `float`
+    MC_COLUMN_TYPE_U64, ///< `uint64_t`
+    MC_COLUMN_TYPE_I64, ///< `int64_t`
+    MC_COLUMN_TYPE_F64, ///< `double`
+} mc_ColumnType;
+
+/**
+ * A column of a column file.
+ */
+typedef struct mc_Column {
+    const char* name;   ///< The name of the column, at most 63 characters
+    mc_ColumnType type; ///< The type of the values
+    mc_Codec codec;     ///< The compression of the column (32 bit types only)
+    uint64_t rowCount;  ///< The number of values
+    const void* data;   ///< The values
+} mc_Column;
+
+/**
+ * A column file, mapped in memory, whose columns can be loaded to the device.
+ */
+typedef struct mc_ColumnFile mc_ColumnFile;
+
+/**
+ * A 2D grid program whose output is split into tiles, so that only the tiles
+ * affected by a change are computed again.
+ */
+typedef struct mc_TiledProgram mc_TiledProgram;
+
+/**
+ * Groups concurrent requests for the same program into a single dispatch.
+ */
+typedef struct mc_Batcher mc_Batcher;
+
+/**
+ * The pending result of a request submitted to a batcher.
+ */
+typedef struct mc_Future mc_Future;
+
+/**
+ * Runs a program with per-workgroup timing, to find load imbalance.
+ */
+typedef struct mc_WgProfiler mc_WgProfiler;
+
+/**
+ * Statistics of the workgroup durations of a profiled run, in shader clock
+ * ticks.
+ */
+typedef struct mc_WgProfileSummary {
+    uint64_t wgCount; ///< The number of workgroups
+    uint64_t min;     ///< The shortest workgroup
+    uint64_t median;  ///< The median workgroup
+    uint64_t p99;     ///< The 99th percentile
+    uint64_t max;     ///< The longest workgroup
+    double mean;      ///< The mean duration
+    double stddev;    ///< The standard deviation of the durations
+    double imbalance; ///< `max / mean`, 1.0 when perfectly balanced
+} mc_WgProfileSummary;
+
+/**
+ * Finds many byte patterns at once in text buffers (Aho-Corasick).
+ */
+typedef struct mc_PatternMatcher mc_PatternMatcher;
+
+/**
+ * A match found by a pattern matcher, as stored in the match vector.
+ */
+typedef struct mc_PatternMatch {
+    uint64_t offset;  ///< The offset of the first byte of the match
+    uint32_t pattern; ///< The index of the pattern
+    uint32_t length;  ///< The length of the pattern
+} mc_PatternMatch;
+
+/**
+ * The type of a CSV column once parsed.
+ */
+typedef enum mc_CsvType {
+    MC_CSV_TYPE_INT,   ///< `int32_t`
+    MC_CSV_TYPE_FLOAT, ///< `float`
+    MC_CSV_TYPE_DICT,  ///< `uint32_t` ids of the distinct strings
+} mc_CsvType;
+
+/**
+ * A CSV field (or record) that could not be parsed.
+ */
+typedef struct mc_CsvError {
+    uint32_t row;    ///< The row, not counting the header
+    uint32_t offset; ///< The offset of the invalid byte in the text
+} mc_CsvError;
+
+/**
+ * CSV data parsed into typed columns, stored on the device.
+ */
+typedef struct mc_CsvTable mc_CsvTable;
+
+/**
+ * The format of floating point data in a buffer.
+ */
+typedef enum mc_FloatFormat {
+    MC_FLOAT_FORMAT_F32, ///< `float`
+    MC_FLOAT_FORMAT_F16, ///< IEEE half precision, two per 32-bit word
+} mc_FloatFormat;
+
+/**
+ * How `mc_scatter()` combines an element with the one at its destination.
+ */
+typedef enum mc_ScatterOp {
+    MC_SCATTER_OP_STORE,   ///< Overwrite the destination
+    MC_SCATTER_OP_ADD_U32, ///< Atomically add, as `uint32_t` words
+    MC_SCATTER_OP_ADD_F32, ///< Atomically add, as `float` words
+} mc_ScatterOp;
+
 /**
  * A hybrid buffer. This buffer is can be accessed from the CPU while still
  * being fast to access from the GPU.
  */
 typedef struct mc_HBuffer mc_HBuffer;
 
+/**
+ * A growable array of fixed size elements, stored on the device. Programs can
+ * append to it using its counter buffer.
+ */
+typedef struct mc_Vector mc_Vector;
+
+/**
+ * A queue of `uint` work items, stored on the device. Programs pop items from
+ * it and push new items into it while running, see
+ * `mc_work_queue_get_buffer()`.
+ */
+typedef struct mc_WorkQueue mc_WorkQueue;
+
+/**
+ * A directed graph in CSR form, stored on the device, that can be traversed
+ * without going back to the host between levels.
+ */
+typedef struct mc_Graph mc_Graph;
+
 /**
  * Create an empty hybrid buffer.
  * @param device A device
@@ -93,6 +242,46 @@ uint64_t mc_hybrid_buffer_read(
     void* data
 );
 
+/**
+ * Read data from a hybrid buffer, compressing it on the device before the
+ * transfer and decompressing it on the host.
+ *
+ * @param hBuffer A hybrid buffer
+ * @param offset The offset from witch to start reading the data, in bytes,
+ * must be a multiple of 4
+ * @param size The size of the data to read, in bytes, must be a multiple of 4
+ * @param data A reference to the buffer to read the data into
+ * @param codec The codec to use for the transfer
+ * @return The number of bytes read, 0 on error
+ */
+uint64_t mc_hybrid_buffer_read_compressed(
+    mc_HBuffer* hBuffer,
+    uint64_t offset,
+    uint64_t size,
+    void* data,
+    mc_Codec codec
+);
+
+/**
+ * Write data to a hybrid buffer, compressing it on the host before the
+ * transfer and decompressing it on the device.
+ *
+ * @param hBuffer A hybrid buffer
+ * @param offset The offset from witch to start writing the data, in bytes,
+ * must be a multiple of 4
+ * @param size The size of the data to write, in bytes, must be a multiple of 4
+ * @param data A reference to the data to write
+ * @param codec The codec to use for the transfer
+ * @return The number of bytes written, 0 on error
+ */
+uint64_t mc_hybrid_buffer_write_compressed(
+    mc_HBuffer* hBuffer,
+    uint64_t offset,
+    uint64_t size,
+    void* data,
+    mc_Codec codec
+);
+
 /**
  * Create an buffer from some data.
  * @param device A device
@@ -109,8 +298,8 @@ mc_Buffer* mc_buffer_create_from(
 );
 
 /**
- * Reallocate a buffer. If the buffer is of type `MC_BUFFER_TYPE_CPU`, the data
- * will be copied.
+ * Reallocate a buffer. The data is copied (on the device for buffers of type
+ * `MC_BUFFER_TYPE_GPU`). On error, the old buffer is left untouched.
  *
  * @param buffer A buffer
  * @param size The new size of the buffer
@@ -119,13 +308,1234 @@ mc_Buffer* mc_buffer_create_from(
 mc_Buffer* mc_buffer_realloc(mc_Buffer* buffer, uint64_t size);
 
 /**
- * Reallocate a hybrid buffer. This will copy the data from the old buffer.
+ * Reallocate a hybrid buffer. This will copy the data from the old buffer, on
+ * the device. On error, the old buffer is left untouched.
+ *
  * @param hBuffer A buffer
  * @param size The new size of the buffer
  * @return A new buffer on success, `NULL` on error
  */
 mc_HBuffer* mc_hybrid_buffer_realloc(mc_HBuffer* hBuffer, uint64_t size);
 
+/**
+ * Create an empty vector.
+ * @param device A device
+ * @param elemSize The size of an element, in bytes
+ * @param capacity The initial number of elements that fit in the vector
+ * @return A new vector on success, `NULL` on error
+ */
+mc_Vector* mc_vector_create(
+    mc_Device* device,
+    uint64_t elemSize,
+    uint64_t capacity
+);
+
+/**
+ * Destroy a vector.
+ * @param vector A vector
+ */
+void mc_vector_destroy(mc_Vector* vector);
+
+/**
+ * Get the number of elements in a vector.
+ * @param vector A vector
+ * @return The number of elements
+ */
+uint64_t mc_vector_get_size(mc_Vector* vector);
+
+/**
+ * Get the number of elements that fit in a vector without growing it.
+ * @param vector A vector
+ * @return The capacity of the vector
+ */
+uint64_t mc_vector_get_capacity(mc_Vector* vector);
+
+/**
+ * Get the buffer holding the elements of a vector, to pass to a program. The
+ * buffer changes when the vector grows.
+ *
+ * @param vector A vector
+ * @return The data buffer
+ */
+mc_Buffer* mc_vector_get_buffer(mc_Vector* vector);
+
+/**
+ * Get the counter buffer of a vector, to pass to a program. It contains the
+ * size and the capacity of the vector, as two `uint`s. Programs append to the
+ * vector with:
+ *
+ * ```glsl
+ * uint idx = atomicAdd(size, 1);
+ * if (idx < capacity) data[idx] = value;
+ * ```
+ *
+ * and `mc_vector_sync()` must be called after the program has run.
+ *
+ * @param vector A vector
+ * @return The counter buffer
+ */
+mc_Buffer* mc_vector_get_counter(mc_Vector* vector);
+
+/**
+ * Make sure a vector can hold at least `capacity` elements. The vector grows
+ * geometrically, and existing elements are copied on the device.
+ *
+ * @param vector A vector
+ * @param capacity The min capacity
+ * @return `true` on success, `false` on error
+ */
+bool mc_vector_reserve(mc_Vector* vector, uint64_t capacity);
+
+/**
+ * Change the number of elements in a vector. New elements are uninitialized.
+ * @param vector A vector
+ * @param size The new number of elements
+ * @return `true` on success, `false` on error
+ */
+bool mc_vector_resize(mc_Vector* vector, uint64_t size);
+
+/**
+ * Append elements from the host to a vector.
+ * @param vector A vector
+ * @param count The number of elements to append
+ * @param data The elements to append
+ * @return The number of elements appended, 0 on error
+ */
+uint64_t mc_vector_push_back_many(
+    mc_Vector* vector,
+    uint64_t count,
+    void* data
+);
+
+/**
+ * Read elements from a vector.
+ * @param vector A vector
+ * @param first The index of the first element to read
+ * @param count The number of elements to read
+ * @param data A reference to the buffer to read the elements into
+ * @return The number of elements read, 0 on error
+ */
+uint64_t mc_vector_read(
+    mc_Vector* vector,
+    uint64_t first,
+    uint64_t count,
+    void* data
+);
+
+/**
+ * Update the size of a vector after a program appended elements to it. If
+ * some elements did not fit, none of the appended elements are kept: the size
+ * goes back to what it was before the program ran, and the vector grows so
+ * that they all fit next time, so the program can simply be run again.
+ *
+ * @param vector A vector
+ * @return The number of elements that did not fit
+ */
+uint64_t mc_vector_sync(mc_Vector* vector);
+
+/**
+ * Create a work queue.
+ * @param device A device
+ * @param capacity The max number of items in the queue, rounded up to a power
+ * of two
+ * @return A new work queue, `NULL` on error
+ */
+mc_WorkQueue* mc_work_queue_create(mc_Device* device, uint32_t capacity);
+
+/**
+ * Destroy a work queue.
+ * @param queue A work queue
+ */
+void mc_work_queue_destroy(mc_WorkQueue* queue);
+
+/**
+ * Get the buffer of a work queue, to pass to a program. Programs access it
+ * through the built-in `microcompute/work_queue.glsl` include, and usually run
+ * persistent workgroups that keep popping items until the queue is drained:
+ *
+ * ```glsl
+ * #define MC_WORK_QUEUE_BINDING 0
+ * #include <microcompute/work_queue.glsl>
+ *
+ * void main() {
+ *     while (!mc_work_queue_drained()) {
+ *         uint item;
+ *         if (!mc_work_queue_pop(item)) continue;
+ *         // process the item, possibly calling mc_work_queue_push()
+ *         mc_work_queue_done();
+ *     }
+ * }
+ * ```
+ *
+ * @param queue A work queue
+ * @return The queue buffer
+ */
+mc_Buffer* mc_work_queue_get_buffer(mc_WorkQueue* queue);
+
+/**
+ * Get the capacity of a work queue.
+ * @param queue A work queue
+ * @return The max number of items in the queue
+ */
+uint32_t mc_work_queue_get_capacity(mc_WorkQueue* queue);
+
+/**
+ * Empty a work queue and fill it with initial items. Must be called before
+ * running a program on the queue again.
+ *
+ * @param queue A work queue
+ * @param count The number of initial items
+ * @param items The initial items, can be `NULL` if `count` is 0
+ * @return `true` on success, `false` on error
+ */
+bool mc_work_queue_reset(mc_WorkQueue* queue, uint32_t count, uint32_t* items);
+
+/**
+ * Get the number of workgroups to launch for a persistent program on a work
+ * queue, so that the workgroups can all be resident on the device at once.
+ *
+ * @param queue A work queue
+ * @param wgSize The number of invocations per workgroup
+ * @return The number of workgroups, 0 on error
+ */
+uint32_t mc_work_queue_get_launch_size(mc_WorkQueue* queue, uint32_t wgSize);
+
+/**
+ * Get the number of items pushed to a work queue that were not done.
+ * @param queue A work queue
+ * @return The number of pending items
+ */
+uint32_t mc_work_queue_get_pending(mc_WorkQueue* queue);
+
+/**
+ * Check if a program tried to push an item to a full work queue. The item is
+ * then dropped by `mc_work_queue_push()`, which returns `false`.
+ *
+ * @param queue A work queue
+ * @return `true` if the queue overflowed, `false` otherwise
+ */
+bool mc_work_queue_has_overflowed(mc_WorkQueue* queue);
+
+/**
+ * Create a graph from its CSR representation: the out edges of vertex `i` are
+ * `edges[offsets[i]]` to `edges[offsets[i + 1] - 1]`. The transposed graph is
+ * built and stored as well, for bottom-up (pull) BFS steps.
+ *
+ * @param device A device
+ * @param vertexCount The number of vertices
+ * @param edgeCount The number of edges
+ * @param offsets `vertexCount + 1` edge offsets
+ * @param edges The destination vertex of each edge
+ * @param weights The non-negative weight of each edge, can be `NULL` if the
+ * graph is only used for BFS
+ * @return A new graph, `NULL` on error
+ */
+mc_Graph* mc_graph_create(
+    mc_Device* device,
+    uint32_t vertexCount,
+    uint32_t edgeCount,
+    const uint32_t* offsets,
+    const uint32_t* edges,
+    const float* weights
+);
+
+/**
+ * Destroy a graph.
+ * @param graph A graph
+ */
+void mc_graph_destroy(mc_Graph* graph);
+
+/**
+ * Run a breadth-first search. Each level is expanded either top-down (from the
+ * frontier) or bottom-up (from the unvisited vertices), whichever touches fewer
+ * edges, with the frontier compacted and the next level sized on the device.
+ *
+ * @param graph A graph
+ * @param source The vertex to start from
+ * @param depths Returns the depth of each vertex (`UINT32_MAX` if it can not be
+ * reached), can be `NULL`
+ * @return The time taken, in seconds, -1.0 on error
+ */
+double mc_graph_bfs(mc_Graph* graph, uint32_t source, uint32_t* depths);
+
+/**
+ * Compute the shortest distances from a vertex, using delta-stepping (in its
+ * near-far form). Vertices closer than the current threshold are relaxed
+ * right away, the others wait until the threshold is raised by `delta`.
+ * Smaller values of `delta` do less redundant work but need more steps, the
+ * average edge weight is a good starting point.
+ *
+ * @param graph A graph, with weights
+ * @param source The vertex to start from
+ * @param delta The bucket width, must be positive
+ * @param distances Returns the distance of each vertex (`INFINITY` if it can
+ * not be reached), can be `NULL`
+ * @return The time taken, in seconds, -1.0 on error
+ */
+double mc_graph_sssp(
+    mc_Graph* graph,
+    uint32_t source,
+    float delta,
+    float* distances
+);
+
+/**
+ * Write a column file. Each column is stored as a typed array, starting at an
+ * offset aligned to `alignment` (`mc_device_get_storage_alignment()` is a good
+ * choice), and is optionally compressed in independent blocks of 128 values.
+ * The index of the columns is stored at the end of the file.
+ *
+ * @param filename The name of the file to write
+ * @param alignment The alignment of the columns, in bytes (at least 8)
+ * @param columnCount The number of columns
+ * @param columns The columns
+ * @return `true` on success, `false` on error
+ */
+bool mc_column_file_write(
+    const char* filename,
+    uint64_t alignment,
+    uint32_t columnCount,
+    const mc_Column* columns
+);
+
+/**
+ * Open a column file. The file is mapped in memory, not read.
+ * @param device The device to load the columns to
+ * @param filename The name of the file to open
+ * @return A new column file, `NULL` on error
+ */
+mc_ColumnFile* mc_column_file_open(mc_Device* device, const char* filename);
+
+/**
+ * Close a column file.
+ * @param file A column file
+ */
+void mc_column_file_close(mc_ColumnFile* file);
+
+/**
+ * Get the number of columns in a column file.
+ * @param file A column file
+ * @return The number of columns
+ */
+uint32_t mc_column_file_get_column_count(mc_ColumnFile* file);
+
+/**
+ * Find a column by name.
+ * @param file A column file
+ * @param name The name of the column
+ * @return The index of the column, -1 if there is no such column
+ */
+int32_t mc_column_file_find_column(mc_ColumnFile* file, const char* name);
+
+/**
+ * Get the description of a column. For uncompressed columns, `data` points to
+ * the values in the mapped file, and stays valid until the file is closed.
+ *
+ * @param file A column file
+ * @param idx The index of the column
+ * @return The column, with `data` set to `NULL` for compressed columns
+ */
+mc_Column mc_column_file_get_column(mc_ColumnFile* file, uint32_t idx);
+
+/**
+ * Load a range of rows of a column into a buffer. Only the bytes of the
+ * selected rows (or the compressed blocks holding them) are read from the
+ * file, and they are streamed to the device through a fixed size staging
+ * buffer.
+ *
+ * @param file A column file
+ * @param column The index of the column
+ * @param firstRow The first row to load
+ * @param rowCount The number of rows to load
+ * @param buffer The buffer to load the rows into
+ * @param offset The offset in the buffer, in bytes
+ * @return The number of bytes loaded, 0 on error
+ */
+uint64_t mc_column_file_load_into(
+    mc_ColumnFile* file,
+    uint32_t column,
+    uint64_t firstRow,
+    uint64_t rowCount,
+    mc_Buffer* buffer,
+    uint64_t offset
+);
+
+/**
+ * Load a range of rows of a column into a new GPU buffer. See
+ * `mc_column_file_load_into()`.
+ *
+ * @param file A column file
+ * @param column The index of the column
+ * @param firstRow The first row to load
+ * @param rowCount The number of rows to load
+ * @return A new buffer, `NULL` on error
+ */
+mc_Buffer* mc_column_file_load(
+    mc_ColumnFile* file,
+    uint32_t column,
+    uint64_t firstRow,
+    uint64_t rowCount
+);
+
+/**
+ * Create a tiled program. The program computes a `width` by `height` grid of
+ * elements, stored row by row in `output`, with one invocation per element
+ * (invocations outside the grid must do nothing). Tiles are dispatched with
+ * a workgroup offset (`vkCmdDispatchBase()`), so `gl_GlobalInvocationID` is
+ * the same as with a full dispatch. Needs vulkan 1.1. All the tiles start
+ * invalidated.
+ *
+ * @param program A program
+ * @param output The output of the program
+ * @param elemSize The size of an element of the output, in bytes
+ * @param width The width of the grid
+ * @param height The height of the grid
+ * @param wgWidth The x size of the workgroups of the program
+ * @param wgHeight The y size of the workgroups of the program
+ * @param tileSize The width and height of a tile, a multiple of the workgroup
+ * size
+ * @return A new tiled program, `NULL` on error
+ */
+mc_TiledProgram* mc_tiled_program_create(
+    mc_Program* program,
+    mc_HBuffer* output,
+    uint32_t elemSize,
+    uint32_t width,
+    uint32_t height,
+    uint32_t wgWidth,
+    uint32_t wgHeight,
+    uint32_t tileSize
+);
+
+/**
+ * Destroy a tiled program.
+ * @param tp A tiled program
+ */
+void mc_tiled_program_destroy(mc_TiledProgram* tp);
+
+/**
+ * Invalidate the tiles covering a region of the grid, after its inputs
+ * changed. For stencil-like programs, the region should include the radius of
+ * the stencil.
+ *
+ * @param tp A tiled program
+ * @param x The x coordinate of the region, can be outside the grid
+ * @param y The y coordinate of the region, can be outside the grid
+ * @param width The width of the region
+ * @param height The height of the region
+ */
+void mc_tiled_program_invalidate(
+    mc_TiledProgram* tp,
+    int64_t x,
+    int64_t y,
+    int64_t width,
+    int64_t height
+);
+
+/**
+ * Invalidate all the tiles, for example after a parameter changed.
+ * @param tp A tiled program
+ */
+void mc_tiled_program_invalidate_all(mc_TiledProgram* tp);
+
+/**
+ * Get the number of invalidated tiles.
+ * @param tp A tiled program
+ * @return The number of tiles to compute on the next run
+ */
+uint32_t mc_tiled_program_get_dirty_count(mc_TiledProgram* tp);
+
+/**
+ * Shift the content of the grid (for example when panning a view), so that
+ * only the uncovered tiles have to be computed again. The output is shifted on
+ * the device. Tiles that were invalidated move with the content, marking the
+ * tiles they land on.
+ *
+ * @param tp A tiled program
+ * @param dx The shift in the x direction, in elements
+ * @param dy The shift in the y direction, in elements
+ * @param image The host copy of the output to shift as well, can be `NULL`
+ * @return `true` on success, `false` on error
+ */
+bool mc_tiled_program_scroll(
+    mc_TiledProgram* tp,
+    int32_t dx,
+    int32_t dy,
+    void* image
+);
+
+/**
+ * Compute the invalidated tiles (in a single submission), and copy them to a
+ * host copy of the output.
+ *
+ * @param tp A tiled program
+ * @param buffCount The number of buffers
+ * @param buffs Buffers / hybrid buffers to pass to the program, including the
+ * output
+ * @param image The host copy of the output, in which only the computed tiles
+ * are updated, can be `NULL`
+ * @return The time taken, in seconds, -1.0 on error
+ */
+double mc_tiled_program_run(
+    mc_TiledProgram* tp,
+    uint32_t buffCount,
+    mc_Buffer** buffs,
+    void* image
+);
+
+/**
+ * Create a batcher, which accumulates requests (from any thread) for up to
+ * `maxDelay` seconds or `maxItems` requests, then runs the program once for
+ * all of them. The inputs are packed into one buffer, and the outputs
+ * scattered back to each request. The program gets the following buffers:
+ *
+ * - 0: a table of `uvec4`s, one per request: the offset and size of its input
+ *   in buffer 1, and the offset and size of its output in buffer 2, in `uint`s
+ * - 1: the packed inputs
+ * - 2: the packed outputs
+ * - 3 and up: `buffs`, shared by all the requests
+ *
+ * The program is dispatched with `gl_WorkGroupID.x` as the request index, and
+ * `groupsPerItem` workgroups per request along y.
+ *
+ * @param program A program
+ * @param buffCount The number of shared buffers
+ * @param buffs Buffers / hybrid buffers shared by all the requests
+ * @param groupsPerItem The number of workgroups per request
+ * @param maxItems The maximum number of requests in a batch
+ * @param maxDelay The maximum time a request waits for a batch to fill up, in
+ * seconds
+ * @return A new batcher, `NULL` on error
+ */
+mc_Batcher* mc_batcher_create(
+    mc_Program* program,
+    uint32_t buffCount,
+    mc_Buffer** buffs,
+    uint32_t groupsPerItem,
+    uint32_t maxItems,
+    double maxDelay
+);
+
+/**
+ * Destroy a batcher, after running the pending requests. All the futures must
+ * have been waited for or destroyed before the batcher is destroyed.
+ *
+ * @param batcher A batcher
+ */
+void mc_batcher_destroy(mc_Batcher* batcher);
+
+/**
+ * Submit a request. The input is copied, so it can be freed right away.
+ *
+ * @param batcher A batcher
+ * @param inSize The size of the input, in bytes, a multiple of 4
+ * @param in The input of the request
+ * @param outSize The size of the output, in bytes, a multiple of 4
+ * @param out Where to write the output, must stay valid until the request is
+ * done
+ * @return A future, to be waited for with `mc_future_wait()` or destroyed
+ * with `mc_future_destroy()`, `NULL` on error
+ */
+mc_Future* mc_batcher_submit(
+    mc_Batcher* batcher,
+    uint64_t inSize,
+    const void* in,
+    uint64_t outSize,
+    void* out
+);
+
+/**
+ * Run the pending requests without waiting for the batch to fill up.
+ * @param batcher A batcher
+ */
+void mc_batcher_flush(mc_Batcher* batcher);
+
+/**
+ * Check if a request is done, without blocking.
+ * @param future A future
+ * @return `true` if the output has been written, or the request failed
+ */
+bool mc_future_is_done(mc_Future* future);
+
+/**
+ * Wait for a request to be done, and destroy its future.
+ * @param future A future
+ * @return `true` if the output has been written, `false` on error
+ */
+bool mc_future_wait(mc_Future* future);
+
+/**
+ * Destroy a future without checking its result, waiting for the request to
+ * be done first, as its output is still written. Needed for the futures only
+ * checked with `mc_future_is_done()`.
+ *
+ * @param future A future
+ */
+void mc_future_destroy(mc_Future* future);
+
+/**
+ * Create a workgroup profiler. The program is compiled with `MC_PROFILE`
+ * defined, which enables the hooks of the built-in `microcompute/profile.glsl`
+ * include (they do nothing otherwise, so the same source can be used for
+ * normal runs). The include must come right after `#version`, and the hooks
+ * read the shader clock at the start and end of each workgroup:
+ *
+ * ```glsl
+ * #version 430
+ * #include <microcompute/profile.glsl>
+ *
+ * void main() {
+ *     MC_PROFILE_BEGIN();
+ *     // no early returns, MC_PROFILE_END() must be reached by all invocations
+ *     MC_PROFILE_END();
+ * }
+ * ```
+ *
+ * The device scope clock is used if available, the subgroup scope one
+ * otherwise. Needs vulkan 1.1 and `VK_KHR_shader_clock`.
+ *
+ * @param device A device
+ * @param name The name of the program, for error messages
+ * @param code The GLSL source of the program
+ * @param entry The entry point of the program
+ * @param buffCount The number of buffers the program uses, the timings are
+ * written to an extra buffer bound after them
+ * @return A new workgroup profiler, `NULL` on error
+ */
+mc_WgProfiler* mc_wg_profiler_create(
+    mc_Device* device,
+    const char* name,
+    const char* code,
+    const char* entry,
+    uint32_t buffCount
+);
+
+/**
+ * Destroy a workgroup profiler.
+ * @param profiler A workgroup profiler
+ */
+void mc_wg_profiler_destroy(mc_WgProfiler* profiler);
+
+/**
+ * Run the profiled program, and collect the duration of each workgroup.
+ * @param profiler A workgroup profiler
+ * @param dimX The number of workgroups to run in the x direction
+ * @param dimY The number of workgroups to run in the y direction
+ * @param dimZ The number of workgroups to run in the z direction
+ * @param buffs The `buffCount` buffers / hybrid buffers of the program
+ * @return The time taken (with the profiling overhead), in seconds, -1.0 on
+ * error
+ */
+double mc_wg_profiler_run(
+    mc_WgProfiler* profiler,
+    uint32_t dimX,
+    uint32_t dimY,
+    uint32_t dimZ,
+    mc_Buffer** buffs
+);
+
+/**
+ * Get the workgroup durations of the last run.
+ * @param profiler A workgroup profiler
+ * @return The duration of each workgroup in clock ticks, x first, then y,
+ * then z, `NULL` before the first run
+ */
+const uint64_t* mc_wg_profiler_get_durations(mc_WgProfiler* profiler);
+
+/**
+ * Summarize the workgroup durations of the last run.
+ * @param profiler A workgroup profiler
+ * @return The statistics, all zero before the first run
+ */
+mc_WgProfileSummary mc_wg_profiler_get_summary(mc_WgProfiler* profiler);
+
+/**
+ * Write the workgroup durations of the last run as a heatmap image (binary
+ * PPM, one pixel per workgroup, z slices stacked vertically), from black for
+ * no time to white for the longest workgroup.
+ *
+ * @param profiler A workgroup profiler
+ * @param filename The name of the image file
+ * @return `true` on success, `false` on error
+ */
+bool mc_wg_profiler_write_heatmap(
+    mc_WgProfiler* profiler,
+    const char* filename
+);
+
+/**
+ * Remove the consecutive duplicates of a list of `uint` keys (all duplicates
+ * if the keys are sorted), on the device. The count of unique keys is written
+ * to `outCount` as 4 `uint`s: the count, then the number of workgroups for
+ * one invocation per unique key with 64 invocations per workgroup (`(count +
+ * 63) / 64, 1, 1`), to use with `mc_program_run_indirect()` at offset 4.
+ *
+ * @param keys The keys
+ * @param count The number of keys
+ * @param outKeys Receives the unique keys, must hold `count` keys
+ * @param outCount Receives the count of unique keys, at least 16 bytes
+ * @param hostCount Receives the count of unique keys on the host, can be
+ * `NULL` to skip the read back
+ * @return `true` on success, `false` on error
+ */
+bool mc_unique(
+    mc_Buffer* keys,
+    uint32_t count,
+    mc_Buffer* outKeys,
+    mc_Buffer* outCount,
+    uint32_t* hostCount
+);
+
+/**
+ * Run-length encode a list of `uint` keys on the device: same as
+ * `mc_unique()`, with the length of each run of equal keys.
+ *
+ * @param keys The keys
+ * @param count The number of keys
+ * @param outKeys Receives the key of each run, must hold `count` keys
+ * @param outLengths Receives the length of each run, must hold `count` `uint`s
+ * @param outCount Receives the number of runs, see `mc_unique()`
+ * @param hostCount Receives the number of runs on the host, can be `NULL`
+ * @return `true` on success, `false` on error
+ */
+bool mc_rle(
+    mc_Buffer* keys,
+    uint32_t count,
+    mc_Buffer* outKeys,
+    mc_Buffer* outLengths,
+    mc_Buffer* outCount,
+    uint32_t* hostCount
+);
+
+/**
+ * Create a pattern matcher. The patterns are compiled into an Aho-Corasick
+ * automaton on the host, stored on the device as a dense transition table
+ * over byte classes (the bytes that appear in no pattern share a class).
+ *
+ * @param device A device
+ * @param patternCount The number of patterns
+ * @param patterns The patterns, any bytes
+ * @param lengths The lengths of the patterns, in bytes, not 0
+ * @return A new pattern matcher, `NULL` on error
+ */
+mc_PatternMatcher* mc_pattern_matcher_create(
+    mc_Device* device,
+    uint32_t patternCount,
+    const char* const* patterns,
+    const uint32_t* lengths
+);
+
+/**
+ * Destroy a pattern matcher.
+ * @param matcher A pattern matcher
+ */
+void mc_pattern_matcher_destroy(mc_PatternMatcher* matcher);
+
+/**
+ * Get the number of bytes consecutive chunks of a text must overlap by, so
+ * that no match is missed: the length of the longest pattern, minus one.
+ *
+ * @param matcher A pattern matcher
+ * @return The overlap, in bytes
+ */
+uint32_t mc_pattern_matcher_get_overlap(mc_PatternMatcher* matcher);
+
+/**
+ * Find the patterns in a chunk of text, on the device. The matches are
+ * appended to a vector of `mc_PatternMatch`, in no particular order (the
+ * vector grows and the chunk is scanned again if they do not fit).
+ *
+ * To scan a long text in chunks, start each chunk with the last
+ * `mc_pattern_matcher_get_overlap()` bytes of the previous one, and set
+ * `first` to their count so that their matches are not reported twice.
+ *
+ * @param matcher A pattern matcher
+ * @param text The text, its size rounded up to a multiple of 4 bytes
+ * @param size The size of the text, less than 4 GiB
+ * @param first Only the matches ending at or after this byte are reported
+ * @param baseOffset Added to the offsets of the matches, usually the offset
+ * of the chunk in the whole text
+ * @param matches Receives the matches
+ * @return `true` on success, `false` on error
+ */
+bool mc_pattern_matcher_scan(
+    mc_PatternMatcher* matcher,
+    mc_Buffer* text,
+    uint64_t size,
+    uint32_t first,
+    uint64_t baseOffset,
+    mc_Vector* matches
+);
+
+/**
+ * Find the patterns in a file, see `mc_pattern_matcher_scan()`. The file is
+ * read in overlapping chunks straight into a device visible staging buffer,
+ * which is scanned in place, so the data is not copied on the host.
+ *
+ * @param matcher A pattern matcher
+ * @param filename The name of the file
+ * @param matches Receives the matches, with their offsets in the file
+ * @return `true` on success, `false` on error
+ */
+bool mc_pattern_matcher_scan_file(
+    mc_PatternMatcher* matcher,
+    const char* filename,
+    mc_Vector* matches
+);
+
+/**
+ * Parse CSV text into typed columns, on the device. The records and fields
+ * are found with a parallel quote-aware scan: records end at the newlines
+ * outside of double quotes (`\r\n` is accepted, blank lines are skipped, and
+ * a trailing `\r` ends the last record), and fields at the delimiters outside
+ * of double quotes. Quoted fields lose their outer quotes.
+ *
+ * Numbers may be surrounded by spaces, and empty number fields are 0. Records
+ * with the wrong number of fields, invalid numbers and ints out of the
+ * `int32_t` range are reported as errors (the missing or invalid values are
+ * 0), see `mc_csv_table_get_errors()`.
+ *
+ * @param text The text, its size rounded up to a multiple of 4 bytes
+ * @param size The size of the text, less than 4 GiB
+ * @param delimiter The field delimiter, usually `,`
+ * @param header `true` to skip the first record
+ * @param columnCount The number of fields of each record
+ * @param types The type of each column
+ * @return A new CSV table, `NULL` on error
+ */
+mc_CsvTable* mc_csv_parse(
+    mc_Buffer* text,
+    uint64_t size,
+    char delimiter,
+    bool header,
+    uint32_t columnCount,
+    const mc_CsvType* types
+);
+
+/**
+ * Destroy a CSV table, and its column buffers.
+ * @param table A CSV table
+ */
+void mc_csv_table_destroy(mc_CsvTable* table);
+
+/**
+ * Get the number of rows of a CSV table.
+ * @param table A CSV table
+ * @return The number of rows
+ */
+uint32_t mc_csv_table_get_row_count(mc_CsvTable* table);
+
+/**
+ * Get the buffer holding a column of a CSV table, one 4 byte value per row.
+ *
+ * @param table A CSV table
+ * @param column The index of the column
+ * @return The column buffer, `NULL` on error
+ */
+mc_Buffer* mc_csv_table_get_column(mc_CsvTable* table, uint32_t column);
+
+/**
+ * Get the dictionary of a `MC_CSV_TYPE_DICT` column. It starts with the
+ * string of each id, as an (offset, length) pair of `uint`s, the offset being
+ * in bytes from the start of the dictionary buffer, where the strings follow
+ * (doubled quotes in quoted fields are unescaped). Ids are given in no
+ * particular order.
+ *
+ * @param table A CSV table
+ * @param column The index of the column
+ * @param size Returns the number of distinct strings, can be `NULL`
+ * @return The dictionary buffer, `NULL` for other columns
+ */
+mc_Buffer* mc_csv_table_get_dictionary(
+    mc_CsvTable* table,
+    uint32_t column,
+    uint32_t* size
+);
+
+/**
+ * Get the errors found while parsing. Only the first 256 errors are kept.
+ *
+ * @param table A CSV table
+ * @param errors Returns the kept errors, in no particular order, can be
+ * `NULL`
+ * @return The number of errors
+ */
+uint32_t mc_csv_table_get_errors(
+    mc_CsvTable* table,
+    const mc_CsvError** errors
+);
+
+/**
+ * Copy the values selected by a bitmap to the front of a buffer, in order, on
+ * the device. The count is written to `outCount` like for `mc_unique()`.
+ *
+ * @param values The `uint` values, or `NULL` to write the indices of the
+ * selected values instead
+ * @param count The number of values
+ * @param selection The selection bitmap, bit `i % 32` of word `i / 32` set if
+ * value `i` is kept, as written by `mc_bloom_probe()`
+ * @param outValues Receives the selected values, must hold `count` `uint`s
+ * @param outCount Receives the number of selected values, see `mc_unique()`
+ * @param hostCount Receives the number of selected values on the host, can be
+ * `NULL`
+ * @return `true` on success, `false` on error
+ */
+bool mc_compact(
+    mc_Buffer* values,
+    uint32_t count,
+    mc_Buffer* selection,
+    mc_Buffer* outValues,
+    mc_Buffer* outCount,
+    uint32_t* hostCount
+);
+
+/**
+ * Get the size of a Bloom filter for a number of keys. About 10 bits per key
+ * gives a 1 to 2 % false positive rate.
+ *
+ * @param count The number of keys
+ * @param bitsPerKey The number of filter bits per key
+ * @return The size of the filter, in bytes
+ */
+uint64_t mc_bloom_filter_size(uint32_t count, uint32_t bitsPerKey);
+
+/**
+ * Build a Bloom filter from keys, on the device. The filter is split into 32
+ * byte blocks, and each key sets 8 bits in a single block, so that both
+ * building and probing touch one memory sector per key. The filter is
+ * cleared first.
+ *
+ * @param filter The filter, its size is rounded down to whole blocks, see
+ * `mc_bloom_filter_size()`
+ * @param keys The keys, `uint32_t` or `uint64_t`
+ * @param count The number of keys
+ * @param keySize The size of a key, 4 or 8 bytes
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_bloom_build(
+    mc_Buffer* filter,
+    mc_Buffer* keys,
+    uint32_t count,
+    uint32_t keySize
+);
+
+/**
+ * Probe a Bloom filter with keys, on the device, writing a selection bitmap
+ * of the keys that may be in the filter (to use with `mc_compact()`).
+ *
+ * @param filter The filter, built by `mc_bloom_build()`
+ * @param keys The keys, of the same type as the keys of the filter
+ * @param count The number of keys
+ * @param keySize The size of a key, 4 or 8 bytes
+ * @param selection Receives the bitmap, one bit per key, as `(count + 31) /
+ * 32` `uint`s
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_bloom_probe(
+    mc_Buffer* filter,
+    mc_Buffer* keys,
+    uint32_t count,
+    uint32_t keySize,
+    mc_Buffer* selection
+);
+
+/**
+ * LU factorize a batch of square matrices with partial pivoting, in place, on
+ * the device: `P A = L U`, with the unit lower factor below the diagonal and
+ * the upper factor above and on it. Each matrix is kept in registers, one
+ * invocation per row, and the kernels are compiled per matrix size on first
+ * use.
+ *
+ * The matrices are row-major `float`s, matrix `i` starting `i * stride`
+ * floats into the buffer.
+ *
+ * @param matrices The matrices
+ * @param pivots Receives `n` `uint`s per matrix: row `k` was exchanged with
+ * row `pivots[k]` at step `k` (LAPACK style, 0-based)
+ * @param n The size of the matrices, 1 to 64
+ * @param count The number of matrices
+ * @param stride The distance between matrices in floats, at least `n * n`
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_batched_lu(
+    mc_Buffer* matrices,
+    mc_Buffer* pivots,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride
+);
+
+/**
+ * Cholesky factorize a batch of symmetric positive definite matrices in
+ * place, on the device: `A = L L^T`. Only the lower part is read, and the
+ * upper part is zeroed. See `mc_batched_lu()` for the layout.
+ *
+ * @param matrices The matrices
+ * @param n The size of the matrices, 1 to 64
+ * @param count The number of matrices
+ * @param stride The distance between matrices in floats, at least `n * n`
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_batched_cholesky(
+    mc_Buffer* matrices,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride
+);
+
+/**
+ * Solve a batch of triangular systems `op(A) x = b` in place, on the device,
+ * with one right hand side per matrix. See `mc_batched_lu()` for the layout.
+ *
+ * @param matrices The triangular matrices, only the used triangle is read
+ * @param rhs The right hand sides, `n` floats per matrix, receives `x`
+ * @param n The size of the matrices, 1 to 64
+ * @param count The number of matrices
+ * @param stride The distance between matrices in floats, at least `n * n`
+ * @param upper `true` to use the upper triangle, `false` for the lower one
+ * @param transposed `true` to solve with the transposed triangle
+ * @param unitDiagonal `true` to assume ones on the diagonal
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_batched_triangular_solve(
+    mc_Buffer* matrices,
+    mc_Buffer* rhs,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride,
+    bool upper,
+    bool transposed,
+    bool unitDiagonal
+);
+
+/**
+ * Solve a batch of systems `A x = b` in place from their LU factors, as
+ * computed by `mc_batched_lu()`.
+ *
+ * @param matrices The LU factors
+ * @param pivots The pivots
+ * @param rhs The right hand sides, `n` floats per matrix, receives `x`
+ * @param n The size of the matrices, 1 to 64
+ * @param count The number of matrices
+ * @param stride The distance between matrices in floats, at least `n * n`
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_batched_lu_solve(
+    mc_Buffer* matrices,
+    mc_Buffer* pivots,
+    mc_Buffer* rhs,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride
+);
+
+/**
+ * Solve a batch of systems `A x = b` in place from their Cholesky factors, as
+ * computed by `mc_batched_cholesky()`.
+ *
+ * @param matrices The Cholesky factors
+ * @param rhs The right hand sides, `n` floats per matrix, receives `x`
+ * @param n The size of the matrices, 1 to 64
+ * @param count The number of matrices
+ * @param stride The distance between matrices in floats, at least `n * n`
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_batched_cholesky_solve(
+    mc_Buffer* matrices,
+    mc_Buffer* rhs,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride
+);
+
+/**
+ * Apply softmax to each row of a matrix, in a single pass over the data. Each
+ * row is handled by one workgroup, and a variant of the kernel is compiled
+ * for each row length on first use.
+ *
+ * @param input The rows, packed one after the other
+ * @param output Receives the results, can be the same buffer as `input`
+ * @param rowCount The number of rows
+ * @param rowLength The length of the rows, 1 to 16384 (even for f16)
+ * @param format The format of the input and output
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_softmax(
+    mc_Buffer* input,
+    mc_Buffer* output,
+    uint32_t rowCount,
+    uint32_t rowLength,
+    mc_FloatFormat format
+);
+
+/**
+ * Apply log-softmax to each row of a matrix, see `mc_softmax()`.
+ *
+ * @param input The rows, packed one after the other
+ * @param output Receives the results, can be the same buffer as `input`
+ * @param rowCount The number of rows
+ * @param rowLength The length of the rows, 1 to 16384 (even for f16)
+ * @param format The format of the input and output
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_log_softmax(
+    mc_Buffer* input,
+    mc_Buffer* output,
+    uint32_t rowCount,
+    uint32_t rowLength,
+    mc_FloatFormat format
+);
+
+/**
+ * Normalize each row of a matrix to a zero mean and unit variance, then scale
+ * and shift it: `(x - mean) / sqrt(var + epsilon) * gamma + beta`. See
+ * `mc_softmax()`.
+ *
+ * @param input The rows, packed one after the other
+ * @param output Receives the results, can be the same buffer as `input`
+ * @param rowCount The number of rows
+ * @param rowLength The length of the rows, 1 to 16384 (even for f16)
+ * @param format The format of the input and output
+ * @param gamma `rowLength` float scales, can be `NULL`
+ * @param beta `rowLength` float shifts, can be `NULL`
+ * @param epsilon Added to the variance
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_layer_norm(
+    mc_Buffer* input,
+    mc_Buffer* output,
+    uint32_t rowCount,
+    uint32_t rowLength,
+    mc_FloatFormat format,
+    mc_Buffer* gamma,
+    mc_Buffer* beta,
+    float epsilon
+);
+
+/**
+ * Normalize each row of a matrix by its root mean square, then scale it:
+ * `x / sqrt(mean(x^2) + epsilon) * gamma`. See `mc_softmax()`.
+ *
+ * @param input The rows, packed one after the other
+ * @param output Receives the results, can be the same buffer as `input`
+ * @param rowCount The number of rows
+ * @param rowLength The length of the rows, 1 to 16384 (even for f16)
+ * @param format The format of the input and output
+ * @param gamma `rowLength` float scales, can be `NULL`
+ * @param epsilon Added to the mean square
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_rms_norm(
+    mc_Buffer* input,
+    mc_Buffer* output,
+    uint32_t rowCount,
+    uint32_t rowLength,
+    mc_FloatFormat format,
+    mc_Buffer* gamma,
+    float epsilon
+);
+
+/**
+ * Sort many independent segments of `uint` keys (and their values) in place,
+ * on the device, in a single submission. The segments are binned by length:
+ * up to 16 keys are sorted in the registers of one invocation, up to 2048 in
+ * the shared memory of one workgroup, and the larger ones with a radix sort
+ * through global memory, one workgroup each. The sort is stable.
+ *
+ * @param keys The keys
+ * @param values The `uint` values, can be `NULL`, at least as large as `keys`
+ * @param segmentOffsets `count + 1` `uint` offsets, segment `i` is the keys
+ * from `segmentOffsets[i]` to `segmentOffsets[i + 1]`
+ * @param count The number of segments
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_segmented_sort(
+    mc_Buffer* keys,
+    mc_Buffer* values,
+    mc_Buffer* segmentOffsets,
+    uint32_t count
+);
+
+/**
+ * Gather elements by index, on the device: element `i` of `dst` is element
+ * `indices[i]` of `src`. Indices past the end of `src` are skipped. The
+ * elements are moved 16 or 8 bytes at a time when the element size and
+ * strides are multiples of it.
+ *
+ * @param src The elements to gather from
+ * @param indices `count` `uint` indices into `src`, for example the values
+ * sorted by `mc_segmented_sort()` or the output of `mc_compact()`
+ * @param dst Receives the `count` gathered elements
+ * @param count The number of elements to gather
+ * @param elemSize The size of an element, a multiple of 4 bytes
+ * @param srcStride The distance between the elements of `src` in bytes, a
+ * multiple of 4, or 0 for `elemSize`
+ * @param dstStride The distance between the elements of `dst` in bytes, a
+ * multiple of 4, or 0 for `elemSize`
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_gather(
+    mc_Buffer* src,
+    mc_Buffer* indices,
+    mc_Buffer* dst,
+    uint32_t count,
+    uint32_t elemSize,
+    uint32_t srcStride,
+    uint32_t dstStride
+);
+
+/**
+ * Scatter elements by index, on the device: element `i` of `src` is written
+ * to (or added to) element `indices[i]` of `dst`. Indices past the end of
+ * `dst` are skipped. With `MC_SCATTER_OP_STORE`, the last write wins when
+ * indices repeat, in no particular order. See `mc_gather()`.
+ *
+ * @param src The `count` elements to scatter
+ * @param indices `count` `uint` indices into `dst`
+ * @param dst Receives the elements
+ * @param count The number of elements to scatter
+ * @param elemSize The size of an element, a multiple of 4 bytes
+ * @param srcStride The distance between the elements of `src` in bytes, a
+ * multiple of 4, or 0 for `elemSize`
+ * @param dstStride The distance between the elements of `dst` in bytes, a
+ * multiple of 4, or 0 for `elemSize`
+ * @param op How the elements are combined with the destination
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_scatter(
+    mc_Buffer* src,
+    mc_Buffer* indices,
+    mc_Buffer* dst,
+    uint32_t count,
+    uint32_t elemSize,
+    uint32_t srcStride,
+    uint32_t dstStride,
+    mc_ScatterOp op
+);
+
+/**
+ * Apply a permutation to packed elements, on the device: element `i` of `dst`
+ * is element `permutation[i]` of `src` (a gather), or, if `inverse` is set,
+ * element `i` of `src` goes to element `permutation[i]` of `dst` (a
+ * scatter). See `mc_gather()`.
+ *
+ * @param src The `count` elements to permute
+ * @param permutation `count` distinct `uint` indices
+ * @param dst Receives the permuted elements, must not be `src`
+ * @param count The number of elements
+ * @param elemSize The size of an element, a multiple of 4 bytes
+ * @param inverse Whether to apply the inverse permutation
+ * @return The time taken, in seconds, or -1.0 on error
+ */
+double mc_permute(
+    mc_Buffer* src,
+    mc_Buffer* permutation,
+    mc_Buffer* dst,
+    uint32_t count,
+    uint32_t elemSize,
+    bool inverse
+);
+
 /**
  * Read text/data from a file
  * @param filename The name of the file to read
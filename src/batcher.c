@@ -0,0 +1,372 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "batcher.h"
+#include "buffer.h"
+#include "device.h"
+#include "dispatch.h"
+#include "hybrid_buffer.h"
+#include "log.h"
+#include "program.h"
+
+#define MC_BATCHER_MIN_BUFF_SIZE 4096
+
+// grow a batch buffer (its content is not kept), only called by the worker.
+// The buffer is created even for an empty batch, as it is always bound
+static bool mc_batcher_reserve(
+    mc_Batcher* batcher,
+    mc_HBuffer** hBuffer,
+    uint64_t size
+) {
+    uint64_t cap = *hBuffer ? mc_hybrid_buffer_get_size(*hBuffer) : 0;
+    if (*hBuffer && cap >= size) return true;
+
+    if (cap < MC_BATCHER_MIN_BUFF_SIZE) cap = MC_BATCHER_MIN_BUFF_SIZE;
+    while (cap < size) cap *= 2;
+
+    DEBUG(batcher, "growing batch buffer to %ld bytes", cap);
+    mc_hybrid_buffer_destroy(*hBuffer);
+    *hBuffer = mc_hybrid_buffer_create(batcher->device, cap);
+    return *hBuffer != NULL;
+}
+
+// pack the inputs, run the program once for the whole batch and scatter the
+// outputs, in a single submission
+static bool mc_batcher_run(
+    mc_Batcher* batcher,
+    uint32_t count,
+    mc_BatchItem* items
+) {
+    uint64_t tableSize = sizeof(uint32_t) * 4 * count;
+    uint64_t inSize = 0;
+    uint64_t outSize = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        inSize += items[i].inSize;
+        outSize += items[i].future->outSize;
+    }
+
+    if (!mc_batcher_reserve(batcher, &batcher->table, tableSize)
+        || !mc_batcher_reserve(batcher, &batcher->input, inSize)
+        || !mc_batcher_reserve(batcher, &batcher->output, outSize))
+        return false;
+
+    uint32_t* table = batcher->table->cpuBuff->map;
+    char* in = batcher->input->cpuBuff->map;
+    uint64_t inOffset = 0;
+    uint64_t outOffset = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        table[4 * i + 0] = inOffset / 4;
+        table[4 * i + 1] = items[i].inSize / 4;
+        table[4 * i + 2] = outOffset / 4;
+        table[4 * i + 3] = items[i].future->outSize / 4;
+        memcpy(in + inOffset, items[i].in, items[i].inSize);
+        inOffset += items[i].inSize;
+        outOffset += items[i].future->outSize;
+    }
+
+    mc_Dispatch* dispatch = mc_dispatch_create(batcher->device);
+    if (!dispatch) return false;
+
+    vkCmdCopyBuffer(
+        dispatch->cmdBuff,
+        batcher->table->cpuBuff->buf,
+        batcher->table->gpuBuff.buf,
+        1,
+        &(VkBufferCopy){0, 0, tableSize}
+    );
+    if (inSize) {
+        vkCmdCopyBuffer(
+            dispatch->cmdBuff,
+            batcher->input->cpuBuff->buf,
+            batcher->input->gpuBuff.buf,
+            1,
+            &(VkBufferCopy){0, 0, inSize}
+        );
+    }
+    mc_dispatch_barrier(dispatch);
+
+    uint32_t buffCount = 3 + batcher->buffCount;
+    mc_Buffer** buffs = malloc(sizeof *buffs * buffCount);
+    buffs[0] = (mc_Buffer*)batcher->table;
+    buffs[1] = (mc_Buffer*)batcher->input;
+    buffs[2] = (mc_Buffer*)batcher->output;
+    for (uint32_t i = 0; i < batcher->buffCount; i++)
+        buffs[3 + i] = batcher->buffs[i];
+
+    bool ok = mc_dispatch_add(
+        dispatch,
+        batcher->program,
+        (uint32_t[]){count, batcher->groupsPerItem, 1},
+        buffCount,
+        buffs
+    );
+    free(buffs);
+
+    if (ok && outSize) {
+        mc_dispatch_barrier(dispatch);
+        vkCmdCopyBuffer(
+            dispatch->cmdBuff,
+            batcher->output->gpuBuff.buf,
+            batcher->output->cpuBuff->buf,
+            1,
+            &(VkBufferCopy){0, 0, outSize}
+        );
+    }
+
+    ok = ok && mc_dispatch_finish(dispatch);
+    if (ok) ok = mc_dispatch_submit(dispatch) >= 0.0;
+    mc_dispatch_destroy(dispatch);
+    if (!ok) return false;
+
+    char* out = batcher->output->cpuBuff->map;
+    for (uint32_t i = 0; i < count; i++) {
+        mc_Future* future = items[i].future;
+        memcpy(future->out, out, future->outSize);
+        out += future->outSize;
+    }
+
+    return true;
+}
+
+static int mc_batcher_worker(void* arg) {
+    mc_Batcher* batcher = arg;
+
+    // keep the packing and scattering copies next to the staging memory
+    int32_t numaNode = batcher->device->hostNumaNode;
+    if (numaNode >= 0 && !mc_pin_thread_to_numa_node(numaNode))
+        WARN(batcher, "failed to pin batcher thread to numa node %d", numaNode);
+
+    mtx_lock(&batcher->lock);
+    while (true) {
+        while (!batcher->stopping && !batcher->itemCount)
+            cnd_wait(&batcher->pending, &batcher->lock);
+        if (!batcher->itemCount) break;
+
+        // wait until the batch is full, or its oldest item has waited long
+        // enough
+        while (!batcher->stopping && !batcher->flushing
+               && batcher->itemCount < batcher->maxItems) {
+            double left
+                = batcher->items[0].time + batcher->maxDelay - mc_get_time();
+            if (left <= 0.0) break;
+
+            struct timespec deadline;
+            timespec_get(&deadline, TIME_UTC);
+            uint64_t nsec = deadline.tv_nsec + (uint64_t)(left * 1e9);
+            deadline.tv_sec += nsec / 1000000000;
+            deadline.tv_nsec = nsec % 1000000000;
+            cnd_timedwait(&batcher->pending, &batcher->lock, &deadline);
+        }
+
+        uint32_t count = batcher->itemCount < batcher->maxItems
+                           ? batcher->itemCount
+                           : batcher->maxItems;
+        mc_BatchItem* batch = malloc(sizeof *batch * count);
+        memcpy(batch, batcher->items, sizeof *batch * count);
+        batcher->itemCount -= count;
+        memmove(
+            batcher->items,
+            batcher->items + count,
+            sizeof *batch * batcher->itemCount
+        );
+        if (!batcher->itemCount) batcher->flushing = false;
+        mtx_unlock(&batcher->lock);
+
+        // new requests are accepted while the batch runs
+        DEBUG(batcher, "running a batch of %d request(s)", count);
+        bool ok = mc_batcher_run(batcher, count, batch);
+        for (uint32_t i = 0; i < count; i++) free(batch[i].in);
+
+        mtx_lock(&batcher->lock);
+        for (uint32_t i = 0; i < count; i++) {
+            batch[i].future->done = true;
+            batch[i].future->ok = ok;
+        }
+        cnd_broadcast(&batcher->finished);
+        free(batch);
+    }
+    mtx_unlock(&batcher->lock);
+
+    return 0;
+}
+
+mc_Batcher* mc_batcher_create(
+    mc_Program* program,
+    uint32_t buffCount,
+    mc_Buffer** buffs,
+    uint32_t groupsPerItem,
+    uint32_t maxItems,
+    double maxDelay
+) {
+    if (!program) return NULL;
+
+    mc_Batcher* batcher = malloc(sizeof *batcher);
+    *batcher = (mc_Batcher){
+        ._instance = program->_instance,
+        .device = program->device,
+        .program = program,
+        .buffCount = buffCount,
+        .buffs = malloc(sizeof *buffs * (buffCount + 1)),
+        .groupsPerItem = groupsPerItem,
+        .maxItems = maxItems,
+        .maxDelay = maxDelay,
+        .itemCount = 0,
+        .itemCap = 0,
+        .items = NULL,
+        .flushing = false,
+        .stopping = false,
+        .workerRunning = false,
+        .table = NULL,
+        .input = NULL,
+        .output = NULL,
+    };
+    if (buffCount) memcpy(batcher->buffs, buffs, sizeof *buffs * buffCount);
+    mtx_init(&batcher->lock, mtx_plain);
+    cnd_init(&batcher->pending);
+    cnd_init(&batcher->finished);
+
+    DEBUG(
+        batcher,
+        "creating batcher, max items: %d, max delay: %fs",
+        maxItems,
+        maxDelay
+    );
+
+    uint32_t maxCount = batcher->device->maxWgCount[0];
+    if (!groupsPerItem || groupsPerItem > batcher->device->maxWgCount[1]) {
+        ERROR(batcher, "invalid number of workgroups per item");
+        mc_batcher_destroy(batcher);
+        return NULL;
+    }
+
+    if (!maxItems || maxItems > maxCount) {
+        ERROR(batcher, "max items must be between 1 and %d", maxCount);
+        mc_batcher_destroy(batcher);
+        return NULL;
+    }
+
+    if (thrd_create(&batcher->worker, mc_batcher_worker, batcher)
+        != thrd_success) {
+        ERROR(batcher, "failed to start batcher thread");
+        mc_batcher_destroy(batcher);
+        return NULL;
+    }
+    batcher->workerRunning = true;
+
+    return batcher;
+}
+
+void mc_batcher_destroy(mc_Batcher* batcher) {
+    if (!batcher) return;
+    DEBUG(batcher, "destroying batcher");
+
+    // the worker runs the remaining requests before exiting
+    mtx_lock(&batcher->lock);
+    batcher->stopping = true;
+    cnd_broadcast(&batcher->pending);
+    mtx_unlock(&batcher->lock);
+    if (batcher->workerRunning) thrd_join(batcher->worker, NULL);
+
+    mc_hybrid_buffer_destroy(batcher->output);
+    mc_hybrid_buffer_destroy(batcher->input);
+    mc_hybrid_buffer_destroy(batcher->table);
+    cnd_destroy(&batcher->finished);
+    cnd_destroy(&batcher->pending);
+    mtx_destroy(&batcher->lock);
+    free(batcher->items);
+    free(batcher->buffs);
+    free(batcher);
+}
+
+mc_Future* mc_batcher_submit(
+    mc_Batcher* batcher,
+    uint64_t inSize,
+    const void* in,
+    uint64_t outSize,
+    void* out
+) {
+    if (!batcher) return NULL;
+
+    if (inSize % 4 || outSize % 4) {
+        ERROR(batcher, "request sizes must be multiples of 4 bytes");
+        return NULL;
+    }
+
+    if ((inSize && !in) || (outSize && !out)) {
+        ERROR(batcher, "request data is NULL");
+        return NULL;
+    }
+
+    mc_Future* future = malloc(sizeof *future);
+    *future = (mc_Future){
+        .batcher = batcher,
+        .outSize = outSize,
+        .out = out,
+        .done = false,
+        .ok = false,
+    };
+
+    mc_BatchItem item = {
+        .future = future,
+        .inSize = inSize,
+        .in = malloc(inSize + 1),
+        .time = mc_get_time(),
+    };
+    if (inSize) memcpy(item.in, in, inSize);
+
+    mtx_lock(&batcher->lock);
+    if (batcher->stopping) {
+        mtx_unlock(&batcher->lock);
+        ERROR(batcher, "batcher is being destroyed");
+        free(item.in);
+        free(future);
+        return NULL;
+    }
+
+    if (batcher->itemCount == batcher->itemCap) {
+        batcher->itemCap = batcher->itemCap ? batcher->itemCap * 2 : 16;
+        batcher->items = realloc(
+            batcher->items,
+            sizeof *batcher->items * batcher->itemCap
+        );
+    }
+    batcher->items[batcher->itemCount++] = item;
+    cnd_signal(&batcher->pending);
+    mtx_unlock(&batcher->lock);
+
+    return future;
+}
+
+void mc_batcher_flush(mc_Batcher* batcher) {
+    if (!batcher) return;
+    mtx_lock(&batcher->lock);
+    if (batcher->itemCount) batcher->flushing = true;
+    cnd_signal(&batcher->pending);
+    mtx_unlock(&batcher->lock);
+}
+
+bool mc_future_is_done(mc_Future* future) {
+    if (!future) return false;
+    mtx_lock(&future->batcher->lock);
+    bool done = future->done;
+    mtx_unlock(&future->batcher->lock);
+    return done;
+}
+
+bool mc_future_wait(mc_Future* future) {
+    if (!future) return false;
+    mc_Batcher* batcher = future->batcher;
+
+    mtx_lock(&batcher->lock);
+    while (!future->done) cnd_wait(&batcher->finished, &batcher->lock);
+    bool ok = future->ok;
+    mtx_unlock(&batcher->lock);
+
+    free(future);
+    return ok;
+}
+
+void mc_future_destroy(mc_Future* future) {
+    mc_future_wait(future);
+}
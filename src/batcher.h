@@ -0,0 +1,51 @@
+#ifndef MC_BATCHER_H
+#define MC_BATCHER_H
+
+#include <stdbool.h>
+#include <threads.h>
+
+#include "microcompute.h"
+#include "microcompute_extra.h"
+
+struct mc_Future {
+    mc_Batcher* batcher;
+    uint64_t outSize;
+    void* out;
+    bool done;
+    bool ok;
+};
+
+// a submitted request, waiting to be batched
+typedef struct mc_BatchItem {
+    mc_Future* future;
+    uint64_t inSize;
+    void* in; // copy of the input, owned by the batcher
+    double time;
+} mc_BatchItem;
+
+struct mc_Batcher {
+    mc_Instance* _instance;
+    mc_Device* device;
+    mc_Program* program;
+    uint32_t buffCount; // extra buffers, bound after the batch buffers
+    mc_Buffer** buffs;
+    uint32_t groupsPerItem;
+    uint32_t maxItems;
+    double maxDelay;
+    mtx_t lock;
+    cnd_t pending;  // signaled when items are submitted, flushed or stopping
+    cnd_t finished; // signaled when a batch finishes
+    uint32_t itemCount;
+    uint32_t itemCap;
+    mc_BatchItem* items;
+    bool flushing;
+    bool stopping;
+    bool workerRunning;
+    thrd_t worker;
+    // only used by the worker
+    mc_HBuffer* table;
+    mc_HBuffer* input;
+    mc_HBuffer* output;
+};
+
+#endif // MC_BATCHER_H
@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "dispatch.h"
+#include "log.h"
+#include "program.h"
+
+// a block is 8 words (32 bytes, one memory sector), and a key sets one bit in
+// each word of a single block
+#define MC_BLOOM_BLOCK_SIZE 32
+
+// split block Bloom filter: the key hash picks the block, and a second hash
+// times a per-word salt picks the bit of each word; the probe packs the
+// results of each 32 keys into a word of the selection bitmap
+static const char* bloomSource
+    = "#version 450\n"
+      "layout(local_size_x = 256) in;\n"
+      "layout(std430, binding = 0) buffer keyBuff {\n"
+      "    uint keys[];\n"
+      "};\n"
+      "layout(std430, binding = 1) buffer filterBuff {\n"
+      "    uint words[];\n"
+      "};\n"
+      "layout(std430, binding = 2) buffer bitmapBuff {\n"
+      "    uint bitmap[];\n"
+      "};\n"
+      "layout(push_constant) uniform Push {\n"
+      "    uint count;\n"
+      "    uint blockCount;\n"
+      "    uint wide;\n"
+      "    uint probe;\n"
+      "};\n"
+      "const uint salts[8] = uint[8](\n"
+      "    0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,\n"
+      "    0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u\n"
+      ");\n"
+      "shared uint sBits[8];\n"
+      "uint hash(uint h) {\n"
+      "    h ^= h >> 16;\n"
+      "    h *= 0x85ebca6bu;\n"
+      "    h ^= h >> 13;\n"
+      "    h *= 0xc2b2ae35u;\n"
+      "    h ^= h >> 16;\n"
+      "    return h;\n"
+      "}\n"
+      "void main(void) {\n"
+      "    uint lane = gl_LocalInvocationID.x;\n"
+      "    uint group = gl_WorkGroupID.y * gl_NumWorkGroups.x\n"
+      "               + gl_WorkGroupID.x;\n"
+      "    uint i = group * 256u + lane;\n"
+      "    if (probe != 0u) {\n"
+      "        if (lane < 8u) sBits[lane] = 0u;\n"
+      "        barrier();\n"
+      "    }\n"
+      "    if (i < count) {\n"
+      "        uint h = wide != 0u\n"
+      "                   ? hash(keys[2u * i] ^ hash(keys[2u * i + 1u]))\n"
+      "                   : hash(keys[i]);\n"
+      "        uint hi, lo;\n"
+      "        umulExtended(h, blockCount, hi, lo);\n"
+      "        uint block = hi * 8u;\n"
+      "        uint h2 = hash(h ^ 0x9e3779b9u);\n"
+      "        bool found = true;\n"
+      "        for (uint k = 0u; k < 8u; k++) {\n"
+      "            uint mask = 1u << ((h2 * salts[k]) >> 27);\n"
+      "            if (probe == 0u) atomicOr(words[block + k], mask);\n"
+      "            else if ((words[block + k] & mask) == 0u) found = false;\n"
+      "        }\n"
+      "        if (probe != 0u && found)\n"
+      "            atomicOr(sBits[lane >> 5], 1u << (lane & 31u));\n"
+      "    }\n"
+      "    if (probe != 0u) {\n"
+      "        barrier();\n"
+      "        uint word = group * 8u + lane;\n"
+      "        if (lane < 8u && word * 32u < count)\n"
+      "            bitmap[word] = sBits[lane];\n"
+      "    }\n"
+      "}\n";
+
+typedef struct mc_BloomPush {
+    uint32_t count;
+    uint32_t blockCount;
+    uint32_t wide;
+    uint32_t probe;
+} mc_BloomPush;
+
+static bool mc_bloom_check(
+    mc_Buffer* filter,
+    mc_Buffer* keys,
+    uint32_t count,
+    uint32_t keySize
+) {
+    if (!filter || !keys) return false;
+    if (keySize != 4 && keySize != 8) {
+        ERROR(filter, "key size must be 4 or 8 bytes");
+        return false;
+    }
+    if (filter->size < MC_BLOOM_BLOCK_SIZE) {
+        ERROR(filter, "filter must hold at least one block");
+        return false;
+    }
+    if (keys->size < (uint64_t)keySize * count) {
+        ERROR(keys, "key buffer too small");
+        return false;
+    }
+    return true;
+}
+
+static double mc_bloom_run(
+    mc_Buffer* filter,
+    mc_Buffer* keys,
+    uint32_t count,
+    uint32_t keySize,
+    mc_Buffer* bitmap
+) {
+    mc_Device* device = filter->device;
+    mc_Program* program
+        = mc_program_get_builtin(device, "bloom", bloomSource);
+    mc_Pipeline* pipeline
+        = program ? mc_program_get_pipeline(program, 3) : NULL;
+    if (!pipeline) return -1.0;
+
+    uint64_t blockCount = filter->size / MC_BLOOM_BLOCK_SIZE;
+    if (blockCount > UINT32_MAX) blockCount = UINT32_MAX;
+
+    mc_Buffer* buffs[3] = {keys, filter, bitmap ? bitmap : filter};
+    mc_Dispatch* dispatch = mc_dispatch_create(device);
+    VkDescriptorSet descSet = NULL;
+    if (dispatch)
+        descSet = mc_dispatch_create_set(dispatch, pipeline, 3, buffs);
+    bool ok = dispatch && descSet;
+
+    if (ok) {
+        // building starts from an empty filter
+        if (!bitmap) {
+            vkCmdFillBuffer(
+                dispatch->cmdBuff,
+                filter->buf,
+                0,
+                blockCount * MC_BLOOM_BLOCK_SIZE,
+                0
+            );
+        }
+
+        // the workgroups are spread over y when there are too many for x
+        uint32_t groups = (count + 255) / 256;
+        uint32_t groupsX = groups < device->maxWgCount[0]
+                             ? groups
+                             : device->maxWgCount[0];
+        uint32_t groupsY = groupsX ? (groups + groupsX - 1) / groupsX : 0;
+
+        mc_BloomPush push = {
+            count,
+            (uint32_t)blockCount,
+            keySize == 8,
+            bitmap != NULL,
+        };
+        mc_dispatch_barrier(dispatch);
+        mc_dispatch_bind(dispatch, pipeline, descSet);
+        mc_dispatch_push(dispatch, pipeline, sizeof push, &push);
+        if (groups) vkCmdDispatch(dispatch->cmdBuff, groupsX, groupsY, 1);
+        ok = mc_dispatch_finish(dispatch);
+    }
+
+    double time = ok ? mc_dispatch_submit(dispatch) : -1.0;
+    mc_dispatch_destroy(dispatch);
+    return time;
+}
+
+uint64_t mc_bloom_filter_size(uint32_t count, uint32_t bitsPerKey) {
+    uint64_t bits = (uint64_t)count * bitsPerKey;
+    uint64_t blockBits = MC_BLOOM_BLOCK_SIZE * 8;
+    uint64_t blocks = (bits + blockBits - 1) / blockBits;
+    return (blocks ? blocks : 1) * MC_BLOOM_BLOCK_SIZE;
+}
+
+double mc_bloom_build(
+    mc_Buffer* filter,
+    mc_Buffer* keys,
+    uint32_t count,
+    uint32_t keySize
+) {
+    if (!mc_bloom_check(filter, keys, count, keySize)) return -1.0;
+    DEBUG(filter, "building a Bloom filter of %d keys", count);
+    return mc_bloom_run(filter, keys, count, keySize, NULL);
+}
+
+double mc_bloom_probe(
+    mc_Buffer* filter,
+    mc_Buffer* keys,
+    uint32_t count,
+    uint32_t keySize,
+    mc_Buffer* selection
+) {
+    if (!mc_bloom_check(filter, keys, count, keySize)) return -1.0;
+    if (!selection) return -1.0;
+    if (selection->size < sizeof(uint32_t) * (((uint64_t)count + 31) / 32)) {
+        ERROR(selection, "selection buffer too small");
+        return -1.0;
+    }
+    DEBUG(filter, "probing a Bloom filter with %d keys", count);
+    return mc_bloom_run(filter, keys, count, keySize, selection);
+}
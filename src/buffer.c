@@ -3,8 +3,126 @@
 
 #include "buffer.h"
 #include "device.h"
+#include "host_memory.h"
 #include "log.h"
 
+static VkBufferCreateInfo mc_buffer_get_create_info(mc_Buffer* buffer) {
+    VkBufferCreateInfo bufferInfo = {0};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = buffer->size;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                     | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                     | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                     | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount = 1;
+    bufferInfo.pQueueFamilyIndices = &buffer->device->queueFamilyIdx;
+    return bufferInfo;
+}
+
+static void mc_buffer_free_memory(mc_Buffer* buffer) {
+    if (buffer->mem) vkFreeMemory(buffer->device->dev, buffer->mem, NULL);
+    if (buffer->buf) vkDestroyBuffer(buffer->device->dev, buffer->buf, NULL);
+    mc_host_memory_free(buffer->hostMem, buffer->hostMemSize);
+    buffer->mem = NULL;
+    buffer->buf = NULL;
+    buffer->hostMem = NULL;
+    buffer->map = NULL;
+}
+
+// back a CPU buffer with host memory allocated by us (with the page size and
+// NUMA node set by mc_device_set_host_memory()), imported with
+// VK_EXT_external_memory_host
+static bool mc_buffer_import_host_memory(mc_Buffer* buffer) {
+    mc_Device* device = buffer->device;
+
+    uint64_t align = device->hostPageSize;
+    if (align < device->hostImportAlignment)
+        align = device->hostImportAlignment;
+    uint64_t size = (buffer->size + align - 1) / align * align;
+
+    buffer->hostMem = mc_host_memory_alloc(
+        size,
+        device->hostPageSize,
+        device->hostNumaNode
+    );
+    if (!buffer->hostMem) return false;
+    buffer->hostMemSize = size;
+
+    VkExternalMemoryBufferCreateInfo externalInfo = {0};
+    externalInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+    externalInfo.handleTypes
+        = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+    // only the allocation is rounded up to whole pages, the buffer keeps the
+    // requested size
+    VkBufferCreateInfo bufferInfo = mc_buffer_get_create_info(buffer);
+    bufferInfo.pNext = &externalInfo;
+
+    if (vkCreateBuffer(device->dev, &bufferInfo, NULL, &buffer->buf)) {
+        mc_buffer_free_memory(buffer);
+        return false;
+    }
+
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(device->dev, buffer->buf, &memReqs);
+
+    VkMemoryHostPointerPropertiesEXT ptrProps = {0};
+    ptrProps.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+    if (memReqs.size > size
+        || device->getHostPointerProps(
+            device->dev,
+            VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+            buffer->hostMem,
+            &ptrProps
+        )) {
+        mc_buffer_free_memory(buffer);
+        return false;
+    }
+
+    VkPhysicalDeviceMemoryProperties memProps;
+    vkGetPhysicalDeviceMemoryProperties(device->physDev, &memProps);
+
+    uint32_t typeBits = memReqs.memoryTypeBits & ptrProps.memoryTypeBits;
+    uint32_t memTypeIdx = memProps.memoryTypeCount;
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
+        VkMemoryPropertyFlags flags = memProps.memoryTypes[i].propertyFlags;
+        bool v = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT & flags;
+        bool c = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT & flags;
+        if (typeBits & (1u << i) && v && c) {
+            memTypeIdx = i;
+            break;
+        }
+    }
+
+    if (memTypeIdx == memProps.memoryTypeCount) {
+        mc_buffer_free_memory(buffer);
+        return false;
+    }
+
+    VkImportMemoryHostPointerInfoEXT importInfo = {0};
+    importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+    importInfo.handleType
+        = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    importInfo.pHostPointer = buffer->hostMem;
+
+    VkMemoryAllocateInfo memAllocInfo = {0};
+    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memAllocInfo.pNext = &importInfo;
+    memAllocInfo.allocationSize = size;
+    memAllocInfo.memoryTypeIndex = memTypeIdx;
+
+    if (vkAllocateMemory(device->dev, &memAllocInfo, NULL, &buffer->mem)
+        || vkBindBufferMemory(device->dev, buffer->buf, buffer->mem, 0)) {
+        mc_buffer_free_memory(buffer);
+        return false;
+    }
+
+    // the memory is already mapped, at the address we allocated
+    buffer->map = buffer->hostMem;
+    return true;
+}
+
 mc_Buffer* mc_buffer_create(
     mc_Device* device,
     mc_BufferType type,
@@ -21,19 +139,21 @@ mc_Buffer* mc_buffer_create(
         .map = NULL,
         .buf = NULL,
         .mem = NULL,
+        .hostMem = NULL,
+        .hostMemSize = 0,
     };
 
     DEBUG(buffer, "initializing buffer of size %ld", size);
 
-    VkBufferCreateInfo bufferInfo = {0};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = buffer->size;
-    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
-                     | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
-                     | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    bufferInfo.queueFamilyIndexCount = 1;
-    bufferInfo.pQueueFamilyIndices = &buffer->device->queueFamilyIdx;
+    // buffers smaller than a page keep using driver memory, rather than
+    // taking a whole (huge)page each
+    if (type == MC_BUFFER_TYPE_CPU && device->hostPageSize
+        && size >= device->hostPageSize) {
+        if (mc_buffer_import_host_memory(buffer)) return buffer;
+        WARN(buffer, "failed to import host memory, using driver memory");
+    }
+
+    VkBufferCreateInfo bufferInfo = mc_buffer_get_create_info(buffer);
 
     if (vkCreateBuffer(buffer->device->dev, &bufferInfo, NULL, &buffer->buf)) {
         ERROR(buffer, "failed to create vulkan buffer");
@@ -133,8 +253,7 @@ mc_Buffer* mc_buffer_create(
 void mc_buffer_destroy(mc_Buffer* buffer) {
     if (!buffer) return;
     DEBUG(buffer, "destroying buffer");
-    if (buffer->mem) vkFreeMemory(buffer->device->dev, buffer->mem, NULL);
-    if (buffer->buf) vkDestroyBuffer(buffer->device->dev, buffer->buf, NULL);
+    mc_buffer_free_memory(buffer);
     free(buffer);
 }
 
@@ -13,6 +13,8 @@ struct mc_Buffer {
     void* map;
     VkBuffer buf;
     VkDeviceMemory mem;
+    void* hostMem; // imported host memory, `NULL` for driver allocated memory
+    uint64_t hostMemSize;
 };
 
 #endif // MC_BUFFER_H
\ No newline at end of file
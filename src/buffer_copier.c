@@ -13,6 +13,7 @@ mc_BufferCopier* mc_buffer_copier_create(mc_Device* device) {
         ._instance = device->_instance,
         .device = device,
         .cmdPool = NULL,
+        .fence = NULL,
     };
 
     VkCommandPoolCreateInfo cmdPoolInfo = {0};
@@ -31,6 +32,15 @@ mc_BufferCopier* mc_buffer_copier_create(mc_Device* device) {
         return NULL;
     }
 
+    VkFenceCreateInfo fenceInfo = {0};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if (vkCreateFence(copier->device->dev, &fenceInfo, NULL, &copier->fence)) {
+        ERROR(copier, "failed to create fence");
+        mc_buffer_copier_destroy(copier);
+        return NULL;
+    }
+
     return copier;
 }
 
@@ -40,6 +50,7 @@ void mc_buffer_copier_destroy(mc_BufferCopier* copier) {
 
     if (copier->cmdPool)
         vkDestroyCommandPool(copier->device->dev, copier->cmdPool, NULL);
+    if (copier->fence) vkDestroyFence(copier->device->dev, copier->fence, NULL);
     free(copier);
 }
 
@@ -91,30 +102,8 @@ uint64_t mc_buffer_copier_copy(
         return 0;
     }
 
-    VkQueue queue;
-    vkGetDeviceQueue(
-        copier->device->dev,
-        copier->device->queueFamilyIdx,
-        0,
-        &queue
-    );
-
-    VkSubmitInfo submitI = {0};
-    submitI.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitI.commandBufferCount = 1;
-    submitI.pCommandBuffers = &cmdBuf;
-
-    if (vkQueueSubmit(queue, 1, &submitI, VK_NULL_HANDLE)) {
-        ERROR(copier, "failed to submit queue");
-        return 0;
-    }
-
-    if (vkQueueWaitIdle(queue)) {
-        ERROR(copier, "failed to wait for queue");
-        return 0;
-    }
-
+    double time = mc_device_submit(copier->device, cmdBuf, copier->fence);
     vkFreeCommandBuffers(copier->device->dev, copier->cmdPool, 1, &cmdBuf);
 
-    return size;
+    return time < 0.0 ? 0 : size;
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ struct mc_BufferCopier {
     mc_Instance* _instance;
     mc_Device* device;
     VkCommandPool cmdPool;
+    VkFence fence;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,618 @@
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define MC_CODEC_AVX2
+#endif
+
+#include "buffer.h"
+#include "codec.h"
+#include "device.h"
+#include "dispatch.h"
+#include "hybrid_buffer.h"
+#include "log.h"
+#include "program.h"
+
+// an encoded stream is `blockCount + 1` block offsets (relative to the end of
+// the offsets), followed by the blocks:
+// - delta: first value, bit width, bit-packed zigzag deltas
+// - frame of reference: min value, bit width, bit-packed `value - min`
+// - zero-run: a 128 bit mask of the non-zero values, then those values
+#define MC_CODEC_HEADER                                                        \
+    "#version 450\n"                                                           \
+    "#define DELTA 1u\n"                                                       \
+    "#define FOR 2u\n"                                                         \
+    "#define ZERO_RUN 3u\n"                                                    \
+    "layout(std430, binding = 0) buffer rawBuff {\n"                           \
+    "    uint raw[];\n"                                                        \
+    "};\n"                                                                     \
+    "layout(std430, binding = 1) buffer codeBuff {\n"                          \
+    "    uint codes[];\n"                                                      \
+    "};\n"                                                                     \
+    "layout(push_constant) uniform Push {\n"                                   \
+    "    uint codec;\n"                                                        \
+    "    uint count;\n"                                                        \
+    "    uint rawOffset;\n"                                                    \
+    "    uint blockCount;\n"                                                   \
+    "    uint pass;\n"                                                         \
+    "};\n"                                                                     \
+    "uint block_index(void) {\n"                                               \
+    "    return gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;\n"   \
+    "}\n"                                                                      \
+    "uint bit_width(uint x) {\n"                                               \
+    "    return x == 0u ? 0u : uint(findMSB(x)) + 1u;\n"                       \
+    "}\n"                                                                      \
+    "uint zero_rank(uint mask[4], uint lane) {\n"                              \
+    "    uint rank = 0u;\n"                                                    \
+    "    for (uint k = 0u; k < lane / 32u; k++)\n"                             \
+    "        rank += uint(bitCount(mask[k]));\n"                               \
+    "    uint below = (1u << (lane % 32u)) - 1u;\n"                            \
+    "    return rank + uint(bitCount(mask[lane / 32u] & below));\n"            \
+    "}\n"
+
+// one workgroup per block. the first pass writes the size of each block, the
+// second one (after the sizes are scanned) writes the blocks
+static const char* encodeSource
+    = MC_CODEC_HEADER
+    "layout(local_size_x = 128) in;\n"
+    "shared uint sMin;\n"
+    "shared uint sMax;\n"
+    "shared uint sMask[4];\n"
+    "void main(void) {\n"
+    "    uint block = block_index();\n"
+    "    if (block >= blockCount) return;\n"
+    "    uint lane = gl_LocalInvocationID.x;\n"
+    "    uint i = block * 128u + lane;\n"
+    "    bool valid = i < count;\n"
+    "    uint v = valid ? raw[rawOffset + i] : 0u;\n"
+    "    if (lane == 0u) {\n"
+    "        sMin = 0xffffffffu;\n"
+    "        sMax = 0u;\n"
+    "    }\n"
+    "    if (lane < 4u) sMask[lane] = 0u;\n"
+    "    barrier();\n"
+    "    uint x = 0u;\n"
+    "    if (codec == DELTA && valid) {\n"
+    "        uint prev = lane == 0u ? v : raw[rawOffset + i - 1u];\n"
+    "        int d = int(v - prev);\n"
+    "        x = uint((d << 1) ^ (d >> 31));\n"
+    "        atomicMax(sMax, x);\n"
+    "    } else if (codec == FOR && valid) {\n"
+    "        atomicMin(sMin, v);\n"
+    "        atomicMax(sMax, v);\n"
+    "    } else if (codec == ZERO_RUN && v != 0u) {\n"
+    "        atomicOr(sMask[lane / 32u], 1u << (lane % 32u));\n"
+    "    }\n"
+    "    barrier();\n"
+    "    uint base = raw[rawOffset + block * 128u];\n"
+    "    uint bits = bit_width(sMax);\n"
+    "    if (codec == FOR) {\n"
+    "        base = sMin;\n"
+    "        bits = bit_width(sMax - sMin);\n"
+    "        x = valid ? v - sMin : 0u;\n"
+    "    }\n"
+    "    uint mask[4] = uint[4](sMask[0], sMask[1], sMask[2], sMask[3]);\n"
+    "    if (pass == 0u) {\n"
+    "        if (lane != 0u) return;\n"
+    "        uint size = 2u + 4u * bits;\n"
+    "        if (codec == ZERO_RUN) {\n"
+    "            size = 4u;\n"
+    "            for (uint k = 0u; k < 4u; k++)\n"
+    "                size += uint(bitCount(mask[k]));\n"
+    "        }\n"
+    "        codes[1u + block] = size;\n"
+    "        return;\n"
+    "    }\n"
+    "    uint start = blockCount + 1u + codes[block];\n"
+    "    if (codec == ZERO_RUN) {\n"
+    "        if (lane < 4u) codes[start + lane] = mask[lane];\n"
+    "        if (v != 0u) codes[start + 4u + zero_rank(mask, lane)] = v;\n"
+    "        return;\n"
+    "    }\n"
+    "    if (lane == 0u) {\n"
+    "        codes[start] = base;\n"
+    "        codes[start + 1u] = bits;\n"
+    "    }\n"
+    "    if (lane < 4u * bits) codes[start + 2u + lane] = 0u;\n"
+    "    memoryBarrierBuffer();\n"
+    "    barrier();\n"
+    "    if (bits == 0u) return;\n"
+    "    uint p = lane * bits;\n"
+    "    uint w = start + 2u + p / 32u;\n"
+    "    uint s = p % 32u;\n"
+    "    atomicOr(codes[w], x << s);\n"
+    "    if (s + bits > 32u) atomicOr(codes[w + 1u], x >> (32u - s));\n"
+    "}\n";
+
+// turns the block sizes into block offsets, in a single workgroup
+static const char* scanSource
+    = MC_CODEC_HEADER
+    "layout(local_size_x = 256) in;\n"
+    "shared uint sSums[256];\n"
+    "void main(void) {\n"
+    "    uint lane = gl_LocalInvocationID.x;\n"
+    "    uint per = (blockCount + 255u) / 256u;\n"
+    "    uint first = min(lane * per, blockCount);\n"
+    "    uint last = min(first + per, blockCount);\n"
+    "    uint sum = 0u;\n"
+    "    for (uint b = first; b < last; b++) sum += codes[1u + b];\n"
+    "    sSums[lane] = sum;\n"
+    "    barrier();\n"
+    "    if (lane == 0u) {\n"
+    "        uint acc = 0u;\n"
+    "        for (uint k = 0u; k < 256u; k++) {\n"
+    "            uint t = sSums[k];\n"
+    "            sSums[k] = acc;\n"
+    "            acc += t;\n"
+    "        }\n"
+    "        codes[0] = 0u;\n"
+    "    }\n"
+    "    barrier();\n"
+    "    uint acc = sSums[lane];\n"
+    "    for (uint b = first; b < last; b++) {\n"
+    "        acc += codes[1u + b];\n"
+    "        codes[1u + b] = acc;\n"
+    "    }\n"
+    "}\n";
+
+// one workgroup per block, deltas are summed with a workgroup scan
+static const char* decodeSource
+    = MC_CODEC_HEADER
+    "layout(local_size_x = 128) in;\n"
+    "shared uint sScan[128];\n"
+    "void main(void) {\n"
+    "    uint block = block_index();\n"
+    "    if (block >= blockCount) return;\n"
+    "    uint lane = gl_LocalInvocationID.x;\n"
+    "    uint i = block * 128u + lane;\n"
+    "    uint start = blockCount + 1u + codes[block];\n"
+    "    uint v = 0u;\n"
+    "    if (codec == ZERO_RUN) {\n"
+    "        uint mask[4] = uint[4](\n"
+    "            codes[start],\n"
+    "            codes[start + 1u],\n"
+    "            codes[start + 2u],\n"
+    "            codes[start + 3u]\n"
+    "        );\n"
+    "        if ((mask[lane / 32u] & (1u << (lane % 32u))) != 0u)\n"
+    "            v = codes[start + 4u + zero_rank(mask, lane)];\n"
+    "    } else {\n"
+    "        uint base = codes[start];\n"
+    "        uint bits = codes[start + 1u];\n"
+    "        uint x = 0u;\n"
+    "        if (bits != 0u) {\n"
+    "            uint p = lane * bits;\n"
+    "            uint w = start + 2u + p / 32u;\n"
+    "            uint s = p % 32u;\n"
+    "            x = codes[w] >> s;\n"
+    "            if (s + bits > 32u) x |= codes[w + 1u] << (32u - s);\n"
+    "            if (bits < 32u) x &= (1u << bits) - 1u;\n"
+    "        }\n"
+    "        v = base + x;\n"
+    "        if (codec == DELTA) {\n"
+    "            sScan[lane] = (x >> 1) ^ (0u - (x & 1u));\n"
+    "            barrier();\n"
+    "            for (uint off = 1u; off < 128u; off <<= 1) {\n"
+    "                uint t = lane >= off ? sScan[lane - off] : 0u;\n"
+    "                barrier();\n"
+    "                sScan[lane] += t;\n"
+    "                barrier();\n"
+    "            }\n"
+    "            v = base + sScan[lane];\n"
+    "        }\n"
+    "    }\n"
+    "    if (i < count) raw[rawOffset + i] = v;\n"
+    "}\n";
+
+typedef struct mc_CodecPush {
+    uint32_t codec;
+    uint32_t count;
+    uint32_t rawOffset;
+    uint32_t blockCount;
+    uint32_t pass;
+} mc_CodecPush;
+
+static uint32_t mc_codec_bit_width(uint32_t x) {
+#if defined(__GNUC__)
+    return x ? 32 - __builtin_clz(x) : 0;
+#else
+    uint32_t bits = 0;
+    while (bits < 32 && x >> bits) bits++;
+    return bits;
+#endif
+}
+
+// the lane loops work on whole blocks with no data dependent branches, so that
+// compilers can vectorize them
+static void mc_codec_pack(const uint32_t* x, uint32_t bits, uint32_t* out) {
+    memset(out, 0, sizeof *out * 4 * bits);
+    if (bits == 0) return;
+    for (uint32_t i = 0; i < MC_CODEC_BLOCK_SIZE; i++) {
+        uint32_t p = i * bits;
+        uint64_t v = (uint64_t)x[i] << (p % 32);
+        out[p / 32] |= (uint32_t)v;
+        if (p % 32 + bits > 32) out[p / 32 + 1] |= (uint32_t)(v >> 32);
+    }
+}
+
+#ifdef MC_CODEC_AVX2
+// 8 lanes at a time: gather the word holding the start of each value and,
+// only where the value straddles two words, the next one (so nothing past the
+// packed bits is read)
+__attribute__((target("avx2"))) static void mc_codec_unpack_avx2(
+    const uint32_t* in,
+    uint32_t bits,
+    uint32_t* x
+) {
+    const int* words = (const int*)in;
+    __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i width = _mm256_set1_epi32(bits);
+    __m256i mask = _mm256_set1_epi32(bits == 32 ? ~0u : (1u << bits) - 1);
+    __m256i one = _mm256_set1_epi32(1);
+    __m256i wordBits = _mm256_set1_epi32(32);
+
+    for (uint32_t i = 0; i < MC_CODEC_BLOCK_SIZE; i += 8) {
+        __m256i lane = _mm256_add_epi32(_mm256_set1_epi32(i), lanes);
+        __m256i p = _mm256_mullo_epi32(lane, width);
+        __m256i word = _mm256_srli_epi32(p, 5);
+        __m256i shift = _mm256_and_si256(p, _mm256_set1_epi32(31));
+        __m256i straddles
+            = _mm256_cmpgt_epi32(_mm256_add_epi32(shift, width), wordBits);
+
+        __m256i lo = _mm256_i32gather_epi32(words, word, 4);
+        __m256i hi = _mm256_mask_i32gather_epi32(
+            _mm256_setzero_si256(),
+            words,
+            _mm256_add_epi32(word, one),
+            straddles,
+            4
+        );
+
+        // shifts of 32 give 0, so `hi` only counts where it was gathered
+        __m256i v = _mm256_or_si256(
+            _mm256_srlv_epi32(lo, shift),
+            _mm256_sllv_epi32(hi, _mm256_sub_epi32(wordBits, shift))
+        );
+        _mm256_storeu_si256((__m256i*)&x[i], _mm256_and_si256(v, mask));
+    }
+}
+#endif
+
+static void mc_codec_unpack(const uint32_t* in, uint32_t bits, uint32_t* x) {
+    if (bits == 0) {
+        memset(x, 0, sizeof *x * MC_CODEC_BLOCK_SIZE);
+        return;
+    }
+#ifdef MC_CODEC_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        mc_codec_unpack_avx2(in, bits, x);
+        return;
+    }
+#endif
+    uint64_t mask = ((uint64_t)1 << bits) - 1;
+    for (uint32_t i = 0; i < MC_CODEC_BLOCK_SIZE; i++) {
+        uint32_t p = i * bits;
+        uint64_t window = in[p / 32];
+        if (p % 32 + bits > 32) window |= (uint64_t)in[p / 32 + 1] << 32;
+        x[i] = (uint32_t)((window >> (p % 32)) & mask);
+    }
+}
+
+uint32_t mc_codec_encode_block(
+    mc_Codec codec,
+    const uint32_t* in,
+    uint32_t count,
+    uint32_t* out
+) {
+    uint32_t x[MC_CODEC_BLOCK_SIZE] = {0};
+
+    if (codec == MC_CODEC_ZERO_RUN) {
+        uint32_t size = 4;
+        memset(out, 0, sizeof *out * 4);
+        for (uint32_t i = 0; i < count; i++) {
+            if (!in[i]) continue;
+            out[i / 32] |= 1u << (i % 32);
+            out[size++] = in[i];
+        }
+        return size;
+    }
+
+    uint32_t base = in[0];
+    uint32_t max = 0;
+    if (codec == MC_CODEC_DELTA) {
+        for (uint32_t i = 1; i < count; i++) {
+            int32_t d = (int32_t)(in[i] - in[i - 1]);
+            x[i] = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+            if (x[i] > max) max = x[i];
+        }
+    } else {
+        for (uint32_t i = 0; i < count; i++) {
+            if (in[i] < base) base = in[i];
+            if (in[i] > max) max = in[i];
+        }
+        for (uint32_t i = 0; i < count; i++) x[i] = in[i] - base;
+        max -= base;
+    }
+
+    uint32_t bits = mc_codec_bit_width(max);
+    out[0] = base;
+    out[1] = bits;
+    mc_codec_pack(x, bits, &out[2]);
+    return 2 + 4 * bits;
+}
+
+void mc_codec_decode_block(
+    mc_Codec codec,
+    const uint32_t* in,
+    uint32_t count,
+    uint32_t* out
+) {
+    if (codec == MC_CODEC_ZERO_RUN) {
+        const uint32_t* values = &in[4];
+        for (uint32_t i = 0; i < count; i++) {
+            bool set = in[i / 32] & (1u << (i % 32));
+            out[i] = set ? *values : 0;
+            values += set;
+        }
+        return;
+    }
+
+    uint32_t x[MC_CODEC_BLOCK_SIZE];
+    mc_codec_unpack(&in[2], in[1], x);
+
+    if (codec == MC_CODEC_DELTA) {
+        uint32_t v = in[0];
+        for (uint32_t i = 0; i < count; i++) {
+            v += (x[i] >> 1) ^ (0u - (x[i] & 1));
+            out[i] = v;
+        }
+    } else {
+        for (uint32_t i = 0; i < count; i++) out[i] = in[0] + x[i];
+    }
+}
+
+// gets a scratch buffer big enough to hold `blockCount` encoded blocks
+static mc_HBuffer* mc_codec_get_scratch(
+    mc_HBuffer* hBuffer,
+    uint32_t blockCount
+) {
+    uint64_t size = sizeof(uint32_t)
+                  * (blockCount + 1 + (uint64_t)blockCount
+                                          * MC_CODEC_MAX_BLOCK_WORDS);
+
+    if (hBuffer->scratch
+        && mc_hybrid_buffer_get_size(hBuffer->scratch) < size) {
+        mc_hybrid_buffer_destroy(hBuffer->scratch);
+        hBuffer->scratch = NULL;
+    }
+
+    if (!hBuffer->scratch) {
+        mc_Device* device = hBuffer->gpuBuff.device;
+        hBuffer->scratch = mc_hybrid_buffer_create(device, size);
+    }
+    return hBuffer->scratch;
+}
+
+static bool mc_codec_check(
+    mc_HBuffer* hBuffer,
+    uint64_t offset,
+    uint64_t size,
+    mc_Codec codec
+) {
+    if (codec != MC_CODEC_DELTA && codec != MC_CODEC_FOR
+        && codec != MC_CODEC_ZERO_RUN) {
+        ERROR(hBuffer, "unknown codec");
+        return false;
+    }
+
+    if (offset % sizeof(uint32_t) || size % sizeof(uint32_t)) {
+        ERROR(hBuffer, "compressed transfers must be aligned to 4 bytes");
+        return false;
+    }
+
+    if (offset + size > mc_hybrid_buffer_get_size(hBuffer)
+        || size / sizeof(uint32_t) > UINT32_MAX) {
+        ERROR(hBuffer, "range out of bounds");
+        return false;
+    }
+
+    return true;
+}
+
+// a pass of the codec shaders, over all the blocks or in a single workgroup
+typedef struct mc_CodecPass {
+    mc_Program* program;
+    uint32_t pass;
+    bool single;
+} mc_CodecPass;
+
+// runs the given passes, with the raw data and the scratch buffer bound
+static bool mc_codec_run(
+    mc_HBuffer* hBuffer,
+    uint32_t passCount,
+    mc_CodecPass* passes,
+    mc_CodecPush push
+) {
+    mc_Device* device = hBuffer->gpuBuff.device;
+    mc_Buffer* buffs[2] = {&hBuffer->gpuBuff, &hBuffer->scratch->gpuBuff};
+
+    // the blocks are spread over y when there are too many for x
+    uint32_t groupsX = push.blockCount < device->maxWgCount[0]
+                         ? push.blockCount
+                         : device->maxWgCount[0];
+    uint32_t groupsY = (push.blockCount + groupsX - 1) / groupsX;
+
+    mc_Dispatch* dispatch = mc_dispatch_create(device);
+    if (!dispatch) return false;
+
+    for (uint32_t i = 0; i < passCount && !dispatch->failed; i++) {
+        mc_Program* program = passes[i].program;
+        mc_Pipeline* pipeline
+            = program ? mc_program_get_pipeline(program, 2) : NULL;
+        if (!pipeline) {
+            dispatch->failed = true;
+            break;
+        }
+
+        VkDescriptorSet descSet
+            = mc_dispatch_create_set(dispatch, pipeline, 2, buffs);
+        if (!descSet) break;
+
+        if (i > 0) mc_dispatch_barrier(dispatch);
+        push.pass = passes[i].pass;
+        mc_dispatch_bind(dispatch, pipeline, descSet);
+        mc_dispatch_push(dispatch, pipeline, sizeof push, &push);
+        if (passes[i].single) vkCmdDispatch(dispatch->cmdBuff, 1, 1, 1);
+        else vkCmdDispatch(dispatch->cmdBuff, groupsX, groupsY, 1);
+    }
+
+    bool ok = mc_dispatch_finish(dispatch);
+    if (ok) ok = mc_dispatch_submit(dispatch) >= 0.0;
+    mc_dispatch_destroy(dispatch);
+    return ok;
+}
+
+uint64_t mc_hybrid_buffer_read_compressed(
+    mc_HBuffer* hBuffer,
+    uint64_t offset,
+    uint64_t size,
+    void* data,
+    mc_Codec codec
+) {
+    if (!hBuffer) return 0;
+    if (codec == MC_CODEC_NONE)
+        return mc_hybrid_buffer_read(hBuffer, offset, size, data);
+
+    DEBUG(hBuffer, "reading %ld compressed bytes from hybrid buffer", size);
+
+    if (!mc_codec_check(hBuffer, offset, size, codec)) return 0;
+    if (size == 0) return 0;
+
+    uint32_t count = size / sizeof(uint32_t);
+    uint32_t blockCount
+        = (count + MC_CODEC_BLOCK_SIZE - 1) / MC_CODEC_BLOCK_SIZE;
+    mc_HBuffer* scratch = mc_codec_get_scratch(hBuffer, blockCount);
+    if (!scratch) return 0;
+
+    mc_Device* device = hBuffer->gpuBuff.device;
+    mc_Program* encode
+        = mc_program_get_builtin(device, "codec_encode", encodeSource);
+    mc_Program* scan = mc_program_get_builtin(device, "codec_scan", scanSource);
+
+    mc_CodecPass passes[3] = {
+        {encode, 0, false},
+        {scan, 0, true},
+        {encode, 1, false},
+    };
+    mc_CodecPush push = {
+        .codec = codec,
+        .count = count,
+        .rawOffset = offset / sizeof(uint32_t),
+        .blockCount = blockCount,
+        .pass = 0,
+    };
+    if (!mc_codec_run(hBuffer, 3, passes, push)) return 0;
+
+    // read the block offsets first, then only the encoded bytes
+    uint32_t* codes = scratch->cpuBuff->map;
+    uint64_t tableSize = sizeof *codes * (blockCount + 1);
+    if (mc_buffer_copier_copy(
+            scratch->copier,
+            &scratch->gpuBuff,
+            scratch->cpuBuff,
+            0,
+            0,
+            tableSize
+        )
+        != tableSize)
+        return 0;
+
+    uint64_t codesSize = sizeof *codes * codes[blockCount];
+    if (codesSize
+        && mc_buffer_copier_copy(
+               scratch->copier,
+               &scratch->gpuBuff,
+               scratch->cpuBuff,
+               tableSize,
+               tableSize,
+               codesSize
+           ) != codesSize)
+        return 0;
+
+    uint32_t* out = data;
+    for (uint32_t b = 0; b < blockCount; b++) {
+        uint32_t first = b * MC_CODEC_BLOCK_SIZE;
+        uint32_t n = count - first < MC_CODEC_BLOCK_SIZE ? count - first
+                                                         : MC_CODEC_BLOCK_SIZE;
+        const uint32_t* in = &codes[blockCount + 1 + codes[b]];
+        mc_codec_decode_block(codec, in, n, &out[first]);
+    }
+
+    return size;
+}
+
+uint64_t mc_hybrid_buffer_write_compressed(
+    mc_HBuffer* hBuffer,
+    uint64_t offset,
+    uint64_t size,
+    void* data,
+    mc_Codec codec
+) {
+    if (!hBuffer) return 0;
+    if (codec == MC_CODEC_NONE)
+        return mc_hybrid_buffer_write(hBuffer, offset, size, data);
+
+    DEBUG(hBuffer, "writing %ld compressed bytes to hybrid buffer", size);
+
+    if (!mc_codec_check(hBuffer, offset, size, codec)) return 0;
+    if (size == 0) return 0;
+
+    uint32_t count = size / sizeof(uint32_t);
+    uint32_t blockCount
+        = (count + MC_CODEC_BLOCK_SIZE - 1) / MC_CODEC_BLOCK_SIZE;
+    mc_HBuffer* scratch = mc_codec_get_scratch(hBuffer, blockCount);
+    if (!scratch) return 0;
+
+    // encode straight into the mapped staging memory
+    uint32_t* codes = scratch->cpuBuff->map;
+    uint32_t* in = data;
+    codes[0] = 0;
+    for (uint32_t b = 0; b < blockCount; b++) {
+        uint32_t first = b * MC_CODEC_BLOCK_SIZE;
+        uint32_t n = count - first < MC_CODEC_BLOCK_SIZE ? count - first
+                                                         : MC_CODEC_BLOCK_SIZE;
+        uint32_t* out = &codes[blockCount + 1 + codes[b]];
+        uint32_t words = mc_codec_encode_block(codec, &in[first], n, out);
+        codes[b + 1] = codes[b] + words;
+    }
+
+    uint64_t codesSize = sizeof *codes * (blockCount + 1 + codes[blockCount]);
+    if (mc_buffer_copier_copy(
+            scratch->copier,
+            scratch->cpuBuff,
+            &scratch->gpuBuff,
+            0,
+            0,
+            codesSize
+        )
+        != codesSize)
+        return 0;
+
+    mc_Device* device = hBuffer->gpuBuff.device;
+    mc_CodecPass pass = {
+        mc_program_get_builtin(device, "codec_decode", decodeSource),
+        0,
+        false,
+    };
+    mc_CodecPush push = {
+        .codec = codec,
+        .count = count,
+        .rawOffset = offset / sizeof(uint32_t),
+        .blockCount = blockCount,
+        .pass = 0,
+    };
+    if (!mc_codec_run(hBuffer, 1, &pass, push)) return 0;
+
+    return size;
+}
@@ -0,0 +1,29 @@
+#ifndef MC_CODEC_H
+#define MC_CODEC_H
+
+#include "microcompute_extra.h"
+
+// the number of uint32_t values per block, every block is encoded on its own
+#define MC_CODEC_BLOCK_SIZE 128
+
+// the max number of uint32_t in an encoded block (zero-run: mask + values)
+#define MC_CODEC_MAX_BLOCK_WORDS (4 + MC_CODEC_BLOCK_SIZE)
+
+// encodes `count` (at most one block of) values, returns the encoded size in
+// uint32_t. matches the encode shader, so that both sides share the format
+uint32_t mc_codec_encode_block(
+    mc_Codec codec,
+    const uint32_t* in,
+    uint32_t count,
+    uint32_t* out
+);
+
+// decodes the first `count` values of a block
+void mc_codec_decode_block(
+    mc_Codec codec,
+    const uint32_t* in,
+    uint32_t count,
+    uint32_t* out
+);
+
+#endif // MC_CODEC_H
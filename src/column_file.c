@@ -0,0 +1,567 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "codec.h"
+#include "column_file.h"
+#include "device.h"
+#include "log.h"
+
+// the size of the staging buffer used to stream columns to the device (a
+// multiple of the size of a decoded codec block)
+#define MC_COLUMN_CHUNK_SIZE (16 * 1024 * 1024)
+
+static uint64_t mc_column_type_size(mc_ColumnType type) {
+    switch (type) {
+        case MC_COLUMN_TYPE_U32:
+        case MC_COLUMN_TYPE_I32:
+        case MC_COLUMN_TYPE_F32: return 4;
+        case MC_COLUMN_TYPE_U64:
+        case MC_COLUMN_TYPE_I64:
+        case MC_COLUMN_TYPE_F64: return 8;
+        default: return 0;
+    }
+}
+
+static uint64_t mc_column_block_count(uint64_t rowCount) {
+    return (rowCount + MC_CODEC_BLOCK_SIZE - 1) / MC_CODEC_BLOCK_SIZE;
+}
+
+static bool mc_column_pad(FILE* fp, uint64_t alignment) {
+    static const char zeros[256] = {0};
+    uint64_t pos = ftell(fp);
+    uint64_t pad = (alignment - pos % alignment) % alignment;
+    while (pad) {
+        uint64_t n = pad < sizeof zeros ? pad : sizeof zeros;
+        if (fwrite(zeros, 1, n, fp) != n) return false;
+        pad -= n;
+    }
+    return true;
+}
+
+// writes the block offsets then the blocks, like a compressed transfer
+static bool mc_column_write_encoded(FILE* fp, const mc_Column* column) {
+    const uint32_t* data = column->data;
+    uint64_t blockCount = mc_column_block_count(column->rowCount);
+    uint32_t block[MC_CODEC_MAX_BLOCK_WORDS];
+
+    // the blocks are encoded twice, to write the offsets first without
+    // keeping the whole encoded column in memory
+    uint64_t offset = 0;
+    bool ok = fwrite(&(uint32_t){0}, sizeof(uint32_t), 1, fp) == 1;
+    for (uint64_t b = 0; b < blockCount && ok; b++) {
+        uint64_t first = b * MC_CODEC_BLOCK_SIZE;
+        uint64_t n = column->rowCount - first;
+        if (n > MC_CODEC_BLOCK_SIZE) n = MC_CODEC_BLOCK_SIZE;
+        offset += mc_codec_encode_block(column->codec, &data[first], n, block);
+        if (offset > UINT32_MAX) return false;
+        ok = fwrite(&(uint32_t){offset}, sizeof(uint32_t), 1, fp) == 1;
+    }
+
+    for (uint64_t b = 0; b < blockCount && ok; b++) {
+        uint64_t first = b * MC_CODEC_BLOCK_SIZE;
+        uint64_t n = column->rowCount - first;
+        if (n > MC_CODEC_BLOCK_SIZE) n = MC_CODEC_BLOCK_SIZE;
+        uint32_t words
+            = mc_codec_encode_block(column->codec, &data[first], n, block);
+        ok = fwrite(block, sizeof(uint32_t), words, fp) == words;
+    }
+
+    return ok;
+}
+
+bool mc_column_file_write(
+    const char* filename,
+    uint64_t alignment,
+    uint32_t columnCount,
+    const mc_Column* columns
+) {
+    if (!filename || (columnCount && !columns)) return false;
+    if (alignment < 8) alignment = 8;
+
+    for (uint32_t i = 0; i < columnCount; i++) {
+        const mc_Column* column = &columns[i];
+        uint64_t typeSize = mc_column_type_size(column->type);
+        if (!column->name || strlen(column->name) >= MC_COLUMN_NAME_SIZE)
+            return false;
+        if (!typeSize || (column->rowCount && !column->data)) return false;
+        if (column->codec != MC_CODEC_NONE && typeSize != 4) return false;
+    }
+
+    FILE* fp = fopen(filename, "wb");
+    if (!fp) return false;
+
+    mc_ColumnEntry* entries = calloc(columnCount + 1, sizeof *entries);
+    bool ok = fwrite(MC_COLUMN_FILE_MAGIC, 1, 8, fp) == 8;
+
+    for (uint32_t i = 0; i < columnCount && ok; i++) {
+        const mc_Column* column = &columns[i];
+        mc_ColumnEntry* entry = &entries[i];
+        ok = mc_column_pad(fp, alignment);
+
+        strcpy(entry->name, column->name);
+        entry->type = column->type;
+        entry->codec = column->codec;
+        entry->rowCount = column->rowCount;
+        entry->offset = ftell(fp);
+
+        if (column->codec == MC_CODEC_NONE) {
+            uint64_t typeSize = mc_column_type_size(column->type);
+            uint64_t size = typeSize * column->rowCount;
+            ok = ok && fwrite(column->data, 1, size, fp) == size;
+        } else {
+            ok = ok && mc_column_write_encoded(fp, column);
+        }
+
+        entry->size = ftell(fp) - entry->offset;
+    }
+
+    mc_ColumnTrailer trailer = {
+        .indexOffset = 0,
+        .columnCount = columnCount,
+        .version = MC_COLUMN_FILE_VERSION,
+    };
+    memcpy(trailer.magic, MC_COLUMN_FILE_MAGIC, 8);
+
+    ok = ok && mc_column_pad(fp, 8);
+    trailer.indexOffset = ftell(fp);
+    ok = ok
+      && fwrite(entries, sizeof *entries, columnCount, fp) == columnCount
+      && fwrite(&trailer, sizeof trailer, 1, fp) == 1;
+
+    free(entries);
+    if (fclose(fp)) ok = false;
+    return ok;
+}
+
+// checks that the index and the columns are inside the file
+static uint32_t mc_column_popcount(uint32_t x) {
+    uint32_t count = 0;
+    for (; x; x &= x - 1) count++;
+    return count;
+}
+
+// checks the block table and the header of each block of an encoded column,
+// so that decoding never reads past the column
+static bool mc_column_validate_blocks(
+    mc_ColumnFile* file,
+    const mc_ColumnEntry* entry
+) {
+    // each block takes at least 2 words, on top of its table entry
+    uint64_t words = entry->size / sizeof(uint32_t);
+    if (entry->rowCount / MC_CODEC_BLOCK_SIZE >= words) return false;
+    uint64_t blockCount = mc_column_block_count(entry->rowCount);
+    if (blockCount + 1 > words) return false;
+
+    const uint32_t* table = (const uint32_t*)(file->map + entry->offset);
+    const uint32_t* blocks = table + blockCount + 1;
+    if (table[0] != 0) return false;
+    if (entry->size != sizeof(uint32_t) * (blockCount + 1 + table[blockCount]))
+        return false;
+
+    for (uint64_t b = 0; b < blockCount; b++) {
+        if (table[b] > table[b + 1]) return false;
+        uint64_t size = table[b + 1] - table[b];
+        const uint32_t* block = &blocks[table[b]];
+
+        uint64_t n = entry->rowCount - b * MC_CODEC_BLOCK_SIZE;
+        if (n > MC_CODEC_BLOCK_SIZE) n = MC_CODEC_BLOCK_SIZE;
+
+        if (entry->codec == MC_CODEC_ZERO_RUN) {
+            // the mask, then one word per set bit of the first `n`
+            if (size < 4) return false;
+            uint64_t values = 0;
+            for (uint32_t w = 0; w < 4; w++) {
+                uint64_t lanes = n > 32 * w ? n - 32 * w : 0;
+                uint32_t mask = lanes >= 32 ? ~0u : (1u << lanes) - 1;
+                values += mc_column_popcount(block[w] & mask);
+            }
+            if (size < 4 + values) return false;
+        } else {
+            // the base, the bit width, then 4 words per bit
+            if (size < 2 || block[1] > 32 || size < 2 + 4 * (uint64_t)block[1])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static bool mc_column_file_validate(mc_ColumnFile* file) {
+    if (file->size < 8 + sizeof(mc_ColumnTrailer)) return false;
+    if (memcmp(file->map, MC_COLUMN_FILE_MAGIC, 8)) return false;
+
+    mc_ColumnTrailer trailer;
+    memcpy(
+        &trailer,
+        file->map + file->size - sizeof trailer,
+        sizeof trailer
+    );
+    if (memcmp(trailer.magic, MC_COLUMN_FILE_MAGIC, 8)) return false;
+    if (trailer.version != MC_COLUMN_FILE_VERSION) return false;
+
+    uint64_t indexEnd = file->size - sizeof trailer;
+    uint64_t indexSize = sizeof(mc_ColumnEntry) * trailer.columnCount;
+    if (trailer.indexOffset % 8 || trailer.indexOffset > indexEnd
+        || indexEnd - trailer.indexOffset < indexSize)
+        return false;
+
+    file->columnCount = trailer.columnCount;
+    file->columns = (const mc_ColumnEntry*)(file->map + trailer.indexOffset);
+
+    for (uint32_t i = 0; i < file->columnCount; i++) {
+        const mc_ColumnEntry* entry = &file->columns[i];
+        uint64_t typeSize = mc_column_type_size(entry->type);
+        if (!typeSize || entry->offset > indexEnd) return false;
+        if (entry->offset % typeSize) return false;
+        if (entry->size > indexEnd - entry->offset) return false;
+        if (memchr(entry->name, '\0', MC_COLUMN_NAME_SIZE) == NULL)
+            return false;
+
+        // sizes are compared by division, so nothing can overflow
+        if (entry->codec == MC_CODEC_NONE) {
+            if (entry->size % typeSize
+                || entry->size / typeSize != entry->rowCount)
+                return false;
+        } else {
+            if (typeSize != 4 || entry->codec > MC_CODEC_ZERO_RUN) return false;
+            if (!mc_column_validate_blocks(file, entry)) return false;
+        }
+    }
+
+    return true;
+}
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#include <Windows.h>
+
+// maps the whole file, the view stays valid after the handles are closed
+static bool mc_column_file_map(mc_ColumnFile* file, const char* filename) {
+    HANDLE handle = CreateFileA(
+        filename,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL
+    );
+    LARGE_INTEGER size;
+    if (handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(handle, &size)
+        || size.QuadPart == 0) {
+        ERROR(file, "failed to open column file");
+        if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+        return false;
+    }
+
+    file->size = size.QuadPart;
+    HANDLE mapping
+        = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    void* map = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)
+                        : NULL;
+    if (mapping) CloseHandle(mapping);
+    if (!map) {
+        ERROR(file, "failed to map column file");
+        return false;
+    }
+
+    file->map = map;
+    return true;
+}
+
+static void mc_column_file_unmap(mc_ColumnFile* file) {
+    UnmapViewOfFile(file->map);
+}
+
+// the file is opened for sequential access, there is nothing more to hint
+static void mc_column_file_advise(
+    mc_ColumnFile* file,
+    uint64_t offset,
+    uint64_t size
+) {}
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// maps the whole file, the mapping stays valid after the file is closed
+static bool mc_column_file_map(mc_ColumnFile* file, const char* filename) {
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) || st.st_size == 0) {
+        ERROR(file, "failed to open column file");
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    file->size = st.st_size;
+    void* map = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        ERROR(file, "failed to map column file");
+        return false;
+    }
+
+    file->map = map;
+    return true;
+}
+
+static void mc_column_file_unmap(mc_ColumnFile* file) {
+    munmap((void*)file->map, file->size);
+}
+
+// hints the kernel that a range of the mapping will be read sequentially
+static void mc_column_file_advise(
+    mc_ColumnFile* file,
+    uint64_t offset,
+    uint64_t size
+) {
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t start = offset / page * page;
+    void* addr = (void*)(file->map + start);
+    madvise(addr, offset + size - start, MADV_SEQUENTIAL);
+    madvise(addr, offset + size - start, MADV_WILLNEED);
+}
+
+#endif
+
+mc_ColumnFile* mc_column_file_open(mc_Device* device, const char* filename) {
+    if (!device) return NULL;
+
+    mc_ColumnFile* file = malloc(sizeof *file);
+    *file = (mc_ColumnFile){
+        ._instance = device->_instance,
+        .device = device,
+        .size = 0,
+        .map = NULL,
+        .columnCount = 0,
+        .columns = NULL,
+        .staging = NULL,
+        .copier = NULL,
+    };
+
+    DEBUG(file, "opening column file %s", filename);
+
+    if (!filename) {
+        ERROR(file, "failed to open column file");
+        mc_column_file_close(file);
+        return NULL;
+    }
+
+    if (!mc_column_file_map(file, filename)) {
+        mc_column_file_close(file);
+        return NULL;
+    }
+
+    if (!mc_column_file_validate(file)) {
+        ERROR(file, "invalid column file");
+        mc_column_file_close(file);
+        return NULL;
+    }
+
+    file->staging = mc_buffer_create(
+        device,
+        MC_BUFFER_TYPE_CPU,
+        MC_COLUMN_CHUNK_SIZE
+    );
+    file->copier = mc_buffer_copier_create(device);
+    if (!file->staging || !file->copier) {
+        mc_column_file_close(file);
+        return NULL;
+    }
+
+    return file;
+}
+
+void mc_column_file_close(mc_ColumnFile* file) {
+    if (!file) return;
+    DEBUG(file, "closing column file");
+
+    if (file->copier) mc_buffer_copier_destroy(file->copier);
+    if (file->staging) mc_buffer_destroy(file->staging);
+    if (file->map) mc_column_file_unmap(file);
+    free(file);
+}
+
+uint32_t mc_column_file_get_column_count(mc_ColumnFile* file) {
+    return file ? file->columnCount : 0;
+}
+
+int32_t mc_column_file_find_column(mc_ColumnFile* file, const char* name) {
+    if (!file || !name) return -1;
+    for (uint32_t i = 0; i < file->columnCount; i++)
+        if (!strcmp(file->columns[i].name, name)) return i;
+    return -1;
+}
+
+mc_Column mc_column_file_get_column(mc_ColumnFile* file, uint32_t idx) {
+    if (!file || idx >= file->columnCount) return (mc_Column){0};
+    const mc_ColumnEntry* entry = &file->columns[idx];
+    return (mc_Column){
+        .name = entry->name,
+        .type = entry->type,
+        .codec = entry->codec,
+        .rowCount = entry->rowCount,
+        .data = entry->codec == MC_CODEC_NONE ? file->map + entry->offset
+                                              : NULL,
+    };
+}
+
+// copies the first `size` bytes of the staging buffer to the destination
+static bool mc_column_file_flush(
+    mc_ColumnFile* file,
+    mc_Buffer* buffer,
+    uint64_t offset,
+    uint64_t size
+) {
+    if (size == 0) return true;
+    return mc_buffer_copier_copy(
+               file->copier,
+               file->staging,
+               buffer,
+               0,
+               offset,
+               size
+           )
+        == size;
+}
+
+uint64_t mc_column_file_load_into(
+    mc_ColumnFile* file,
+    uint32_t column,
+    uint64_t firstRow,
+    uint64_t rowCount,
+    mc_Buffer* buffer,
+    uint64_t offset
+) {
+    if (!file || !buffer) return 0;
+
+    if (column >= file->columnCount) {
+        ERROR(file, "column %d out of range", column);
+        return 0;
+    }
+
+    const mc_ColumnEntry* entry = &file->columns[column];
+    uint64_t typeSize = mc_column_type_size(entry->type);
+    uint64_t size = typeSize * rowCount;
+
+    DEBUG(
+        file,
+        "loading rows %ld to %ld of column %s",
+        firstRow,
+        firstRow + rowCount,
+        entry->name
+    );
+
+    if (firstRow > entry->rowCount || rowCount > entry->rowCount - firstRow) {
+        ERROR(file, "rows out of range");
+        return 0;
+    }
+
+    if (offset + size > mc_buffer_get_size(buffer)) {
+        ERROR(file, "buffer too small");
+        return 0;
+    }
+
+    char* staging = file->staging->map;
+
+    if (entry->codec == MC_CODEC_NONE) {
+        const char* src = file->map + entry->offset + typeSize * firstRow;
+        mc_column_file_advise(file, src - file->map, size);
+
+        for (uint64_t done = 0; done < size;) {
+            uint64_t n = size - done;
+            if (n > MC_COLUMN_CHUNK_SIZE) n = MC_COLUMN_CHUNK_SIZE;
+            memcpy(staging, src + done, n);
+            if (!mc_column_file_flush(file, buffer, offset + done, n)) return 0;
+            done += n;
+        }
+
+        return size;
+    }
+
+    // only the blocks that contain the selected rows are decoded
+    const uint32_t* table = (const uint32_t*)(file->map + entry->offset);
+    uint64_t blockCount = mc_column_block_count(entry->rowCount);
+    const uint32_t* blocks = table + blockCount + 1;
+    uint64_t firstBlock = firstRow / MC_CODEC_BLOCK_SIZE;
+    uint64_t lastBlock = mc_column_block_count(firstRow + rowCount);
+    uint32_t decoded[MC_CODEC_BLOCK_SIZE];
+
+    if (rowCount) {
+        uint64_t start = (const char*)&blocks[table[firstBlock]] - file->map;
+        uint64_t end = (const char*)&blocks[table[lastBlock]] - file->map;
+        mc_column_file_advise(file, start, end - start);
+    }
+
+    uint64_t done = 0;
+    uint64_t staged = 0;
+    for (uint64_t b = firstBlock; b < lastBlock; b++) {
+        uint64_t blockFirst = b * MC_CODEC_BLOCK_SIZE;
+        uint64_t n = entry->rowCount - blockFirst;
+        if (n > MC_CODEC_BLOCK_SIZE) n = MC_CODEC_BLOCK_SIZE;
+        mc_codec_decode_block(entry->codec, &blocks[table[b]], n, decoded);
+
+        uint64_t from = blockFirst < firstRow ? firstRow - blockFirst : 0;
+        uint64_t to = n;
+        if (blockFirst + to > firstRow + rowCount)
+            to = firstRow + rowCount - blockFirst;
+
+        uint64_t bytes = sizeof *decoded * (to - from);
+        if (staged + bytes > MC_COLUMN_CHUNK_SIZE) {
+            if (!mc_column_file_flush(file, buffer, offset + done, staged))
+                return 0;
+            done += staged;
+            staged = 0;
+        }
+
+        memcpy(staging + staged, &decoded[from], bytes);
+        staged += bytes;
+    }
+
+    if (!mc_column_file_flush(file, buffer, offset + done, staged)) return 0;
+    return size;
+}
+
+mc_Buffer* mc_column_file_load(
+    mc_ColumnFile* file,
+    uint32_t column,
+    uint64_t firstRow,
+    uint64_t rowCount
+) {
+    if (!file) return NULL;
+
+    if (column >= file->columnCount) {
+        ERROR(file, "column %d out of range", column);
+        return NULL;
+    }
+
+    uint64_t typeSize = mc_column_type_size(file->columns[column].type);
+    uint64_t size = typeSize * (rowCount ? rowCount : 1);
+    mc_Buffer* buffer
+        = mc_buffer_create(file->device, MC_BUFFER_TYPE_GPU, size);
+    if (!buffer) return NULL;
+
+    if (rowCount
+        && mc_column_file_load_into(
+               file,
+               column,
+               firstRow,
+               rowCount,
+               buffer,
+               0
+           ) != typeSize * rowCount) {
+        mc_buffer_destroy(buffer);
+        return NULL;
+    }
+
+    return buffer;
+}
@@ -0,0 +1,40 @@
+#ifndef MC_COLUMN_FILE_H
+#define MC_COLUMN_FILE_H
+
+#include "microcompute.h"
+#include "microcompute_extra.h"
+
+#define MC_COLUMN_FILE_MAGIC "MCCOLUMN"
+#define MC_COLUMN_FILE_VERSION 1
+#define MC_COLUMN_NAME_SIZE 64
+
+// the index entry of a column, as stored in the file (little-endian)
+typedef struct mc_ColumnEntry {
+    char name[MC_COLUMN_NAME_SIZE];
+    uint32_t type;
+    uint32_t codec;
+    uint64_t rowCount;
+    uint64_t offset; // from the start of the file, aligned
+    uint64_t size;   // stored size, in bytes
+} mc_ColumnEntry;
+
+// the end of the file, pointing to the index
+typedef struct mc_ColumnTrailer {
+    uint64_t indexOffset;
+    uint32_t columnCount;
+    uint32_t version;
+    char magic[8];
+} mc_ColumnTrailer;
+
+struct mc_ColumnFile {
+    mc_Instance* _instance;
+    mc_Device* device;
+    uint64_t size;
+    const char* map;
+    uint32_t columnCount;
+    const mc_ColumnEntry* columns; // points into the mapping
+    mc_Buffer* staging;
+    mc_BufferCopier* copier;
+};
+
+#endif // MC_COLUMN_FILE_H
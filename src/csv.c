@@ -0,0 +1,776 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "csv.h"
+#include "device.h"
+#include "dispatch.h"
+#include "log.h"
+#include "program.h"
+
+// the number of bytes handled by a workgroup when finding the records, 4 per
+// invocation
+#define MC_CSV_BLOCK_SIZE 1024
+
+// the max number of error positions kept (all errors are counted)
+#define MC_CSV_MAX_ERRORS 256
+
+// the passes, see the code
+#define MC_CSV_PASS_COUNT_ENDS 0
+#define MC_CSV_PASS_SCAN_BLOCKS 1
+#define MC_CSV_PASS_FIND_ENDS 2
+#define MC_CSV_PASS_SPLIT_FIELDS 3
+#define MC_CSV_PASS_CONVERT 4
+#define MC_CSV_PASS_NUMBER_DICT 5
+#define MC_CSV_PASS_REMAP_DICT 6
+
+// the records end at the newlines outside of quotes (blank lines are
+// skipped), found with a quote-aware flag-and-scan over blocks of bytes:
+// - pass 0: count the quotes of each block, and its record ends for both
+//   possible states at its start (inside or outside quotes)
+// - pass 1: scan the blocks (single workgroup), resolving the state at the
+//   start of each block and the index of its first record end
+// - pass 2: scatter the record ends
+// then, with one invocation per row:
+// - pass 3: split each record into fields, writing the field starts
+// - pass 4: convert a column; dictionary fields are inserted into a hash
+//   table, by row, and get the index of their slot
+// - pass 5: number the slots in use (one invocation per slot), and copy
+//   the string of each to the dictionary, unescaping doubled quotes
+// - pass 6: replace the slot indices by the dictionary ids
+static const char* csvSource
+    = "#version 450\n"
+      "layout(local_size_x = 256) in;\n"
+      "layout(std430, binding = 0) buffer textBuff {\n"
+      "    uint text[];\n"
+      "};\n"
+      "layout(std430, binding = 1) buffer metaBuff {\n"
+      "    uint recordCount;\n"
+      "    uint errorCount;\n"
+      "    uint maxErrors;\n"
+      "    uint metaPad;\n"
+      "    uvec2 errors[];\n"
+      "};\n"
+      "layout(std430, binding = 2) buffer blockBuff {\n"
+      "    uvec4 blocks[];\n"
+      "};\n"
+      "layout(std430, binding = 3) buffer recordBuff {\n"
+      "    uint records[];\n"
+      "};\n"
+      "layout(std430, binding = 4) buffer fieldBuff {\n"
+      "    uint fields[];\n"
+      "};\n"
+      "layout(std430, binding = 5) buffer valueBuff {\n"
+      "    uint values[];\n"
+      "};\n"
+      "layout(std430, binding = 6) buffer dictBuff {\n"
+      "    uint dictSize;\n"
+      "    uint stringWords;\n"
+      "    uint dictPad[2];\n"
+      "    uint slots[];\n"
+      "};\n"
+      "// the (byte offset, length) of each string, then the strings\n"
+      "layout(std430, binding = 7) buffer entryBuff {\n"
+      "    uint entries[];\n"
+      "};\n"
+      "layout(push_constant) uniform Push {\n"
+      "    uint size;\n"
+      "    uint blockCount;\n"
+      "    uint pass;\n"
+      "    uint delimiter;\n"
+      "    uint columnCount;\n"
+      "    uint column;\n"
+      "    uint type;\n"
+      "    uint header;\n"
+      "    uint rowCount;\n"
+      "    uint slotMask;\n"
+      "};\n"
+      "shared uint sScan[256];\n"
+      "uint byte_at(uint p) {\n"
+      "    return (text[p >> 2] >> ((p & 3u) * 8u)) & 0xffu;\n"
+      "}\n"
+      "// a newline ending a record, if outside of quotes\n"
+      "bool is_end(uint p) {\n"
+      "    if (p == 0u || byte_at(p) != 10u) return false;\n"
+      "    uint b = byte_at(p - 1u);\n"
+      "    if (b == 10u) return false;\n"
+      "    return b != 13u || (p > 1u && byte_at(p - 2u) != 10u);\n"
+      "}\n"
+      "uint workgroup_scan(uint v) {\n"
+      "    uint lane = gl_LocalInvocationID.x;\n"
+      "    sScan[lane] = v;\n"
+      "    barrier();\n"
+      "    for (uint off = 1u; off < 256u; off <<= 1) {\n"
+      "        uint t = lane >= off ? sScan[lane - off] : 0u;\n"
+      "        barrier();\n"
+      "        sScan[lane] += t;\n"
+      "        barrier();\n"
+      "    }\n"
+      "    return sScan[lane];\n"
+      "}\n"
+      "void report(uint row, uint pos) {\n"
+      "    uint i = atomicAdd(errorCount, 1u);\n"
+      "    if (i < maxErrors) errors[i] = uvec2(row, pos);\n"
+      "}\n"
+      "// the bounds of a field without its quotes, and whether it was quoted\n"
+      "uvec3 quoted_field(uint row, uint c) {\n"
+      "    uint i = row * (columnCount + 1u) + c;\n"
+      "    uint start = fields[i];\n"
+      "    uint end = max(fields[i + 1u], start + 1u) - 1u;\n"
+      "    if (end - start >= 2u && byte_at(start) == 34u\n"
+      "        && byte_at(end - 1u) == 34u)\n"
+      "        return uvec3(start + 1u, end - 1u, 1u);\n"
+      "    return uvec3(start, end, 0u);\n"
+      "}\n"
+      "uvec2 field(uint row, uint c) {\n"
+      "    return quoted_field(row, c).xy;\n"
+      "}\n"
+      "bool same_field(uvec2 a, uvec2 b) {\n"
+      "    if (a.y - a.x != b.y - b.x) return false;\n"
+      "    for (uint i = 0u; i < a.y - a.x; i++)\n"
+      "        if (byte_at(a.x + i) != byte_at(b.x + i)) return false;\n"
+      "    return true;\n"
+      "}\n"
+      "bool is_digit(uint b) {\n"
+      "    return b >= 48u && b <= 57u;\n"
+      "}\n"
+      "float scale10(float v, int e) {\n"
+      "    const float p10[11] = float[11](\n"
+      "        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10\n"
+      "    );\n"
+      "    e = clamp(e, -90, 90);\n"
+      "    for (; e > 10; e -= 10) v *= 1e10;\n"
+      "    for (; e < -10; e += 10) v /= 1e10;\n"
+      "    return e >= 0 ? v * p10[e] : v / p10[-e];\n"
+      "}\n"
+      "// parses an int or a float (0 when empty), returns the position of\n"
+      "// the first invalid byte, or ~0u when valid\n"
+      "uint parse_number(uint p, uint end, out uint value) {\n"
+      "    value = 0u;\n"
+      "    while (p < end && byte_at(p) == 32u) p++;\n"
+      "    while (end > p && byte_at(end - 1u) == 32u) end--;\n"
+      "    if (p == end) return ~0u;\n"
+      "    uint b = byte_at(p);\n"
+      "    bool neg = b == 45u;\n"
+      "    if (b == 45u || b == 43u) p++;\n"
+      "    uint m = 0u;\n"
+      "    uint digits = 0u;\n"
+      "    int e = 0;\n"
+      "    // ints must fit: up to 2^31 - 1, or 2^31 when negative\n"
+      "    uint limit = neg ? 2147483648u : 2147483647u;\n"
+      "    for (; p < end && is_digit(byte_at(p)); p++, digits++) {\n"
+      "        uint d = byte_at(p) - 48u;\n"
+      "        if (type == 0u) {\n"
+      "            if (m > (limit - d) / 10u) return p;\n"
+      "            m = m * 10u + d;\n"
+      "        } else if (m < 100000000u) {\n"
+      "            m = m * 10u + d;\n"
+      "        } else {\n"
+      "            e++;\n"
+      "        }\n"
+      "    }\n"
+      "    if (type == 0u) {\n"
+      "        value = neg ? 0u - m : m;\n"
+      "        if (digits == 0u) return min(p, end - 1u);\n"
+      "        return p == end ? ~0u : p;\n"
+      "    }\n"
+      "    if (p < end && byte_at(p) == 46u) {\n"
+      "        for (p++; p < end && is_digit(byte_at(p)); p++, digits++) {\n"
+      "            if (m < 100000000u) {\n"
+      "                m = m * 10u + byte_at(p) - 48u;\n"
+      "                e--;\n"
+      "            }\n"
+      "        }\n"
+      "    }\n"
+      "    if (digits == 0u) return min(p, end - 1u);\n"
+      "    if (p < end && (byte_at(p) | 32u) == 101u) {\n"
+      "        p++;\n"
+      "        bool eNeg = p < end && byte_at(p) == 45u;\n"
+      "        if (p < end && (byte_at(p) == 45u || byte_at(p) == 43u)) p++;\n"
+      "        if (p == end || !is_digit(byte_at(p)))\n"
+      "            return min(p, end - 1u);\n"
+      "        int x = 0;\n"
+      "        for (; p < end && is_digit(byte_at(p)); p++)\n"
+      "            x = min(x * 10 + int(byte_at(p)) - 48, 1000);\n"
+      "        e += eNeg ? -x : x;\n"
+      "    }\n"
+      "    float v = scale10(float(m), e);\n"
+      "    value = floatBitsToUint(neg ? -v : v);\n"
+      "    return p == end ? ~0u : p;\n"
+      "}\n"
+      "void main(void) {\n"
+      "    uint lane = gl_LocalInvocationID.x;\n"
+      "    uint group = gl_WorkGroupID.y * gl_NumWorkGroups.x\n"
+      "               + gl_WorkGroupID.x;\n"
+      "    if (pass == 1u) {\n"
+      "        // the record ends of a run of blocks, if the run starts\n"
+      "        // outside (ends0) or inside (ends1) of quotes\n"
+      "        uint per = (blockCount + 255u) / 256u;\n"
+      "        uint first = min(lane * per, blockCount);\n"
+      "        uint last = min(first + per, blockCount);\n"
+      "        uint quotes = 0u;\n"
+      "        uint ends0 = 0u;\n"
+      "        uint ends1 = 0u;\n"
+      "        for (uint b = first; b < last; b++) {\n"
+      "            uvec4 v = blocks[b];\n"
+      "            bool inside = (quotes & 1u) != 0u;\n"
+      "            ends0 += inside ? v.z : v.y;\n"
+      "            ends1 += inside ? v.y : v.z;\n"
+      "            quotes += v.x;\n"
+      "        }\n"
+      "        uint q = workgroup_scan(quotes) - quotes;\n"
+      "        uint mine = (q & 1u) == 0u ? ends0 : ends1;\n"
+      "        uint base = workgroup_scan(mine) - mine;\n"
+      "        for (uint b = first; b < last; b++) {\n"
+      "            uvec4 v = blocks[b];\n"
+      "            blocks[b] = uvec4(q & 1u, base, 0u, 0u);\n"
+      "            base += (q & 1u) == 0u ? v.y : v.z;\n"
+      "            q += v.x;\n"
+      "        }\n"
+      "        if (lane == 255u) recordCount = base;\n"
+      "        return;\n"
+      "    }\n"
+      "    if (pass <= 2u) {\n"
+      "        if (group >= blockCount) return;\n"
+      "        uint first = group * 1024u + lane * 4u;\n"
+      "        uint quotes = 0u;\n"
+      "        for (uint k = 0u; k < 4u; k++)\n"
+      "            if (first + k < size && byte_at(first + k) == 34u)\n"
+      "                quotes++;\n"
+      "        uint before = workgroup_scan(quotes) - quotes;\n"
+      "        uint parity = before + (pass == 2u ? blocks[group].x : 0u);\n"
+      "        uint ends = 0u;\n"
+      "        uint flags = 0u;\n"
+      "        for (uint k = 0u; k < 4u; k++) {\n"
+      "            uint i = first + k;\n"
+      "            if (i >= size) break;\n"
+      "            if (byte_at(i) == 34u) {\n"
+      "                parity++;\n"
+      "            } else if (is_end(i)) {\n"
+      "                // counted for both states in pass 0, packed\n"
+      "                bool inside = (parity & 1u) != 0u;\n"
+      "                if (pass == 0u) ends += inside ? 0x10000u : 1u;\n"
+      "                else if (!inside) {\n"
+      "                    flags |= 1u << k;\n"
+      "                    ends++;\n"
+      "                }\n"
+      "            }\n"
+      "        }\n"
+      "        uint rank = workgroup_scan(ends) - ends;\n"
+      "        if (pass == 0u) {\n"
+      "            uint total = rank + ends;\n"
+      "            if (lane == 255u)\n"
+      "                blocks[group] = uvec4(\n"
+      "                    before + quotes,\n"
+      "                    total & 0xffffu,\n"
+      "                    total >> 16,\n"
+      "                    0u\n"
+      "                );\n"
+      "            return;\n"
+      "        }\n"
+      "        uint r = blocks[group].y + rank;\n"
+      "        for (uint k = 0u; k < 4u; k++)\n"
+      "            if ((flags & (1u << k)) != 0u)\n"
+      "                records[r++] = first + k + 1u;\n"
+      "        // the last record may have no newline, a trailing carriage\n"
+      "        // return also ends it\n"
+      "        uint last = size;\n"
+      "        if (last > 0u && byte_at(last - 1u) == 13u) last--;\n"
+      "        if (group == 0u && lane == 0u && last > 0u\n"
+      "            && byte_at(last - 1u) != 10u)\n"
+      "            records[atomicAdd(recordCount, 1u)] = size;\n"
+      "        return;\n"
+      "    }\n"
+      "    uint i = group * 256u + lane;\n"
+      "    if (pass == 5u) {\n"
+      "        if (i > slotMask || slots[2u * i] == 0u) return;\n"
+      "        uint id = atomicAdd(dictSize, 1u);\n"
+      "        slots[2u * i + 1u] = id;\n"
+      "        uvec3 f = quoted_field(slots[2u * i] - 1u, column);\n"
+      "        // in quoted fields, a doubled quote stands for one quote\n"
+      "        uint len = 0u;\n"
+      "        for (uint p = f.x; p < f.y; p++, len++)\n"
+      "            if (f.z != 0u && byte_at(p) == 34u && p + 1u < f.y\n"
+      "                && byte_at(p + 1u) == 34u)\n"
+      "                p++;\n"
+      "        uint words = (len + 3u) / 4u;\n"
+      "        uint first = 2u * rowCount + atomicAdd(stringWords, words);\n"
+      "        uint word = 0u;\n"
+      "        uint n = 0u;\n"
+      "        for (uint p = f.x; p < f.y; p++, n++) {\n"
+      "            uint b = byte_at(p);\n"
+      "            if (f.z != 0u && b == 34u && p + 1u < f.y\n"
+      "                && byte_at(p + 1u) == 34u)\n"
+      "                p++;\n"
+      "            word |= b << (n % 4u * 8u);\n"
+      "            if (n % 4u == 3u) {\n"
+      "                entries[first + n / 4u] = word;\n"
+      "                word = 0u;\n"
+      "            }\n"
+      "        }\n"
+      "        if (n % 4u != 0u) entries[first + n / 4u] = word;\n"
+      "        entries[2u * id] = 4u * first;\n"
+      "        entries[2u * id + 1u] = len;\n"
+      "        return;\n"
+      "    }\n"
+      "    if (i >= rowCount) return;\n"
+      "    if (pass == 3u) {\n"
+      "        uint rec = i + header;\n"
+      "        uint start = rec == 0u ? 0u : records[rec - 1u];\n"
+      "        uint end = records[rec];\n"
+      "        while (start < end\n"
+      "               && (byte_at(start) == 10u || byte_at(start) == 13u))\n"
+      "            start++;\n"
+      "        if (end > start && byte_at(end - 1u) == 10u) end--;\n"
+      "        if (end > start && byte_at(end - 1u) == 13u) end--;\n"
+      "        uint base = i * (columnCount + 1u);\n"
+      "        fields[base] = start;\n"
+      "        uint c = 0u;\n"
+      "        bool quoted = false;\n"
+      "        for (uint p = start; p < end; p++) {\n"
+      "            uint b = byte_at(p);\n"
+      "            if (b == 34u) quoted = !quoted;\n"
+      "            else if (b == delimiter && !quoted && ++c <= columnCount)\n"
+      "                fields[base + c] = p + 1u;\n"
+      "        }\n"
+      "        if (c + 1u != columnCount) report(i, start);\n"
+      "        for (uint k = c + 1u; k <= columnCount; k++)\n"
+      "            fields[base + k] = end + 1u;\n"
+      "        return;\n"
+      "    }\n"
+      "    if (pass == 6u) {\n"
+      "        values[i] = slots[2u * values[i] + 1u];\n"
+      "        return;\n"
+      "    }\n"
+      "    uvec2 f = field(i, column);\n"
+      "    if (type == 2u) {\n"
+      "        uint h = 2166136261u;\n"
+      "        for (uint p = f.x; p < f.y; p++)\n"
+      "            h = (h ^ byte_at(p)) * 16777619u;\n"
+      "        uint s = h & slotMask;\n"
+      "        while (true) {\n"
+      "            uint key = atomicCompSwap(slots[2u * s], 0u, i + 1u);\n"
+      "            if (key == 0u || same_field(field(key - 1u, column), f))\n"
+      "                break;\n"
+      "            s = (s + 1u) & slotMask;\n"
+      "        }\n"
+      "        values[i] = s;\n"
+      "        return;\n"
+      "    }\n"
+      "    uint value;\n"
+      "    uint bad = parse_number(f.x, f.y, value);\n"
+      "    if (bad != ~0u) {\n"
+      "        report(i, bad);\n"
+      "        value = 0u;\n"
+      "    }\n"
+      "    values[i] = value;\n"
+      "}\n";
+
+typedef struct mc_CsvPush {
+    uint32_t size;
+    uint32_t blockCount;
+    uint32_t pass;
+    uint32_t delimiter;
+    uint32_t columnCount;
+    uint32_t column;
+    uint32_t type;
+    uint32_t header;
+    uint32_t rowCount;
+    uint32_t slotMask;
+} mc_CsvPush;
+
+// the bindings of the passes, unused ones alias the meta buffer
+typedef struct mc_CsvBuffers {
+    mc_Buffer* text;
+    mc_Buffer* meta;
+    mc_Buffer* blocks;
+    mc_Buffer* records;
+    mc_Buffer* fields;
+    mc_Buffer* values;
+    mc_Buffer* dict;
+    mc_Buffer* entries;
+} mc_CsvBuffers;
+
+static bool mc_csv_add_pass(
+    mc_Dispatch* dispatch,
+    mc_Program* program,
+    mc_CsvBuffers* buffers,
+    mc_CsvPush push,
+    uint32_t groups
+) {
+    if (groups == 0) return true;
+
+    // the workgroups are spread over y when there are too many for x
+    uint32_t maxGroups = dispatch->device->maxWgCount[0];
+    uint32_t groupsX = groups < maxGroups ? groups : maxGroups;
+    uint32_t groupsY = (groups + groupsX - 1) / groupsX;
+
+    mc_Buffer* buffs[8] = {
+        buffers->text,
+        buffers->meta,
+        buffers->blocks,
+        buffers->records,
+        buffers->fields ? buffers->fields : buffers->meta,
+        buffers->values ? buffers->values : buffers->meta,
+        buffers->dict ? buffers->dict : buffers->meta,
+        buffers->entries ? buffers->entries : buffers->meta,
+    };
+    return mc_dispatch_add_pushed(
+        dispatch,
+        program,
+        (uint32_t[]){groupsX, groupsY, 1},
+        8,
+        buffs,
+        sizeof push,
+        &push
+    );
+}
+
+// finds the record ends, returns the number of records or -1 on error
+static int64_t mc_csv_find_records(
+    mc_Program* program,
+    mc_CsvBuffers* buffers,
+    mc_CsvPush push,
+    mc_Buffer* readback
+) {
+    mc_Dispatch* dispatch = mc_dispatch_create(readback->device);
+    if (!dispatch) return -1;
+
+    // the meta buffer starts as {0, 0, max errors}
+    vkCmdFillBuffer(dispatch->cmdBuff, buffers->meta->buf, 0, 16, 0);
+    vkCmdFillBuffer(
+        dispatch->cmdBuff,
+        buffers->meta->buf,
+        8,
+        4,
+        MC_CSV_MAX_ERRORS
+    );
+
+    bool ok = true;
+    for (push.pass = MC_CSV_PASS_COUNT_ENDS;
+         push.pass <= MC_CSV_PASS_FIND_ENDS && ok;
+         push.pass++) {
+        mc_dispatch_barrier(dispatch);
+        uint32_t groups = push.pass == MC_CSV_PASS_SCAN_BLOCKS
+                            ? 1
+                            : push.blockCount;
+        ok = mc_csv_add_pass(dispatch, program, buffers, push, groups);
+    }
+
+    mc_dispatch_barrier(dispatch);
+    vkCmdCopyBuffer(
+        dispatch->cmdBuff,
+        buffers->meta->buf,
+        readback->buf,
+        1,
+        &(VkBufferCopy){0, 0, sizeof(uint32_t)}
+    );
+
+    ok = ok && mc_dispatch_finish(dispatch)
+      && mc_dispatch_submit(dispatch) >= 0.0;
+    mc_dispatch_destroy(dispatch);
+    return ok ? (int64_t)*(uint32_t*)readback->map : -1;
+}
+
+// splits and converts the fields, then reads back the error and dictionary
+// counts
+static bool mc_csv_convert(
+    mc_CsvTable* table,
+    mc_Program* program,
+    mc_CsvBuffers* buffers,
+    mc_CsvPush push,
+    const mc_CsvType* types,
+    mc_Buffer** dicts,
+    mc_Buffer* readback
+) {
+    mc_Dispatch* dispatch = mc_dispatch_create(table->device);
+    if (!dispatch) return false;
+
+    uint32_t rowGroups = (table->rowCount + 255) / 256;
+    uint32_t slotGroups = (push.slotMask + 256) / 256;
+
+    for (uint32_t c = 0; c < table->columnCount; c++) {
+        if (!dicts[c]) continue;
+        vkCmdFillBuffer(dispatch->cmdBuff, dicts[c]->buf, 0, VK_WHOLE_SIZE, 0);
+    }
+
+    push.pass = MC_CSV_PASS_SPLIT_FIELDS;
+    mc_dispatch_barrier(dispatch);
+    bool ok = mc_csv_add_pass(dispatch, program, buffers, push, rowGroups);
+
+    // the columns are independent, so each pass runs all of them at once
+    uint32_t passes[3] = {
+        MC_CSV_PASS_CONVERT,
+        MC_CSV_PASS_NUMBER_DICT,
+        MC_CSV_PASS_REMAP_DICT,
+    };
+    for (uint32_t i = 0; i < 3 && ok; i++) {
+        push.pass = passes[i];
+        mc_dispatch_barrier(dispatch);
+        for (uint32_t c = 0; c < table->columnCount && ok; c++) {
+            if (push.pass != MC_CSV_PASS_CONVERT && !dicts[c]) continue;
+            push.column = c;
+            push.type = types[c];
+            buffers->values = table->columns[c];
+            buffers->dict = dicts[c];
+            buffers->entries = table->dictionaries[c];
+            uint32_t groups = push.pass == MC_CSV_PASS_NUMBER_DICT
+                                ? slotGroups
+                                : rowGroups;
+            ok = mc_csv_add_pass(dispatch, program, buffers, push, groups);
+        }
+    }
+
+    // read back {error count, errors}, then the dictionary sizes
+    uint64_t errorsSize = sizeof(uint32_t) * 2 * MC_CSV_MAX_ERRORS;
+    mc_dispatch_barrier(dispatch);
+    vkCmdCopyBuffer(
+        dispatch->cmdBuff,
+        buffers->meta->buf,
+        readback->buf,
+        1,
+        &(VkBufferCopy){4, 0, 4}
+    );
+    vkCmdCopyBuffer(
+        dispatch->cmdBuff,
+        buffers->meta->buf,
+        readback->buf,
+        1,
+        &(VkBufferCopy){16, 4, errorsSize}
+    );
+    for (uint32_t c = 0; c < table->columnCount; c++) {
+        if (!dicts[c]) continue;
+        vkCmdCopyBuffer(
+            dispatch->cmdBuff,
+            dicts[c]->buf,
+            readback->buf,
+            1,
+            &(VkBufferCopy){0, 4 + errorsSize + 4 * c, 4}
+        );
+    }
+
+    ok = ok && mc_dispatch_finish(dispatch)
+      && mc_dispatch_submit(dispatch) >= 0.0;
+    mc_dispatch_destroy(dispatch);
+    if (!ok) return false;
+
+    uint32_t* counts = readback->map;
+    table->errorCount = counts[0];
+    uint32_t kept = table->errorCount < MC_CSV_MAX_ERRORS
+                      ? table->errorCount
+                      : MC_CSV_MAX_ERRORS;
+    table->errors = malloc(sizeof *table->errors * (kept ? kept : 1));
+    for (uint32_t i = 0; i < kept; i++) {
+        table->errors[i] = (mc_CsvError){
+            .row = counts[1 + 2 * i],
+            .offset = counts[2 + 2 * i],
+        };
+    }
+    for (uint32_t c = 0; c < table->columnCount; c++)
+        if (dicts[c])
+            table->dictionarySizes[c] = counts[1 + 2 * MC_CSV_MAX_ERRORS + c];
+    return true;
+}
+
+mc_CsvTable* mc_csv_parse(
+    mc_Buffer* text,
+    uint64_t size,
+    char delimiter,
+    bool header,
+    uint32_t columnCount,
+    const mc_CsvType* types
+) {
+    if (!text) return NULL;
+
+    mc_CsvTable* table = malloc(sizeof *table);
+    *table = (mc_CsvTable){
+        ._instance = text->_instance,
+        .device = text->device,
+        .rowCount = 0,
+        .columnCount = columnCount,
+        .columns = calloc(columnCount + 1, sizeof *table->columns),
+        .dictionaries = calloc(columnCount + 1, sizeof *table->dictionaries),
+        .dictionarySizes = calloc(columnCount + 1, sizeof(uint32_t)),
+        .errorCount = 0,
+        .errors = NULL,
+    };
+
+    DEBUG(table, "parsing %ld bytes of CSV, columns: %d", size, columnCount);
+
+    bool valid = columnCount > 0 && types && delimiter != '"'
+              && delimiter != '\n' && delimiter != '\r';
+    for (uint32_t c = 0; c < columnCount && valid; c++)
+        valid = types[c] <= MC_CSV_TYPE_DICT;
+    if (!valid) {
+        ERROR(table, "invalid columns or delimiter");
+        mc_csv_table_destroy(table);
+        return NULL;
+    }
+
+    if (size > UINT32_MAX - 3 || text->size < (size + 3) / 4 * 4) {
+        ERROR(table, "text too large, or text buffer too small");
+        mc_csv_table_destroy(table);
+        return NULL;
+    }
+
+    mc_Program* program
+        = mc_program_get_builtin(table->device, "csv", csvSource);
+    if (!program) {
+        mc_csv_table_destroy(table);
+        return NULL;
+    }
+
+    // a record holds at least one byte and its newline
+    uint32_t blockCount = (size + MC_CSV_BLOCK_SIZE - 1) / MC_CSV_BLOCK_SIZE;
+    uint64_t maxRecords = (size + 1) / 2 + 1;
+    uint64_t errorsSize = sizeof(uint32_t) * 2 * MC_CSV_MAX_ERRORS;
+    mc_CsvBuffers buffers = {
+        .text = text,
+        .meta = mc_buffer_create(
+            table->device,
+            MC_BUFFER_TYPE_GPU,
+            16 + errorsSize
+        ),
+        .blocks = mc_buffer_create(
+            table->device,
+            MC_BUFFER_TYPE_GPU,
+            16 * (uint64_t)(blockCount ? blockCount : 1)
+        ),
+        .records = mc_buffer_create(
+            table->device,
+            MC_BUFFER_TYPE_GPU,
+            sizeof(uint32_t) * maxRecords
+        ),
+    };
+    mc_Buffer* readback = mc_buffer_create(
+        table->device,
+        MC_BUFFER_TYPE_CPU,
+        4 + errorsSize + 4 * (uint64_t)columnCount
+    );
+    mc_Buffer** dicts = calloc(columnCount, sizeof *dicts);
+
+    mc_CsvPush push = {
+        .size = size,
+        .blockCount = blockCount,
+        .delimiter = (uint8_t)delimiter,
+        .columnCount = columnCount,
+        .header = header,
+    };
+
+    bool ok = buffers.meta && buffers.blocks && buffers.records && readback;
+    int64_t records = -1;
+    if (ok) records = mc_csv_find_records(program, &buffers, push, readback);
+    ok = records >= 0;
+
+    if (ok) {
+        table->rowCount = records > header ? records - header : 0;
+        push.rowCount = table->rowCount;
+        uint64_t rows = table->rowCount ? table->rowCount : 1;
+
+        // the dictionary hash tables are at most half full
+        uint64_t slots = 2;
+        while (slots < 2 * rows) slots <<= 1;
+        push.slotMask = slots - 1;
+
+        buffers.fields = mc_buffer_create(
+            table->device,
+            MC_BUFFER_TYPE_GPU,
+            sizeof(uint32_t) * rows * (columnCount + 1)
+        );
+        ok = buffers.fields != NULL;
+        for (uint32_t c = 0; c < columnCount && ok; c++) {
+            table->columns[c] = mc_buffer_create(
+                table->device,
+                MC_BUFFER_TYPE_GPU,
+                sizeof(uint32_t) * rows
+            );
+            ok = table->columns[c] != NULL;
+            if (!ok || types[c] != MC_CSV_TYPE_DICT) continue;
+            dicts[c] = mc_buffer_create(
+                table->device,
+                MC_BUFFER_TYPE_GPU,
+                16 + 2 * sizeof(uint32_t) * slots
+            );
+            // the entries, then the strings: at most the text, plus a
+            // word of padding per string
+            table->dictionaries[c] = mc_buffer_create(
+                table->device,
+                MC_BUFFER_TYPE_GPU,
+                3 * sizeof(uint32_t) * rows + (size + 3) / 4 * 4
+            );
+            ok = dicts[c] && table->dictionaries[c];
+        }
+    }
+
+    if (ok) {
+        ok = mc_csv_convert(
+            table,
+            program,
+            &buffers,
+            push,
+            types,
+            dicts,
+            readback
+        );
+    }
+
+    for (uint32_t c = 0; c < columnCount; c++) mc_buffer_destroy(dicts[c]);
+    free(dicts);
+    mc_buffer_destroy(readback);
+    mc_buffer_destroy(buffers.fields);
+    mc_buffer_destroy(buffers.records);
+    mc_buffer_destroy(buffers.blocks);
+    mc_buffer_destroy(buffers.meta);
+
+    if (!ok) {
+        mc_csv_table_destroy(table);
+        return NULL;
+    }
+
+    if (table->errorCount)
+        WARN(table, "%d CSV error(s)", table->errorCount);
+    return table;
+}
+
+void mc_csv_table_destroy(mc_CsvTable* table) {
+    if (!table) return;
+    DEBUG(table, "destroying CSV table");
+
+    for (uint32_t c = 0; c < table->columnCount; c++) {
+        mc_buffer_destroy(table->columns[c]);
+        mc_buffer_destroy(table->dictionaries[c]);
+    }
+    free(table->columns);
+    free(table->dictionaries);
+    free(table->dictionarySizes);
+    free(table->errors);
+    free(table);
+}
+
+uint32_t mc_csv_table_get_row_count(mc_CsvTable* table) {
+    return table ? table->rowCount : 0;
+}
+
+mc_Buffer* mc_csv_table_get_column(mc_CsvTable* table, uint32_t column) {
+    if (!table || column >= table->columnCount) return NULL;
+    return table->columns[column];
+}
+
+mc_Buffer* mc_csv_table_get_dictionary(
+    mc_CsvTable* table,
+    uint32_t column,
+    uint32_t* size
+) {
+    if (!table || column >= table->columnCount) return NULL;
+    if (size) *size = table->dictionarySizes[column];
+    return table->dictionaries[column];
+}
+
+uint32_t mc_csv_table_get_errors(
+    mc_CsvTable* table,
+    const mc_CsvError** errors
+) {
+    if (!table) return 0;
+    if (errors) *errors = table->errors;
+    return table->errorCount;
+}
@@ -0,0 +1,19 @@
+#ifndef MC_CSV_H
+#define MC_CSV_H
+
+#include "microcompute.h"
+#include "microcompute_extra.h"
+
+struct mc_CsvTable {
+    mc_Instance* _instance;
+    mc_Device* device;
+    uint32_t rowCount;
+    uint32_t columnCount;
+    mc_Buffer** columns;
+    mc_Buffer** dictionaries; // `NULL` for the other columns
+    uint32_t* dictionarySizes;
+    uint32_t errorCount;
+    mc_CsvError* errors; // the first errors, at most `MC_CSV_MAX_ERRORS`
+};
+
+#endif // MC_CSV_H
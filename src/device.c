@@ -2,14 +2,50 @@
 #include <string.h>
 
 #include "device.h"
+#include "host_memory.h"
+#include "instance.h"
 #include "log.h"
+#include "program.h"
 
 uint32_t defaultReturn[] = {0, 0, 0};
 
+static bool mc_device_has_extension(
+    VkPhysicalDevice physDev,
+    const char* name
+) {
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(physDev, NULL, &count, NULL);
+    VkExtensionProperties* exts = malloc(sizeof *exts * (count + 1));
+    vkEnumerateDeviceExtensionProperties(physDev, NULL, &count, exts);
+
+    bool found = false;
+    for (uint32_t i = 0; i < count && !found; i++)
+        found = strcmp(exts[i].extensionName, name) == 0;
+
+    free(exts);
+    return found;
+}
+
+static uint64_t mc_device_get_import_alignment(
+    VkPhysicalDevice physDev,
+    PFN_vkGetPhysicalDeviceProperties2 getProps2
+) {
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProps = {0};
+    hostProps.sType
+        = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+
+    VkPhysicalDeviceProperties2 props = {0};
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props.pNext = &hostProps;
+    getProps2(physDev, &props);
+    return hostProps.minImportedHostPointerAlignment;
+}
+
 mc_Device* mc_device_create(
     mc_Instance* instance,
     VkPhysicalDevice physDev,
-    uint32_t queueFamilyIdx
+    uint32_t queueFamilyIdx,
+    uint32_t queueCount
 ) {
     if (!instance) return NULL;
 
@@ -23,29 +59,138 @@ mc_Device* mc_device_create(
         .maxWgSizeTotal = 0,
         .maxWgSizeShape = {0, 0, 0},
         .maxWgCount = {0, 0, 0},
+        .storageAlignment = 1,
+        .cmdDispatchBase = NULL,
+        .shaderClock = false,
+        .shaderDeviceClock = false,
+        .hostImport = false,
+        .hostImportAlignment = 0,
+        .getHostPointerProps = NULL,
+        .hostPageSize = 0,
+        .hostNumaNode = -1,
         .devName = {0},
+        .queueCount = queueCount ? queueCount : 1,
+        .queues = NULL,
+        .nextQueue = 0,
+        .createTime = mc_get_time(),
+        .pipelineCache = NULL,
+        .builtinCount = 0,
+        .builtins = NULL,
     };
 
-    float queuePriority = 1.0f;
+    mtx_init(&device->queueLock, mtx_plain);
+    mtx_init(&device->builtinLock, mtx_plain);
+
+    float* queuePriorities
+        = malloc(sizeof *queuePriorities * device->queueCount);
+    for (uint32_t i = 0; i < device->queueCount; i++)
+        queuePriorities[i] = 1.0f;
+
     VkDeviceQueueCreateInfo devQueueInfo = {0};
     devQueueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     devQueueInfo.queueFamilyIndex = device->queueFamilyIdx;
-    devQueueInfo.queueCount = 1;
-    devQueueInfo.pQueuePriorities = &queuePriority;
+    devQueueInfo.queueCount = device->queueCount;
+    devQueueInfo.pQueuePriorities = queuePriorities;
+
+    VkPhysicalDeviceProperties devProps;
+    vkGetPhysicalDeviceProperties(device->physDev, &devProps);
+    bool vulkan11 = instance->apiVersion >= VK_API_VERSION_1_1
+                 && devProps.apiVersion >= VK_API_VERSION_1_1;
+
+    // shader clocks are only used to profile workgroups, see wg_profiler.c
+    VkPhysicalDeviceShaderClockFeaturesKHR clockFeatures = {0};
+    clockFeatures.sType
+        = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CLOCK_FEATURES_KHR;
+
+    PFN_vkGetPhysicalDeviceFeatures2 getFeatures2
+        = (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(
+            instance->instance,
+            "vkGetPhysicalDeviceFeatures2"
+        );
+    if (vulkan11 && getFeatures2
+        && mc_device_has_extension(
+            device->physDev,
+            VK_KHR_SHADER_CLOCK_EXTENSION_NAME
+        )) {
+        VkPhysicalDeviceFeatures2 features = {0};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &clockFeatures;
+        getFeatures2(device->physDev, &features);
+        device->shaderClock = clockFeatures.shaderSubgroupClock;
+        device->shaderDeviceClock = clockFeatures.shaderDeviceClock;
+    }
+
+    // importing host memory is only used for custom staging memory, see
+    // mc_device_set_host_memory()
+    PFN_vkGetPhysicalDeviceProperties2 getProps2
+        = (PFN_vkGetPhysicalDeviceProperties2)vkGetInstanceProcAddr(
+            instance->instance,
+            "vkGetPhysicalDeviceProperties2"
+        );
+    if (vulkan11 && getProps2
+        && mc_device_has_extension(
+            device->physDev,
+            VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME
+        )) {
+        device->hostImport = true;
+        device->hostImportAlignment
+            = mc_device_get_import_alignment(device->physDev, getProps2);
+    }
+
+    uint32_t extCount = 0;
+    const char* exts[2];
+    if (device->shaderClock)
+        exts[extCount++] = VK_KHR_SHADER_CLOCK_EXTENSION_NAME;
+    if (device->hostImport)
+        exts[extCount++] = VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME;
 
     VkDeviceCreateInfo devInfo = {0};
     devInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    devInfo.pNext = device->shaderClock ? &clockFeatures : NULL;
     devInfo.queueCreateInfoCount = 1;
     devInfo.pQueueCreateInfos = &devQueueInfo;
+    devInfo.enabledExtensionCount = extCount;
+    devInfo.ppEnabledExtensionNames = exts;
 
     if (vkCreateDevice(device->physDev, &devInfo, NULL, &device->dev)) {
         ERROR(device, "failed to create device");
+        free(queuePriorities);
         mc_device_destroy(device);
         return NULL;
     }
 
-    VkPhysicalDeviceProperties devProps;
-    vkGetPhysicalDeviceProperties(device->physDev, &devProps);
+    free(queuePriorities);
+
+    device->queues = malloc(sizeof *device->queues * device->queueCount);
+    for (uint32_t i = 0; i < device->queueCount; i++) {
+        device->queues[i] = (mc_Queue){
+            .queue = NULL,
+            .pending = 0,
+            .submitCount = 0,
+            .busyTime = 0.0,
+            .busySince = 0.0,
+        };
+        mtx_init(&device->queues[i].lock, mtx_plain);
+        vkGetDeviceQueue(
+            device->dev,
+            device->queueFamilyIdx,
+            i,
+            &device->queues[i].queue
+        );
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheInfo = {0};
+    pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+    if (vkCreatePipelineCache(
+            device->dev,
+            &pipelineCacheInfo,
+            NULL,
+            &device->pipelineCache
+        )) {
+        WARN(device, "failed to create pipeline cache");
+        device->pipelineCache = NULL;
+    }
 
     switch (devProps.deviceType) {
         case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
@@ -79,6 +224,24 @@ mc_Device* mc_device_create(
         sizeof devProps.limits.maxComputeWorkGroupCount
     );
 
+    device->storageAlignment = devProps.limits.minStorageBufferOffsetAlignment;
+
+    if (vulkan11) {
+        device->cmdDispatchBase = (PFN_vkCmdDispatchBase)vkGetDeviceProcAddr(
+            device->dev,
+            "vkCmdDispatchBase"
+        );
+    }
+
+    if (device->hostImport) {
+        device->getHostPointerProps
+            = (PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(
+                device->dev,
+                "vkGetMemoryHostPointerPropertiesEXT"
+            );
+        device->hostImport = device->getHostPointerProps != NULL;
+    }
+
     memcpy(device->devName, devProps.deviceName, sizeof devProps.deviceName);
 
     return device;
@@ -87,10 +250,93 @@ mc_Device* mc_device_create(
 void mc_device_destroy(mc_Device* device) {
     if (!device) return;
     DEBUG(device, "destroying device");
+    for (uint32_t i = 0; i < device->builtinCount; i++) {
+        mc_program_destroy(device->builtins[i].program);
+        free(device->builtins[i].name);
+    }
+    free(device->builtins);
+    if (device->queues) {
+        for (uint32_t i = 0; i < device->queueCount; i++)
+            mtx_destroy(&device->queues[i].lock);
+        free(device->queues);
+    }
+    if (device->pipelineCache)
+        vkDestroyPipelineCache(device->dev, device->pipelineCache, NULL);
     if (device->dev) vkDestroyDevice(device->dev, NULL);
+    mtx_destroy(&device->queueLock);
+    mtx_destroy(&device->builtinLock);
     free(device);
 }
 
+mc_Queue* mc_device_acquire_queue(mc_Device* device) {
+    mtx_lock(&device->queueLock);
+
+    // pick the least loaded queue, starting the search from the queue after
+    // the last one handed out so that ties are broken round-robin
+    mc_Queue* best = NULL;
+    uint32_t bestIdx = 0;
+    for (uint32_t i = 0; i < device->queueCount; i++) {
+        uint32_t idx = (device->nextQueue + i) % device->queueCount;
+        mc_Queue* queue = &device->queues[idx];
+        if (!best || queue->pending < best->pending) {
+            best = queue;
+            bestIdx = idx;
+        }
+        if (best->pending == 0) break;
+    }
+
+    device->nextQueue = (bestIdx + 1) % device->queueCount;
+    if (best->pending++ == 0) best->busySince = mc_get_time();
+    best->submitCount++;
+
+    mtx_unlock(&device->queueLock);
+    return best;
+}
+
+void mc_device_release_queue(mc_Device* device, mc_Queue* queue) {
+    mtx_lock(&device->queueLock);
+    if (--queue->pending == 0)
+        queue->busyTime += mc_get_time() - queue->busySince;
+    mtx_unlock(&device->queueLock);
+}
+
+double mc_device_submit(
+    mc_Device* device,
+    VkCommandBuffer cmdBuff,
+    VkFence fence
+) {
+    mc_Queue* queue = mc_device_acquire_queue(device);
+
+    VkSubmitInfo submitInfo = {0};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmdBuff;
+
+    mtx_lock(&queue->lock);
+    VkResult res = vkQueueSubmit(queue->queue, 1, &submitInfo, fence);
+    mtx_unlock(&queue->lock);
+
+    if (res) {
+        ERROR(device, "failed to submit queue");
+        mc_device_release_queue(device, queue);
+        return -1.0;
+    }
+
+    double startTime = mc_get_time();
+    res = vkWaitForFences(device->dev, 1, &fence, VK_TRUE, UINT64_MAX);
+    double time = mc_get_time() - startTime;
+
+    vkResetFences(device->dev, 1, &fence);
+    mc_device_release_queue(device, queue);
+
+    if (res) {
+        ERROR(device, "failed to wait for queue completion");
+        return -1.0;
+    }
+
+    return time;
+}
+
 mc_DeviceType mc_device_get_type(mc_Device* device) {
     return device ? device->type : MC_DEVICE_TYPE_OTHER;
 }
@@ -107,6 +353,74 @@ uint32_t* mc_device_get_max_workgroup_count(mc_Device* device) {
     return device ? device->maxWgCount : defaultReturn;
 }
 
+uint64_t mc_device_get_storage_alignment(mc_Device* device) {
+    return device ? device->storageAlignment : 0;
+}
+
+bool mc_device_set_host_memory(
+    mc_Device* device,
+    uint64_t pageSize,
+    int32_t numaNode
+) {
+    if (!device) return false;
+    DEBUG(
+        device,
+        "setting host memory, page size: %ld, numa node: %d",
+        pageSize,
+        numaNode
+    );
+
+    if (pageSize == 0) {
+        device->hostPageSize = 0;
+        device->hostNumaNode = -1;
+        return true;
+    }
+
+    if (!device->hostImport) {
+        ERROR(device, "device does not support VK_EXT_external_memory_host");
+        return false;
+    }
+
+    if (pageSize & (pageSize - 1) || pageSize < 4096) {
+        ERROR(device, "page size must be a power of two, at least 4096");
+        return false;
+    }
+
+    // check that the memory can actually be allocated on this host
+    void* probe = mc_host_memory_alloc(pageSize, pageSize, numaNode);
+    if (!probe) {
+        ERROR(device, "failed to allocate host memory with these settings");
+        return false;
+    }
+    mc_host_memory_free(probe, pageSize);
+
+    device->hostPageSize = pageSize;
+    device->hostNumaNode = numaNode;
+    return true;
+}
+
 char* mc_device_get_name(mc_Device* device) {
     return device ? device->devName : NULL;
+}
+
+uint32_t mc_device_get_queue_count(mc_Device* device) {
+    return device ? device->queueCount : 0;
+}
+
+mc_QueueStats mc_device_get_queue_stats(mc_Device* device, uint32_t idx) {
+    mc_QueueStats stats = {0};
+    if (!device || idx >= device->queueCount) return stats;
+
+    mtx_lock(&device->queueLock);
+    mc_Queue* queue = &device->queues[idx];
+    double now = mc_get_time();
+    stats.submitCount = queue->submitCount;
+    stats.pendingCount = queue->pending;
+    stats.busyTime = queue->busyTime;
+    if (queue->pending) stats.busyTime += now - queue->busySince;
+    mtx_unlock(&device->queueLock);
+
+    double elapsed = now - device->createTime;
+    stats.utilization = elapsed > 0.0 ? stats.busyTime / elapsed : 0.0;
+    return stats;
 }
\ No newline at end of file
@@ -1,10 +1,26 @@
 #ifndef MC_DEVICE_H
 #define MC_DEVICE_H
 
+#include <threads.h>
 #include <vulkan/vulkan.h>
 
 #include "microcompute.h"
 
+typedef struct mc_Queue {
+    VkQueue queue;
+    mtx_t lock;         // guards vkQueueSubmit on this queue
+    uint32_t pending;   // submissions in flight, guarded by the device lock
+    uint64_t submitCount;
+    double busyTime;
+    double busySince;
+} mc_Queue;
+
+// a program used internally, compiled on first use
+typedef struct mc_Builtin {
+    char* name;
+    mc_Program* program;
+} mc_Builtin;
+
 struct mc_Device {
     mc_Instance* _instance;
     VkPhysicalDevice physDev;
@@ -14,15 +30,44 @@ struct mc_Device {
     uint32_t maxWgSizeTotal;
     uint32_t maxWgSizeShape[3];
     uint32_t maxWgCount[3];
+    uint64_t storageAlignment;
+    PFN_vkCmdDispatchBase cmdDispatchBase; // `NULL` before vulkan 1.1
+    bool shaderClock;       // VK_KHR_shader_clock, subgroup scope
+    bool shaderDeviceClock; // VK_KHR_shader_clock, device scope
+    bool hostImport;        // VK_EXT_external_memory_host
+    uint64_t hostImportAlignment;
+    PFN_vkGetMemoryHostPointerPropertiesEXT getHostPointerProps;
+    uint64_t hostPageSize; // 0 when CPU buffers use driver allocated memory
+    int32_t hostNumaNode;  // -1 for any node
     char devName[256];
+    uint32_t queueCount;
+    mc_Queue* queues;
+    uint32_t nextQueue;
+    mtx_t queueLock;
+    double createTime;
+    VkPipelineCache pipelineCache;
+    mtx_t builtinLock;
+    uint32_t builtinCount;
+    mc_Builtin* builtins;
 };
 
 mc_Device* mc_device_create(
     mc_Instance* instance,
     VkPhysicalDevice physDev,
-    uint32_t queueFamilyIdx
+    uint32_t queueFamilyIdx,
+    uint32_t queueCount
 );
 
 void mc_device_destroy(mc_Device* device);
 
-#endif // MC_DEVICE_H
\ No newline at end of file
+mc_Queue* mc_device_acquire_queue(mc_Device* device);
+
+void mc_device_release_queue(mc_Device* device, mc_Queue* queue);
+
+double mc_device_submit(
+    mc_Device* device,
+    VkCommandBuffer cmdBuff,
+    VkFence fence
+);
+
+#endif // MC_DEVICE_H
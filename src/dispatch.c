@@ -0,0 +1,700 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "dispatch.h"
+#include "log.h"
+
+// the number of descriptor sets in each descriptor pool of a dispatch
+#define MC_DISPATCH_POOL_SETS 64
+
+// the min number of buffer descriptors in each descriptor pool of a dispatch
+#define MC_DISPATCH_POOL_BUFFS 256
+
+// stops an iteration (by zeroing the indirect dispatch arguments) once the
+// active flag has not been set since the last check
+static const char* iterateControlSource
+    = "#version 450\n"
+      "layout(local_size_x = 1) in;\n"
+      "layout(std430, binding = 0) buffer flagBuff {\n"
+      "    uint active;\n"
+      "};\n"
+      "layout(std430, binding = 1) buffer ctrlBuff {\n"
+      "    uvec4 args;\n"
+      "    uint iterations;\n"
+      "};\n"
+      "layout(push_constant) uniform Push {\n"
+      "    uint checkpoint;\n"
+      "};\n"
+      "void main(void) {\n"
+      "    if (args.x == 0) return;\n"
+      "    if (active == 0) {\n"
+      "        args = uvec4(0);\n"
+      "        iterations = checkpoint;\n"
+      "    }\n"
+      "    active = 0;\n"
+      "}\n";
+
+static bool mc_dispatch_add_pool(mc_Dispatch* dispatch, uint32_t buffCount) {
+    uint32_t poolBuffs = MC_DISPATCH_POOL_BUFFS;
+    if (buffCount > poolBuffs) poolBuffs = buffCount;
+
+    VkDescriptorPoolSize descPoolSize = {0};
+    descPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descPoolSize.descriptorCount = poolBuffs;
+
+    VkDescriptorPoolCreateInfo descPoolInfo = {0};
+    descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descPoolInfo.maxSets = MC_DISPATCH_POOL_SETS;
+    descPoolInfo.poolSizeCount = 1;
+    descPoolInfo.pPoolSizes = &descPoolSize;
+
+    VkDescriptorPool descPool;
+    if (vkCreateDescriptorPool(
+            dispatch->device->dev,
+            &descPoolInfo,
+            NULL,
+            &descPool
+        )) {
+        ERROR(dispatch, "failed to create descriptor pool");
+        return false;
+    }
+
+    dispatch->descPools = realloc(
+        dispatch->descPools,
+        sizeof *dispatch->descPools * (dispatch->descPoolCount + 1)
+    );
+    dispatch->descPools[dispatch->descPoolCount++] = descPool;
+    dispatch->descSetsLeft = MC_DISPATCH_POOL_SETS;
+    dispatch->descBuffsLeft = poolBuffs;
+    return true;
+}
+
+mc_Dispatch* mc_dispatch_create(mc_Device* device) {
+    if (!device) return NULL;
+
+    mc_Dispatch* dispatch = malloc(sizeof *dispatch);
+    *dispatch = (mc_Dispatch){
+        ._instance = device->_instance,
+        .device = device,
+        .descPoolCount = 0,
+        .descPools = NULL,
+        .descSetsLeft = 0,
+        .descBuffsLeft = 0,
+        .cmdPool = NULL,
+        .cmdBuff = NULL,
+        .fence = NULL,
+        .boundPipeline = NULL,
+        .failed = false,
+    };
+
+    VkCommandPoolCreateInfo cmdPoolInfo = {0};
+    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolInfo.queueFamilyIndex = device->queueFamilyIdx;
+
+    if (vkCreateCommandPool(
+            device->dev,
+            &cmdPoolInfo,
+            NULL,
+            &dispatch->cmdPool
+        )) {
+        ERROR(dispatch, "failed to create command pool");
+        mc_dispatch_destroy(dispatch);
+        return NULL;
+    }
+
+    VkCommandBufferAllocateInfo cmdBuffAllocInfo = {0};
+    cmdBuffAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBuffAllocInfo.commandPool = dispatch->cmdPool;
+    cmdBuffAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdBuffAllocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(
+            device->dev,
+            &cmdBuffAllocInfo,
+            &dispatch->cmdBuff
+        )) {
+        ERROR(dispatch, "failed to allocate command buffers");
+        mc_dispatch_destroy(dispatch);
+        return NULL;
+    }
+
+    VkFenceCreateInfo fenceInfo = {0};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    if (vkCreateFence(device->dev, &fenceInfo, NULL, &dispatch->fence)) {
+        ERROR(dispatch, "failed to create fence");
+        mc_dispatch_destroy(dispatch);
+        return NULL;
+    }
+
+    VkCommandBufferBeginInfo cmdBuffBeginInfo = {0};
+    cmdBuffBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    if (vkBeginCommandBuffer(dispatch->cmdBuff, &cmdBuffBeginInfo)) {
+        ERROR(dispatch, "failed to begin command buffer");
+        mc_dispatch_destroy(dispatch);
+        return NULL;
+    }
+
+    return dispatch;
+}
+
+VkDescriptorSet mc_dispatch_create_set(
+    mc_Dispatch* dispatch,
+    mc_Pipeline* pipeline,
+    uint32_t buffCount,
+    mc_Buffer** buffs
+) {
+    if (dispatch->descSetsLeft == 0 || dispatch->descBuffsLeft < buffCount) {
+        if (!mc_dispatch_add_pool(dispatch, buffCount)) {
+            dispatch->failed = true;
+            return NULL;
+        }
+    }
+
+    VkDescriptorSetAllocateInfo descAllocInfo = {0};
+    descAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descAllocInfo.descriptorPool
+        = dispatch->descPools[dispatch->descPoolCount - 1];
+    descAllocInfo.descriptorSetCount = 1;
+    descAllocInfo.pSetLayouts = &pipeline->descSetLayout;
+
+    VkDescriptorSet descSet;
+    if (vkAllocateDescriptorSets(
+            dispatch->device->dev,
+            &descAllocInfo,
+            &descSet
+        )) {
+        ERROR(dispatch, "failed to allocate descriptor sets");
+        dispatch->failed = true;
+        return NULL;
+    }
+
+    dispatch->descSetsLeft--;
+    dispatch->descBuffsLeft -= buffCount;
+
+    VkDescriptorBufferInfo* descBuffInfo
+        = malloc(sizeof *descBuffInfo * buffCount);
+    VkWriteDescriptorSet* wrtDescSet = malloc(sizeof *wrtDescSet * buffCount);
+
+    for (uint32_t i = 0; i < buffCount; i++) {
+        descBuffInfo[i] = (VkDescriptorBufferInfo){0};
+        descBuffInfo[i].buffer = buffs[i]->buf;
+        descBuffInfo[i].range = VK_WHOLE_SIZE;
+
+        wrtDescSet[i] = (VkWriteDescriptorSet){0};
+        wrtDescSet[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        wrtDescSet[i].dstSet = descSet;
+        wrtDescSet[i].dstBinding = i;
+        wrtDescSet[i].descriptorCount = 1;
+        wrtDescSet[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        wrtDescSet[i].pBufferInfo = &descBuffInfo[i];
+    }
+
+    vkUpdateDescriptorSets(
+        dispatch->device->dev,
+        buffCount,
+        wrtDescSet,
+        0,
+        NULL
+    );
+    free(descBuffInfo);
+    free(wrtDescSet);
+
+    return descSet;
+}
+
+void mc_dispatch_bind(
+    mc_Dispatch* dispatch,
+    mc_Pipeline* pipeline,
+    VkDescriptorSet descSet
+) {
+    if (dispatch->boundPipeline != pipeline->pipeline) {
+        vkCmdBindPipeline(
+            dispatch->cmdBuff,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            pipeline->pipeline
+        );
+        dispatch->boundPipeline = pipeline->pipeline;
+    }
+
+    vkCmdBindDescriptorSets(
+        dispatch->cmdBuff,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        pipeline->pipelineLayout,
+        0,
+        1,
+        &descSet,
+        0,
+        NULL
+    );
+}
+
+void mc_dispatch_push(
+    mc_Dispatch* dispatch,
+    mc_Pipeline* pipeline,
+    uint32_t size,
+    const void* data
+) {
+    vkCmdPushConstants(
+        dispatch->cmdBuff,
+        pipeline->pipelineLayout,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0,
+        size,
+        data
+    );
+}
+
+bool mc_dispatch_add(
+    mc_Dispatch* dispatch,
+    mc_Program* program,
+    uint32_t dim[3],
+    uint32_t buffCount,
+    mc_Buffer** buffs
+) {
+    return mc_dispatch_add_pushed(
+        dispatch,
+        program,
+        dim,
+        buffCount,
+        buffs,
+        0,
+        NULL
+    );
+}
+
+bool mc_dispatch_add_pushed(
+    mc_Dispatch* dispatch,
+    mc_Program* program,
+    uint32_t dim[3],
+    uint32_t buffCount,
+    mc_Buffer** buffs,
+    uint32_t pushSize,
+    const void* pushData
+) {
+    if (dim[0] * dim[1] * dim[2] == 0) {
+        ERROR(dispatch, "at least one dimension is 0");
+        dispatch->failed = true;
+        return false;
+    }
+
+    for (uint32_t i = 0; i < buffCount; i++) {
+        if (!buffs[i]) {
+            ERROR(dispatch, "buffer %d is NULL", i);
+            dispatch->failed = true;
+            return false;
+        }
+    }
+
+    mc_Pipeline* pipeline = mc_program_get_pipeline(program, buffCount);
+    if (!pipeline) {
+        dispatch->failed = true;
+        return false;
+    }
+
+    VkDescriptorSet descSet
+        = mc_dispatch_create_set(dispatch, pipeline, buffCount, buffs);
+    if (!descSet) return false;
+
+    mc_dispatch_bind(dispatch, pipeline, descSet);
+    if (pushSize) mc_dispatch_push(dispatch, pipeline, pushSize, pushData);
+    vkCmdDispatch(dispatch->cmdBuff, dim[0], dim[1], dim[2]);
+    return true;
+}
+
+void mc_dispatch_barrier(mc_Dispatch* dispatch) {
+    VkMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT
+                          | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+                          | VK_ACCESS_SHADER_WRITE_BIT
+                          | VK_ACCESS_TRANSFER_READ_BIT
+                          | VK_ACCESS_TRANSFER_WRITE_BIT
+                          | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+    vkCmdPipelineBarrier(
+        dispatch->cmdBuff,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT
+            | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        NULL,
+        0,
+        NULL
+    );
+}
+
+bool mc_dispatch_finish(mc_Dispatch* dispatch) {
+    // make the results visible to the host, for CPU buffers
+    VkMemoryBarrier barrier = {0};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT
+                          | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(
+        dispatch->cmdBuff,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        NULL,
+        0,
+        NULL
+    );
+
+    if (vkEndCommandBuffer(dispatch->cmdBuff)) {
+        ERROR(dispatch, "failed to end command buffer");
+        dispatch->failed = true;
+    }
+    return !dispatch->failed;
+}
+
+mc_Dispatch* mc_program_prepare(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    uint32_t dimZ,
+    uint32_t buffCount,
+    mc_Buffer** buffs
+) {
+    if (!program) return NULL;
+    DEBUG(
+        program,
+        "preparing %dx%dx%d dispatch with %d buffer(s)",
+        dimX,
+        dimY,
+        dimZ,
+        buffCount
+    );
+
+    mc_Dispatch* dispatch = mc_dispatch_create(program->device);
+    if (!dispatch) return NULL;
+
+    uint32_t dim[3] = {dimX, dimY, dimZ};
+    mc_dispatch_add(dispatch, program, dim, buffCount, buffs);
+
+    if (!mc_dispatch_finish(dispatch)) {
+        mc_dispatch_destroy(dispatch);
+        return NULL;
+    }
+
+    return dispatch;
+}
+
+mc_Dispatch* mc_program_prepare_batch(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    uint32_t dimZ,
+    uint32_t buffCount,
+    mc_Buffer** buffSets,
+    uint32_t count
+) {
+    if (!program) return NULL;
+    DEBUG(
+        program,
+        "preparing %d %dx%dx%d dispatches with %d buffer(s)",
+        count,
+        dimX,
+        dimY,
+        dimZ,
+        buffCount
+    );
+
+    if (count == 0) {
+        ERROR(program, "batch is empty");
+        return NULL;
+    }
+
+    mc_Dispatch* dispatch = mc_dispatch_create(program->device);
+    if (!dispatch) return NULL;
+
+    // the instances are independent, so no barriers are needed between them
+    uint32_t dim[3] = {dimX, dimY, dimZ};
+    for (uint32_t i = 0; i < count; i++) {
+        mc_Buffer** buffs = &buffSets[i * buffCount];
+        if (!mc_dispatch_add(dispatch, program, dim, buffCount, buffs)) break;
+    }
+
+    if (!mc_dispatch_finish(dispatch)) {
+        mc_dispatch_destroy(dispatch);
+        return NULL;
+    }
+
+    return dispatch;
+}
+
+double mc_program_run_batch(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    uint32_t dimZ,
+    uint32_t buffCount,
+    mc_Buffer** buffSets,
+    uint32_t count
+) {
+    mc_Dispatch* dispatch = mc_program_prepare_batch(
+        program,
+        dimX,
+        dimY,
+        dimZ,
+        buffCount,
+        buffSets,
+        count
+    );
+    if (!dispatch) return -1.0;
+
+    double time = mc_dispatch_submit(dispatch);
+    mc_dispatch_destroy(dispatch);
+    return time;
+}
+
+mc_Dispatch* mc_program_prepare_swizzled(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    mc_LaunchOrder order,
+    uint32_t groupSize,
+    uint32_t buffCount,
+    mc_Buffer** buffs
+) {
+    if (!program) return NULL;
+    DEBUG(
+        program,
+        "preparing %dx%d swizzled dispatch, order: %d, group size: %d",
+        dimX,
+        dimY,
+        order,
+        groupSize
+    );
+
+    if (order == MC_LAUNCH_ORDER_MORTON && (groupSize & (groupSize - 1))) {
+        ERROR(program, "morton order needs a power of two group size");
+        return NULL;
+    }
+
+    mc_Dispatch* dispatch = mc_dispatch_create(program->device);
+    if (!dispatch) return NULL;
+
+    // the remapping is done by the `microcompute/swizzle.glsl` include, the
+    // workgroups are still dispatched as a regular 2D grid
+    uint32_t dim[3] = {dimX, dimY, 1};
+    uint32_t push[2] = {order, groupSize};
+    mc_dispatch_add_pushed(
+        dispatch,
+        program,
+        dim,
+        buffCount,
+        buffs,
+        sizeof push,
+        push
+    );
+
+    if (!mc_dispatch_finish(dispatch)) {
+        mc_dispatch_destroy(dispatch);
+        return NULL;
+    }
+
+    return dispatch;
+}
+
+double mc_program_run_swizzled(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    mc_LaunchOrder order,
+    uint32_t groupSize,
+    uint32_t buffCount,
+    mc_Buffer** buffs
+) {
+    mc_Dispatch* dispatch = mc_program_prepare_swizzled(
+        program,
+        dimX,
+        dimY,
+        order,
+        groupSize,
+        buffCount,
+        buffs
+    );
+    if (!dispatch) return -1.0;
+
+    double time = mc_dispatch_submit(dispatch);
+    mc_dispatch_destroy(dispatch);
+    return time;
+}
+
+double mc_program_run_indirect(
+    mc_Program* program,
+    mc_Buffer* args,
+    uint64_t offset,
+    uint32_t buffCount,
+    mc_Buffer** buffs
+) {
+    if (!program || !args) return -1.0;
+    DEBUG(program, "running indirect dispatch with %d buffer(s)", buffCount);
+
+    if (offset % 4 || offset + 3 * sizeof(uint32_t) > args->size) {
+        ERROR(program, "invalid indirect arguments offset");
+        return -1.0;
+    }
+
+    mc_Pipeline* pipeline = mc_program_get_pipeline(program, buffCount);
+    if (!pipeline) return -1.0;
+
+    mc_Dispatch* dispatch = mc_dispatch_create(program->device);
+    if (!dispatch) return -1.0;
+
+    VkDescriptorSet descSet
+        = mc_dispatch_create_set(dispatch, pipeline, buffCount, buffs);
+    if (descSet) {
+        mc_dispatch_bind(dispatch, pipeline, descSet);
+        vkCmdDispatchIndirect(dispatch->cmdBuff, args->buf, offset);
+    }
+
+    double time = -1.0;
+    if (mc_dispatch_finish(dispatch)) time = mc_dispatch_submit(dispatch);
+    mc_dispatch_destroy(dispatch);
+    return time;
+}
+
+double mc_program_iterate(
+    mc_Program* program,
+    uint32_t dimX,
+    uint32_t dimY,
+    uint32_t dimZ,
+    uint32_t iterations,
+    uint32_t buffCount,
+    mc_Buffer** ping,
+    mc_Buffer** pong,
+    mc_Buffer* activeFlag,
+    uint32_t checkInterval,
+    uint32_t* iterationsRun
+) {
+    if (!program) return -1.0;
+    DEBUG(program, "iterating %dx%dx%d program", dimX, dimY, dimZ);
+
+    if (iterationsRun) *iterationsRun = 0;
+    if (iterations == 0) return 0.0;
+
+    if (dimX * dimY * dimZ == 0) {
+        ERROR(program, "at least one dimension is 0");
+        return -1.0;
+    }
+
+    mc_Device* device = program->device;
+    bool earlyExit = activeFlag && checkInterval > 0;
+    mc_Program* control = NULL;
+    mc_Buffer* ctrlBuff = NULL;
+
+    if (earlyExit) {
+        control = mc_program_get_builtin(
+            device,
+            "iterate_control",
+            iterateControlSource
+        );
+        if (!control) return -1.0;
+
+        // indirect dispatch arguments, padding and the number of iterations
+        uint32_t ctrl[5] = {dimX, dimY, dimZ, 0, iterations};
+        ctrlBuff = mc_buffer_create(device, MC_BUFFER_TYPE_CPU, sizeof ctrl);
+        if (!ctrlBuff) return -1.0;
+        mc_buffer_write(ctrlBuff, 0, sizeof ctrl, ctrl);
+    }
+
+    mc_Dispatch* dispatch = mc_dispatch_create(device);
+    if (!dispatch) {
+        mc_buffer_destroy(ctrlBuff);
+        return -1.0;
+    }
+
+    mc_Pipeline* pipeline = mc_program_get_pipeline(program, buffCount);
+    mc_Pipeline* ctrlPipeline = control ? mc_program_get_pipeline(control, 2)
+                                        : NULL;
+
+    if (!pipeline || (earlyExit && !ctrlPipeline)) {
+        mc_dispatch_destroy(dispatch);
+        mc_buffer_destroy(ctrlBuff);
+        return -1.0;
+    }
+
+    VkDescriptorSet descSets[2] = {
+        mc_dispatch_create_set(dispatch, pipeline, buffCount, ping),
+        mc_dispatch_create_set(dispatch, pipeline, buffCount, pong),
+    };
+    VkDescriptorSet ctrlDescSet = NULL;
+    if (earlyExit) {
+        mc_Buffer* ctrlBuffs[2] = {activeFlag, ctrlBuff};
+        ctrlDescSet
+            = mc_dispatch_create_set(dispatch, ctrlPipeline, 2, ctrlBuffs);
+    }
+
+    for (uint32_t i = 0; i < iterations && !dispatch->failed; i++) {
+        if (i > 0) mc_dispatch_barrier(dispatch);
+
+        mc_dispatch_bind(dispatch, pipeline, descSets[i % 2]);
+        if (earlyExit)
+            vkCmdDispatchIndirect(dispatch->cmdBuff, ctrlBuff->buf, 0);
+        else vkCmdDispatch(dispatch->cmdBuff, dimX, dimY, dimZ);
+
+        if (earlyExit && (i + 1) % checkInterval == 0 && i + 1 < iterations) {
+            uint32_t checkpoint = i + 1;
+            mc_dispatch_barrier(dispatch);
+            mc_dispatch_bind(dispatch, ctrlPipeline, ctrlDescSet);
+            mc_dispatch_push(
+                dispatch,
+                ctrlPipeline,
+                sizeof checkpoint,
+                &checkpoint
+            );
+            vkCmdDispatch(dispatch->cmdBuff, 1, 1, 1);
+        }
+    }
+
+    double time = -1.0;
+    if (mc_dispatch_finish(dispatch)) time = mc_dispatch_submit(dispatch);
+
+    if (iterationsRun && time >= 0.0) {
+        *iterationsRun = iterations;
+        uint64_t offset = 4 * sizeof(uint32_t);
+        if (earlyExit)
+            mc_buffer_read(ctrlBuff, offset, sizeof(uint32_t), iterationsRun);
+    }
+
+    mc_dispatch_destroy(dispatch);
+    mc_buffer_destroy(ctrlBuff);
+    return time;
+}
+
+double mc_dispatch_submit(mc_Dispatch* dispatch) {
+    if (!dispatch) return -1.0;
+    return mc_device_submit(
+        dispatch->device,
+        dispatch->cmdBuff,
+        dispatch->fence
+    );
+}
+
+void mc_dispatch_destroy(mc_Dispatch* dispatch) {
+    if (!dispatch) return;
+    DEBUG(dispatch, "destroying dispatch");
+
+    VkDevice dev = dispatch->device->dev;
+    if (dispatch->fence) vkDestroyFence(dev, dispatch->fence, NULL);
+    if (dispatch->cmdBuff)
+        vkFreeCommandBuffers(dev, dispatch->cmdPool, 1, &dispatch->cmdBuff);
+    if (dispatch->cmdPool) vkDestroyCommandPool(dev, dispatch->cmdPool, NULL);
+    for (uint32_t i = 0; i < dispatch->descPoolCount; i++)
+        vkDestroyDescriptorPool(dev, dispatch->descPools[i], NULL);
+    free(dispatch->descPools);
+    free(dispatch);
+}
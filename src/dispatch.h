@@ -0,0 +1,68 @@
+#ifndef MC_DISPATCH_H
+#define MC_DISPATCH_H
+
+#include <vulkan/vulkan.h>
+
+#include "microcompute.h"
+#include "program.h"
+
+struct mc_Dispatch {
+    mc_Instance* _instance;
+    mc_Device* device;
+    uint32_t descPoolCount;
+    VkDescriptorPool* descPools;
+    uint32_t descSetsLeft;  // sets left in the last descriptor pool
+    uint32_t descBuffsLeft; // buffer descriptors left in the last pool
+    VkCommandPool cmdPool;
+    VkCommandBuffer cmdBuff;
+    VkFence fence;
+    VkPipeline boundPipeline;
+    bool failed;
+};
+
+mc_Dispatch* mc_dispatch_create(mc_Device* device);
+
+VkDescriptorSet mc_dispatch_create_set(
+    mc_Dispatch* dispatch,
+    mc_Pipeline* pipeline,
+    uint32_t buffCount,
+    mc_Buffer** buffs
+);
+
+void mc_dispatch_bind(
+    mc_Dispatch* dispatch,
+    mc_Pipeline* pipeline,
+    VkDescriptorSet descSet
+);
+
+void mc_dispatch_push(
+    mc_Dispatch* dispatch,
+    mc_Pipeline* pipeline,
+    uint32_t size,
+    const void* data
+);
+
+bool mc_dispatch_add(
+    mc_Dispatch* dispatch,
+    mc_Program* program,
+    uint32_t dim[3],
+    uint32_t buffCount,
+    mc_Buffer** buffs
+);
+
+// same as mc_dispatch_add(), with push constants for the program
+bool mc_dispatch_add_pushed(
+    mc_Dispatch* dispatch,
+    mc_Program* program,
+    uint32_t dim[3],
+    uint32_t buffCount,
+    mc_Buffer** buffs,
+    uint32_t pushSize,
+    const void* pushData
+);
+
+void mc_dispatch_barrier(mc_Dispatch* dispatch);
+
+bool mc_dispatch_finish(mc_Dispatch* dispatch);
+
+#endif // MC_DISPATCH_H
@@ -26,11 +26,20 @@ mc_Buffer* mc_buffer_realloc(mc_Buffer* buffer, uint64_t size) {
     mc_Buffer* new = mc_buffer_create(buffer->device, buffer->type, size);
     if (!new) return NULL;
 
+    uint64_t minSize = size < buffer->size ? size : buffer->size;
+
     if (buffer->type == MC_BUFFER_TYPE_CPU) {
-        uint64_t minSize = size < buffer->size ? size : buffer->size;
         mc_buffer_write(new, 0, minSize, buffer->map);
     } else {
-        WARN(buffer, "buffer cannot be written to, the data will be lost");
+        mc_BufferCopier* copier = mc_buffer_copier_create(buffer->device);
+        uint64_t res
+            = mc_buffer_copier_copy(copier, buffer, new, 0, 0, minSize);
+        mc_buffer_copier_destroy(copier);
+
+        if (res != minSize) {
+            mc_buffer_destroy(new);
+            return NULL;
+        }
     }
 
     mc_buffer_destroy(buffer);
@@ -50,15 +59,20 @@ mc_HBuffer* mc_hybrid_buffer_realloc(mc_HBuffer* old, uint64_t size) {
     if (!new) return NULL;
 
     uint64_t minSize = size < old->gpuBuff.size ? size : old->gpuBuff.size;
-    mc_buffer_copier_copy(
+    uint64_t res = mc_buffer_copier_copy(
         old->copier,
-        &new->gpuBuff,
         &old->gpuBuff,
+        &new->gpuBuff,
         0,
         0,
         minSize
     );
 
+    if (res != minSize) {
+        mc_hybrid_buffer_destroy(new);
+        return NULL;
+    }
+
     mc_hybrid_buffer_destroy(old);
     return new;
 }
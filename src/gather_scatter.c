@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "dispatch.h"
+#include "log.h"
+#include "microcompute_extra.h"
+#include "program.h"
+
+// the modes of the kernel, the scatter modes match `mc_ScatterOp`
+#define MC_GATHER_MODE 0
+#define MC_SCATTER_MODE 1
+
+// one invocation per unit (1, 2 or 4 words, see `WORDS`) of each element, so
+// the units of an element are handled by consecutive invocations. `WORDS` is
+// defined in front of the code. Elements with an out of range index are
+// skipped. The adds work word by word, and only with single word units
+static const char* gatherScatterSource
+    = "layout(local_size_x = 256) in;\n"
+      "#if WORDS == 4\n"
+      "#define UNIT uvec4\n"
+      "#elif WORDS == 2\n"
+      "#define UNIT uvec2\n"
+      "#else\n"
+      "#define UNIT uint\n"
+      "#endif\n"
+      "layout(std430, binding = 0) buffer srcBuff {\n"
+      "    UNIT src[];\n"
+      "};\n"
+      "layout(std430, binding = 1) buffer indexBuff {\n"
+      "    uint indices[];\n"
+      "};\n"
+      "layout(std430, binding = 2) buffer dstBuff {\n"
+      "    UNIT dst[];\n"
+      "};\n"
+      "layout(push_constant) uniform Push {\n"
+      "    uint count;\n"
+      "    uint units;\n"
+      "    uint srcStride;\n"
+      "    uint dstStride;\n"
+      "    uint limit;\n"
+      "    uint mode;\n"
+      "};\n"
+      "void main(void) {\n"
+      "    uint group = gl_WorkGroupID.y * gl_NumWorkGroups.x\n"
+      "               + gl_WorkGroupID.x;\n"
+      "    uint id = group * 256u + gl_LocalInvocationID.x;\n"
+      "    uint i = id / units;\n"
+      "    uint u = id % units;\n"
+      "    if (i >= count) return;\n"
+      "    uint j = indices[i];\n"
+      "    if (j >= limit) return;\n"
+      "    if (mode == 0u) {\n"
+      "        dst[i * dstStride + u] = src[j * srcStride + u];\n"
+      "        return;\n"
+      "    }\n"
+      "    uint d = j * dstStride + u;\n"
+      "    UNIT v = src[i * srcStride + u];\n"
+      "    if (mode == 1u) dst[d] = v;\n"
+      "#if WORDS == 1\n"
+      "    else if (mode == 2u) atomicAdd(dst[d], v);\n"
+      "    else {\n"
+      "        uint old = dst[d];\n"
+      "        for (;;) {\n"
+      "            float sum = uintBitsToFloat(old) + uintBitsToFloat(v);\n"
+      "            uint bits = floatBitsToUint(sum);\n"
+      "            uint prev = atomicCompSwap(dst[d], old, bits);\n"
+      "            if (prev == old) break;\n"
+      "            old = prev;\n"
+      "        }\n"
+      "    }\n"
+      "#endif\n"
+      "}\n";
+
+typedef struct mc_GatherScatterPush {
+    uint32_t count;
+    uint32_t units;
+    uint32_t srcStride;
+    uint32_t dstStride;
+    uint32_t limit;
+    uint32_t mode;
+} mc_GatherScatterPush;
+
+// get the variant of the kernel moving `words` words at a time, compiled on
+// first use
+static mc_Program* mc_gather_scatter_get_program(
+    mc_Device* device,
+    uint32_t words
+) {
+    char name[32];
+    snprintf(name, sizeof name, "gather_scatter_%d", words);
+
+    char header[64];
+    int headerLen = snprintf(
+        header,
+        sizeof header,
+        "#version 450\n#define WORDS %d\n",
+        words
+    );
+
+    size_t sourceLen = strlen(gatherScatterSource);
+    char* code = malloc(headerLen + sourceLen + 1);
+    memcpy(code, header, headerLen);
+    memcpy(code + headerLen, gatherScatterSource, sourceLen + 1);
+
+    mc_Program* program = mc_program_get_builtin(device, name, code);
+    free(code);
+    return program;
+}
+
+// the number of whole elements in a buffer
+static uint64_t mc_element_count(
+    mc_Buffer* buffer,
+    uint32_t elemSize,
+    uint32_t stride
+) {
+    if (buffer->size < elemSize) return 0;
+    return (buffer->size - elemSize) / stride + 1;
+}
+
+static double mc_gather_scatter_run(
+    mc_Buffer* src,
+    mc_Buffer* indices,
+    mc_Buffer* dst,
+    uint32_t count,
+    uint32_t elemSize,
+    uint32_t srcStride,
+    uint32_t dstStride,
+    uint32_t mode
+) {
+    if (!src || !indices || !dst) return -1.0;
+
+    if (srcStride == 0) srcStride = elemSize;
+    if (dstStride == 0) dstStride = elemSize;
+    if (elemSize == 0 || elemSize % 4 || srcStride % 4 || dstStride % 4) {
+        ERROR(src, "element size and strides must be multiples of 4 bytes");
+        return -1.0;
+    }
+
+    if (indices->size < sizeof(uint32_t) * (uint64_t)count) {
+        ERROR(src, "index buffer too small");
+        return -1.0;
+    }
+
+    // the indexed side is bounds checked on the device, the other side must
+    // hold `count` elements
+    bool gather = mode == MC_GATHER_MODE;
+    uint64_t srcCount = mc_element_count(src, elemSize, srcStride);
+    uint64_t dstCount = mc_element_count(dst, elemSize, dstStride);
+    uint64_t limit = gather ? srcCount : dstCount;
+    if (count > (gather ? dstCount : srcCount)) {
+        ERROR(src, "%s buffer too small", gather ? "destination" : "source");
+        return -1.0;
+    }
+
+    // 16 or 8 byte loads when the element size and strides allow it, the adds
+    // are done a word at a time
+    uint32_t words = 1;
+    uint32_t combined = elemSize | srcStride | dstStride;
+    if (mode <= MC_SCATTER_MODE && combined % 16 == 0) words = 4;
+    else if (mode <= MC_SCATTER_MODE && combined % 8 == 0) words = 2;
+
+    uint32_t unitSize = 4 * words;
+    uint64_t units = (uint64_t)count * (elemSize / unitSize);
+    // the kernel indexes the buffers in units with 32-bit integers
+    if (units > UINT32_MAX - 255 || src->size / unitSize > UINT32_MAX
+        || dst->size / unitSize > UINT32_MAX) {
+        ERROR(src, "too many elements");
+        return -1.0;
+    }
+
+    if (count == 0 || limit == 0) return 0.0;
+
+    mc_Device* device = src->device;
+    mc_Program* program = mc_gather_scatter_get_program(device, words);
+    if (!program) return -1.0;
+
+    // the units are spread over y when there are too many for x
+    uint32_t groups = (units + 255) / 256;
+    uint32_t groupsX = groups < device->maxWgCount[0]
+                         ? groups
+                         : device->maxWgCount[0];
+    uint32_t groupsY = (groups + groupsX - 1) / groupsX;
+
+    mc_GatherScatterPush push = {
+        count,
+        elemSize / unitSize,
+        srcStride / unitSize,
+        dstStride / unitSize,
+        (uint32_t)limit,
+        mode,
+    };
+
+    mc_Dispatch* dispatch = mc_dispatch_create(device);
+    bool ok = dispatch
+           && mc_dispatch_add_pushed(
+                  dispatch,
+                  program,
+                  (uint32_t[]){groupsX, groupsY, 1},
+                  3,
+                  (mc_Buffer*[]){src, indices, dst},
+                  sizeof push,
+                  &push
+           )
+           && mc_dispatch_finish(dispatch);
+
+    double time = ok ? mc_dispatch_submit(dispatch) : -1.0;
+    mc_dispatch_destroy(dispatch);
+    return time;
+}
+
+double mc_gather(
+    mc_Buffer* src,
+    mc_Buffer* indices,
+    mc_Buffer* dst,
+    uint32_t count,
+    uint32_t elemSize,
+    uint32_t srcStride,
+    uint32_t dstStride
+) {
+    if (!src) return -1.0;
+    DEBUG(src, "gathering %d elements of %d bytes", count, elemSize);
+    return mc_gather_scatter_run(
+        src,
+        indices,
+        dst,
+        count,
+        elemSize,
+        srcStride,
+        dstStride,
+        MC_GATHER_MODE
+    );
+}
+
+double mc_scatter(
+    mc_Buffer* src,
+    mc_Buffer* indices,
+    mc_Buffer* dst,
+    uint32_t count,
+    uint32_t elemSize,
+    uint32_t srcStride,
+    uint32_t dstStride,
+    mc_ScatterOp op
+) {
+    if (!src) return -1.0;
+    DEBUG(src, "scattering %d elements of %d bytes", count, elemSize);
+
+    if (op > MC_SCATTER_OP_ADD_F32) {
+        ERROR(src, "invalid scatter op");
+        return -1.0;
+    }
+
+    return mc_gather_scatter_run(
+        src,
+        indices,
+        dst,
+        count,
+        elemSize,
+        srcStride,
+        dstStride,
+        MC_SCATTER_MODE + op
+    );
+}
+
+double mc_permute(
+    mc_Buffer* src,
+    mc_Buffer* permutation,
+    mc_Buffer* dst,
+    uint32_t count,
+    uint32_t elemSize,
+    bool inverse
+) {
+    if (!src) return -1.0;
+    DEBUG(src, "permuting %d elements of %d bytes", count, elemSize);
+    return mc_gather_scatter_run(
+        src,
+        permutation,
+        dst,
+        count,
+        elemSize,
+        elemSize,
+        elemSize,
+        inverse ? MC_SCATTER_MODE : MC_GATHER_MODE
+    );
+}
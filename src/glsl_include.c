@@ -0,0 +1,199 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "glsl_include.h"
+
+// see mc_work_queue_create() for the host side
+static const char workQueueSource[]
+    = "#ifndef MC_WORK_QUEUE_GLSL\n"
+      "#define MC_WORK_QUEUE_GLSL\n"
+      "\n"
+      "#ifndef MC_WORK_QUEUE_BINDING\n"
+      "#define MC_WORK_QUEUE_BINDING 0\n"
+      "#endif\n"
+      "\n"
+      "layout(std430, binding = MC_WORK_QUEUE_BINDING) coherent volatile\n"
+      "buffer mc_WorkQueueBuff {\n"
+      "    uint mc_wqHead;\n"
+      "    uint mc_wqTail;\n"
+      "    uint mc_wqPending;\n"
+      "    uint mc_wqMask;\n"
+      "    uint mc_wqOverflow;\n"
+      "    uint mc_wqPad0;\n"
+      "    uint mc_wqPad1;\n"
+      "    uint mc_wqPad2;\n"
+      "    uint mc_wqSlots[]; // (sequence number, item) pairs\n"
+      "};\n"
+      "\n"
+      "// push an item, returns false (dropping it) if the queue is full\n"
+      "bool mc_work_queue_push(uint item) {\n"
+      "    uint tail = mc_wqTail;\n"
+      "    while (true) {\n"
+      "        if (tail - mc_wqHead > mc_wqMask) {\n"
+      "            atomicOr(mc_wqOverflow, 1u);\n"
+      "            return false;\n"
+      "        }\n"
+      "        uint prev = atomicCompSwap(mc_wqTail, tail, tail + 1u);\n"
+      "        if (prev == tail) break;\n"
+      "        tail = prev;\n"
+      "    }\n"
+      "\n"
+      "    atomicAdd(mc_wqPending, 1u);\n"
+      "    uint slot = 2u * (tail & mc_wqMask);\n"
+      "    mc_wqSlots[slot + 1u] = item;\n"
+      "    memoryBarrierBuffer();\n"
+      "    atomicExchange(mc_wqSlots[slot], tail + 1u);\n"
+      "    return true;\n"
+      "}\n"
+      "\n"
+      "// pop an item, returns false if no item is available right now\n"
+      "bool mc_work_queue_pop(out uint item) {\n"
+      "    uint head = mc_wqHead;\n"
+      "    uint slot = 2u * (head & mc_wqMask);\n"
+      "    if (mc_wqSlots[slot] != head + 1u) return false;\n"
+      "    memoryBarrierBuffer();\n"
+      "    uint value = mc_wqSlots[slot + 1u];\n"
+      "    uint prev = atomicCompSwap(mc_wqHead, head, head + 1u);\n"
+      "    if (prev != head) return false;\n"
+      "    item = value;\n"
+      "    return true;\n"
+      "}\n"
+      "\n"
+      "// mark a popped item as processed (after pushing any new items)\n"
+      "void mc_work_queue_done(void) {\n"
+      "    atomicAdd(mc_wqPending, 0xffffffffu);\n"
+      "}\n"
+      "\n"
+      "// check if all items have been processed\n"
+      "bool mc_work_queue_drained(void) {\n"
+      "    return mc_wqPending == 0u;\n"
+      "}\n"
+      "\n"
+      "#endif // MC_WORK_QUEUE_GLSL\n";
+
+// see mc_wg_profiler_create() for the host side. the extensions have to be
+// enabled before any code, so this has to be included right after `#version`
+static const char profileSource[]
+    = "#ifndef MC_PROFILE_GLSL\n"
+      "#define MC_PROFILE_GLSL\n"
+      "\n"
+      "#ifdef MC_PROFILE\n"
+      "\n"
+      "#ifdef MC_PROFILE_DEVICE_CLOCK\n"
+      "#extension GL_EXT_shader_realtime_clock : require\n"
+      "#define mc_profile_clock() clockRealtime2x32EXT()\n"
+      "#else\n"
+      "#extension GL_ARB_shader_clock : require\n"
+      "#define mc_profile_clock() clock2x32ARB()\n"
+      "#endif\n"
+      "\n"
+      "layout(std430, binding = MC_PROFILE_BINDING) buffer mc_ProfileBuff {\n"
+      "    uvec4 mc_profileTimes[]; // (start, end) per workgroup\n"
+      "};\n"
+      "\n"
+      "uint mc_profile_index(void) {\n"
+      "    uvec3 id = gl_WorkGroupID;\n"
+      "    uvec3 count = gl_NumWorkGroups;\n"
+      "    return id.x + count.x * (id.y + count.y * id.z);\n"
+      "}\n"
+      "\n"
+      "// call at the start of main()\n"
+      "#define MC_PROFILE_BEGIN()                                        \\\n"
+      "    if (gl_LocalInvocationIndex == 0u)                            \\\n"
+      "        mc_profileTimes[mc_profile_index()].xy = mc_profile_clock()\n"
+      "\n"
+      "// call at the end of main(), in uniform control flow\n"
+      "#define MC_PROFILE_END()                                          \\\n"
+      "    barrier();                                                    \\\n"
+      "    if (gl_LocalInvocationIndex == 0u)                            \\\n"
+      "        mc_profileTimes[mc_profile_index()].zw = mc_profile_clock()\n"
+      "\n"
+      "#else\n"
+      "\n"
+      "#define MC_PROFILE_BEGIN()\n"
+      "#define MC_PROFILE_END()\n"
+      "\n"
+      "#endif\n"
+      "\n"
+      "#endif // MC_PROFILE_GLSL\n";
+
+// see mc_program_prepare_swizzled() for the host side. gl_WorkGroupSize is
+// used, so this has to be included after the `local_size` layout
+static const char swizzleSource[]
+    = "#ifndef MC_SWIZZLE_GLSL\n"
+      "#define MC_SWIZZLE_GLSL\n"
+      "\n"
+      "#ifdef MC_SWIZZLE\n"
+      "\n"
+      "layout(push_constant) uniform mc_SwizzlePush {\n"
+      "    uint mc_swizzleOrder; // see mc_LaunchOrder\n"
+      "    uint mc_swizzleGroup;\n"
+      "};\n"
+      "\n"
+      "// keep the even bits of v, packed\n"
+      "uint mc_swizzle_compact(uint v) {\n"
+      "    v &= 0x55555555u;\n"
+      "    v = (v | (v >> 1u)) & 0x33333333u;\n"
+      "    v = (v | (v >> 2u)) & 0x0f0f0f0fu;\n"
+      "    v = (v | (v >> 4u)) & 0x00ff00ffu;\n"
+      "    v = (v | (v >> 8u)) & 0x0000ffffu;\n"
+      "    return v;\n"
+      "}\n"
+      "\n"
+      "// workgroups are launched in raster order, so the linear id is\n"
+      "// remapped to bands of `group` rows, walked column by column (grouped\n"
+      "// rows) or as `group` x `group` tiles along a Z-order curve (morton).\n"
+      "// partial bands and tiles at the edges fall back to a simpler order\n"
+      "uvec2 mc_workgroup_id(void) {\n"
+      "    uvec2 size = gl_NumWorkGroups.xy;\n"
+      "    uint group = mc_swizzleGroup;\n"
+      "    if (mc_swizzleOrder == 0u || group < 2u)\n"
+      "        return gl_WorkGroupID.xy;\n"
+      "\n"
+      "    uint linear = gl_WorkGroupID.x + size.x * gl_WorkGroupID.y;\n"
+      "    uint firstRow = linear / (group * size.x) * group;\n"
+      "    uint rows = min(group, size.y - firstRow);\n"
+      "    uint idx = linear - firstRow * size.x;\n"
+      "\n"
+      "    if (mc_swizzleOrder == 2u && rows == group) {\n"
+      "        uint tile = idx / (group * group);\n"
+      "        uint m = idx - tile * group * group;\n"
+      "        uint firstCol = tile * group;\n"
+      "        uint cols = min(group, size.x - firstCol);\n"
+      "        if (cols < group)\n"
+      "            return uvec2(firstCol + m % cols, firstRow + m / cols);\n"
+      "        return uvec2(\n"
+      "            firstCol + mc_swizzle_compact(m),\n"
+      "            firstRow + mc_swizzle_compact(m >> 1u)\n"
+      "        );\n"
+      "    }\n"
+      "\n"
+      "    return uvec2(idx / rows, firstRow + idx % rows);\n"
+      "}\n"
+      "\n"
+      "#else\n"
+      "\n"
+      "uvec2 mc_workgroup_id(void) {\n"
+      "    return gl_WorkGroupID.xy;\n"
+      "}\n"
+      "\n"
+      "#endif\n"
+      "\n"
+      "uvec2 mc_global_invocation_id(void) {\n"
+      "    return mc_workgroup_id() * gl_WorkGroupSize.xy\n"
+      "         + gl_LocalInvocationID.xy;\n"
+      "}\n"
+      "\n"
+      "#endif // MC_SWIZZLE_GLSL\n";
+
+static const mc_GlslInclude includes[] = {
+    {"microcompute/work_queue.glsl", workQueueSource},
+    {"microcompute/profile.glsl", profileSource},
+    {"microcompute/swizzle.glsl", swizzleSource},
+};
+
+const mc_GlslInclude* mc_glsl_include_find(const char* name) {
+    for (size_t i = 0; i < sizeof includes / sizeof *includes; i++)
+        if (strcmp(includes[i].name, name) == 0) return &includes[i];
+    return NULL;
+}
@@ -0,0 +1,12 @@
+#ifndef MC_GLSL_INCLUDE_H
+#define MC_GLSL_INCLUDE_H
+
+// a GLSL file that programs can include with `#include <name>`
+typedef struct mc_GlslInclude {
+    const char* name;
+    const char* source;
+} mc_GlslInclude;
+
+const mc_GlslInclude* mc_glsl_include_find(const char* name);
+
+#endif // MC_GLSL_INCLUDE_H
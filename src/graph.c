@@ -0,0 +1,721 @@
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "dispatch.h"
+#include "graph.h"
+#include "hybrid_buffer.h"
+#include "log.h"
+#include "program.h"
+
+// the number of traversal steps recorded in the command buffer of a traversal,
+// the host only checks if the traversal is done between submissions
+#define MC_GRAPH_STEPS_PER_SUBMIT 32
+
+// direction-optimizing BFS switches to pulling when the frontier has more than
+// 1/ALPHA of the unexplored edges, and back to pushing when it has less than
+// 1/BETA of the vertices (Beamer et al.)
+#define MC_GRAPH_BFS_ALPHA "14.0"
+#define MC_GRAPH_BFS_BETA "24.0"
+
+// the unreachable depth/distance (UINT32_MAX and the bits of +inf)
+#define MC_GRAPH_NO_DEPTH 0xffffffffu
+#define MC_GRAPH_NO_DIST 0x7f800000u
+
+// the state of a traversal, shared by the host and the device. the first two
+// fields are the indirect dispatch arguments of the two step kernels
+typedef struct mc_BfsControl {
+    uint32_t pushArgs[4];
+    uint32_t pullArgs[4];
+    uint32_t level;
+    uint32_t done;
+    uint32_t sel;
+    uint32_t frontierSize;
+    uint32_t nextSize;
+    uint32_t frontierEdges;
+    uint32_t nextEdges;
+    uint32_t unexploredEdges;
+    uint32_t pulling;
+    uint32_t vertexCount;
+    uint32_t maxGroups;
+} mc_BfsControl;
+
+typedef struct mc_SsspControl {
+    uint32_t relaxArgs[4];
+    uint32_t splitArgs[4];
+    uint32_t done;
+    uint32_t splitting;
+    uint32_t iteration;
+    uint32_t epoch;
+    uint32_t nearSel;
+    uint32_t nearSize;
+    uint32_t nextNear;
+    uint32_t farSel;
+    uint32_t farSize;
+    uint32_t nextFar;
+    uint32_t minFar;
+    float threshold;
+    float prevThreshold;
+    float delta;
+    uint32_t vertexCount;
+    uint32_t maxGroups;
+} mc_SsspControl;
+
+// ==== BFS ================================================================= //
+
+#define MC_GRAPH_BFS_HEADER                                                    \
+    "#version 450\n"                                                           \
+    "layout(std430, binding = 0) buffer ctrlBuff {\n"                          \
+    "    uvec4 pushArgs;\n"                                                    \
+    "    uvec4 pullArgs;\n"                                                    \
+    "    uint level;\n"                                                        \
+    "    uint done;\n"                                                         \
+    "    uint sel;\n"                                                          \
+    "    uint frontierSize;\n"                                                 \
+    "    uint nextSize;\n"                                                     \
+    "    uint frontierEdges;\n"                                                \
+    "    uint nextEdges;\n"                                                    \
+    "    uint unexploredEdges;\n"                                              \
+    "    uint pulling;\n"                                                      \
+    "    uint vertexCount;\n"                                                  \
+    "    uint maxGroups;\n"                                                    \
+    "};\n"                                                                     \
+    "layout(std430, binding = 1) readonly buffer outOffsetBuff {\n"            \
+    "    uint outOffsets[];\n"                                                 \
+    "};\n"                                                                     \
+    "layout(std430, binding = 2) readonly buffer outEdgeBuff {\n"              \
+    "    uint outEdges[];\n"                                                   \
+    "};\n"                                                                     \
+    "layout(std430, binding = 3) readonly buffer inOffsetBuff {\n"             \
+    "    uint inOffsets[];\n"                                                  \
+    "};\n"                                                                     \
+    "layout(std430, binding = 4) readonly buffer inEdgeBuff {\n"               \
+    "    uint inEdges[];\n"                                                    \
+    "};\n"                                                                     \
+    "layout(std430, binding = 5) buffer depthBuff {\n"                         \
+    "    uint depths[];\n"                                                     \
+    "};\n"                                                                     \
+    "layout(std430, binding = 6) buffer frontierBuff {\n"                      \
+    "    uint frontier[];\n"                                                   \
+    "};\n"                                                                     \
+    "void visit(uint v) {\n"                                                   \
+    "    frontier[(sel ^ 1u) * vertexCount + atomicAdd(nextSize, 1u)] = v;\n"  \
+    "    atomicAdd(nextEdges, outOffsets[v + 1] - outOffsets[v]);\n"           \
+    "}\n"
+
+// expands the frontier along the out edges of its vertices
+static const char* bfsPushSource
+    = MC_GRAPH_BFS_HEADER
+    "layout(local_size_x = 64) in;\n"
+    "void main(void) {\n"
+    "    uint stride = gl_NumWorkGroups.x * gl_WorkGroupSize.x;\n"
+    "    for (uint i = gl_GlobalInvocationID.x; i < frontierSize;\n"
+    "         i += stride) {\n"
+    "        uint u = frontier[sel * vertexCount + i];\n"
+    "        for (uint e = outOffsets[u]; e < outOffsets[u + 1]; e++) {\n"
+    "            uint v = outEdges[e];\n"
+    "            if (depths[v] != 0xffffffffu) continue;\n"
+    "            uint depth = level + 1;\n"
+    "            uint old = atomicCompSwap(depths[v], 0xffffffffu, depth);\n"
+    "            if (old == 0xffffffffu) visit(v);\n"
+    "        }\n"
+    "    }\n"
+    "}\n";
+
+// lets every unvisited vertex look for a parent in the frontier
+static const char* bfsPullSource
+    = MC_GRAPH_BFS_HEADER
+    "layout(local_size_x = 64) in;\n"
+    "void main(void) {\n"
+    "    uint stride = gl_NumWorkGroups.x * gl_WorkGroupSize.x;\n"
+    "    for (uint v = gl_GlobalInvocationID.x; v < vertexCount;\n"
+    "         v += stride) {\n"
+    "        if (depths[v] != 0xffffffffu) continue;\n"
+    "        for (uint e = inOffsets[v]; e < inOffsets[v + 1]; e++) {\n"
+    "            if (depths[inEdges[e]] != level) continue;\n"
+    "            depths[v] = level + 1;\n"
+    "            visit(v);\n"
+    "            break;\n"
+    "        }\n"
+    "    }\n"
+    "}\n";
+
+// moves to the next level, picks the direction and sizes the next dispatch
+static const char* bfsControlSource
+    = MC_GRAPH_BFS_HEADER
+    "layout(local_size_x = 1) in;\n"
+    "void main(void) {\n"
+    "    if (done != 0) return;\n"
+    "    frontierSize = nextSize;\n"
+    "    frontierEdges = nextEdges;\n"
+    "    nextSize = 0;\n"
+    "    nextEdges = 0;\n"
+    "    unexploredEdges -= min(unexploredEdges, frontierEdges);\n"
+    "    sel ^= 1u;\n"
+    "    level += 1;\n"
+    "    if (frontierSize == 0) {\n"
+    "        done = 1;\n"
+    "        pushArgs.x = 0;\n"
+    "        pullArgs.x = 0;\n"
+    "        return;\n"
+    "    }\n"
+    "    if (pulling == 0 && float(frontierEdges) * " MC_GRAPH_BFS_ALPHA "\n"
+    "        > float(unexploredEdges)) pulling = 1;\n"
+    "    else if (pulling != 0 && float(frontierSize) * " MC_GRAPH_BFS_BETA "\n"
+    "        < float(vertexCount)) pulling = 0;\n"
+    "    uint work = pulling != 0 ? vertexCount : frontierSize;\n"
+    "    uint groups = min((work + 63) / 64, maxGroups);\n"
+    "    pushArgs.x = pulling != 0 ? 0 : groups;\n"
+    "    pullArgs.x = pulling != 0 ? groups : 0;\n"
+    "}\n";
+
+// ==== SSSP ================================================================ //
+
+// near-far delta-stepping: vertices closer than the current threshold go to the
+// near frontier and are relaxed right away, the others go to the far pile,
+// which is split once the near frontier is empty
+#define MC_GRAPH_SSSP_HEADER                                                   \
+    "#version 450\n"                                                           \
+    "layout(std430, binding = 0) buffer ctrlBuff {\n"                          \
+    "    uvec4 relaxArgs;\n"                                                   \
+    "    uvec4 splitArgs;\n"                                                   \
+    "    uint done;\n"                                                         \
+    "    uint splitting;\n"                                                    \
+    "    uint iteration;\n"                                                    \
+    "    uint epoch;\n"                                                        \
+    "    uint nearSel;\n"                                                      \
+    "    uint nearSize;\n"                                                     \
+    "    uint nextNear;\n"                                                     \
+    "    uint farSel;\n"                                                       \
+    "    uint farSize;\n"                                                      \
+    "    uint nextFar;\n"                                                      \
+    "    uint minFar;\n"                                                       \
+    "    float threshold;\n"                                                   \
+    "    float prevThreshold;\n"                                               \
+    "    float delta;\n"                                                       \
+    "    uint vertexCount;\n"                                                  \
+    "    uint maxGroups;\n"                                                    \
+    "};\n"                                                                     \
+    "layout(std430, binding = 1) readonly buffer outOffsetBuff {\n"            \
+    "    uint outOffsets[];\n"                                                 \
+    "};\n"                                                                     \
+    "layout(std430, binding = 2) readonly buffer outEdgeBuff {\n"              \
+    "    uint outEdges[];\n"                                                   \
+    "};\n"                                                                     \
+    "layout(std430, binding = 3) readonly buffer weightBuff {\n"               \
+    "    float weights[];\n"                                                   \
+    "};\n"                                                                     \
+    "layout(std430, binding = 4) buffer distBuff {\n"                          \
+    "    uint dists[];\n"                                                      \
+    "};\n"                                                                     \
+    "layout(std430, binding = 5) buffer nearBuff {\n"                          \
+    "    uint nearQueue[];\n"                                                  \
+    "};\n"                                                                     \
+    "layout(std430, binding = 6) buffer farBuff {\n"                           \
+    "    uint farQueue[];\n"                                                   \
+    "};\n"                                                                     \
+    "layout(std430, binding = 7) buffer nearStampBuff {\n"                     \
+    "    uint nearStamps[];\n"                                                 \
+    "};\n"                                                                     \
+    "layout(std430, binding = 8) buffer farStampBuff {\n"                      \
+    "    uint farStamps[];\n"                                                  \
+    "};\n"                                                                     \
+    "void push_near(uint v) {\n"                                               \
+    "    if (atomicExchange(nearStamps[v], iteration) == iteration) return;\n" \
+    "    uint idx = (nearSel ^ 1u) * vertexCount + atomicAdd(nextNear, 1u);\n" \
+    "    nearQueue[idx] = v;\n"                                                \
+    "}\n"
+
+// relaxes the out edges of the near frontier (distances are non-negative
+// floats, so they can be compared as uints)
+static const char* ssspRelaxSource
+    = MC_GRAPH_SSSP_HEADER
+    "layout(local_size_x = 64) in;\n"
+    "void main(void) {\n"
+    "    uint stride = gl_NumWorkGroups.x * gl_WorkGroupSize.x;\n"
+    "    for (uint i = gl_GlobalInvocationID.x; i < nearSize; i += stride) {\n"
+    "        uint u = nearQueue[nearSel * vertexCount + i];\n"
+    "        float du = uintBitsToFloat(dists[u]);\n"
+    "        for (uint e = outOffsets[u]; e < outOffsets[u + 1]; e++) {\n"
+    "            uint v = outEdges[e];\n"
+    "            uint d = floatBitsToUint(du + weights[e]);\n"
+    "            if (d >= dists[v] || atomicMin(dists[v], d) <= d) continue;\n"
+    "            if (uintBitsToFloat(d) < threshold) {\n"
+    "                push_near(v);\n"
+    "                continue;\n"
+    "            }\n"
+    "            atomicMin(minFar, d);\n"
+    "            if (atomicExchange(farStamps[v], epoch) == epoch) continue;\n"
+    "            farQueue[farSel * vertexCount + atomicAdd(farSize, 1u)] = v;\n"
+    "        }\n"
+    "    }\n"
+    "}\n";
+
+// moves the far vertices under the new threshold to the near frontier, and
+// drops the ones that were settled since they were added
+static const char* ssspSplitSource
+    = MC_GRAPH_SSSP_HEADER
+    "layout(local_size_x = 64) in;\n"
+    "void main(void) {\n"
+    "    uint stride = gl_NumWorkGroups.x * gl_WorkGroupSize.x;\n"
+    "    for (uint i = gl_GlobalInvocationID.x; i < farSize; i += stride) {\n"
+    "        uint v = farQueue[farSel * vertexCount + i];\n"
+    "        float d = uintBitsToFloat(dists[v]);\n"
+    "        if (d < prevThreshold) continue;\n"
+    "        if (d < threshold) {\n"
+    "            push_near(v);\n"
+    "            continue;\n"
+    "        }\n"
+    "        atomicMin(minFar, dists[v]);\n"
+    "        if (atomicExchange(farStamps[v], epoch) == epoch) continue;\n"
+    "        uint idx = (farSel ^ 1u) * vertexCount + atomicAdd(nextFar, 1u);\n"
+    "        farQueue[idx] = v;\n"
+    "    }\n"
+    "}\n";
+
+// relaxes the near frontier while it is not empty, otherwise raises the
+// threshold past the closest far vertex and splits the far pile
+static const char* ssspControlSource
+    = MC_GRAPH_SSSP_HEADER
+    "layout(local_size_x = 1) in;\n"
+    "void main(void) {\n"
+    "    if (done != 0) return;\n"
+    "    if (splitting != 0) {\n"
+    "        farSel ^= 1u;\n"
+    "        farSize = nextFar;\n"
+    "        nextFar = 0;\n"
+    "    }\n"
+    "    nearSel ^= 1u;\n"
+    "    nearSize = nextNear;\n"
+    "    nextNear = 0;\n"
+    "    iteration += 1;\n"
+    "    splitting = 0;\n"
+    "    relaxArgs.x = 0;\n"
+    "    splitArgs.x = 0;\n"
+    "    if (nearSize != 0) {\n"
+    "        relaxArgs.x = min((nearSize + 63) / 64, maxGroups);\n"
+    "    } else if (farSize != 0) {\n"
+    "        float closest = uintBitsToFloat(minFar);\n"
+    "        float next = (floor(closest / delta) + 1.0) * delta;\n"
+    "        prevThreshold = threshold;\n"
+    "        threshold = max(threshold + delta, next);\n"
+    "        minFar = 0x7f800000u;\n"
+    "        epoch += 1;\n"
+    "        splitting = 1;\n"
+    "        splitArgs.x = min((farSize + 63) / 64, maxGroups);\n"
+    "    } else {\n"
+    "        done = 1;\n"
+    "    }\n"
+    "}\n";
+
+// ==== traversal =========================================================== //
+
+// records `MC_GRAPH_STEPS_PER_SUBMIT` steps, each running the two step kernels
+// (one of them usually with no workgroups) and then the control kernel
+static mc_Dispatch* mc_graph_record(
+    mc_Graph* graph,
+    mc_Program** programs,
+    uint32_t buffCount,
+    mc_Buffer** buffs
+) {
+    mc_Dispatch* dispatch = mc_dispatch_create(graph->device);
+    if (!dispatch) return NULL;
+
+    mc_Pipeline* pipelines[3];
+    VkDescriptorSet descSets[3];
+    for (uint32_t i = 0; i < 3; i++) {
+        pipelines[i] = programs[i]
+                         ? mc_program_get_pipeline(programs[i], buffCount)
+                         : NULL;
+        if (!pipelines[i]) {
+            mc_dispatch_destroy(dispatch);
+            return NULL;
+        }
+        descSets[i]
+            = mc_dispatch_create_set(dispatch, pipelines[i], buffCount, buffs);
+    }
+
+    VkBuffer ctrl = graph->ctrl->gpuBuff.buf;
+    for (uint32_t i = 0; i < MC_GRAPH_STEPS_PER_SUBMIT; i++) {
+        if (dispatch->failed) break;
+        mc_dispatch_bind(dispatch, pipelines[0], descSets[0]);
+        vkCmdDispatchIndirect(dispatch->cmdBuff, ctrl, 0);
+        mc_dispatch_bind(dispatch, pipelines[1], descSets[1]);
+        vkCmdDispatchIndirect(dispatch->cmdBuff, ctrl, 4 * sizeof(uint32_t));
+        mc_dispatch_barrier(dispatch);
+        mc_dispatch_bind(dispatch, pipelines[2], descSets[2]);
+        vkCmdDispatch(dispatch->cmdBuff, 1, 1, 1);
+        mc_dispatch_barrier(dispatch);
+    }
+
+    if (!mc_dispatch_finish(dispatch)) {
+        mc_dispatch_destroy(dispatch);
+        return NULL;
+    }
+
+    return dispatch;
+}
+
+// resets the values of all vertices and seeds the frontier with the source
+static mc_Dispatch* mc_graph_record_init(
+    mc_Graph* graph,
+    uint32_t source,
+    uint32_t noValue,
+    bool stamps
+) {
+    mc_Dispatch* dispatch = mc_dispatch_create(graph->device);
+    if (!dispatch) return NULL;
+
+    VkCommandBuffer cmdBuff = dispatch->cmdBuff;
+    uint64_t size = sizeof(uint32_t) * graph->vertexCount;
+    uint32_t zero = 0;
+
+    vkCmdFillBuffer(cmdBuff, graph->values->gpuBuff.buf, 0, size, noValue);
+    if (stamps) {
+        vkCmdFillBuffer(cmdBuff, graph->nearStamps->buf, 0, size, 0);
+        vkCmdFillBuffer(cmdBuff, graph->farStamps->buf, 0, size, 0);
+    }
+    mc_dispatch_barrier(dispatch);
+
+    vkCmdUpdateBuffer(
+        cmdBuff,
+        graph->values->gpuBuff.buf,
+        sizeof(uint32_t) * source,
+        sizeof zero,
+        &zero
+    );
+    vkCmdUpdateBuffer(cmdBuff, graph->near->buf, 0, sizeof source, &source);
+
+    if (!mc_dispatch_finish(dispatch)) {
+        mc_dispatch_destroy(dispatch);
+        return NULL;
+    }
+
+    return dispatch;
+}
+
+// submits the traversal until its control reports it is done
+static double mc_graph_run(
+    mc_Graph* graph,
+    mc_Dispatch* init,
+    mc_Dispatch* traversal,
+    uint64_t doneOffset
+) {
+    double time = mc_dispatch_submit(init);
+    mc_dispatch_destroy(init);
+    if (time < 0.0) return -1.0;
+
+    while (true) {
+        double stepTime = mc_dispatch_submit(traversal);
+        if (stepTime < 0.0) return -1.0;
+        time += stepTime;
+
+        uint32_t done = 0;
+        uint64_t size = sizeof done;
+        if (mc_hybrid_buffer_read(graph->ctrl, doneOffset, size, &done) != size)
+            return -1.0;
+        if (done) return time;
+    }
+}
+
+static mc_HBuffer* mc_graph_upload(
+    mc_Device* device,
+    uint64_t size,
+    const void* data
+) {
+    // empty buffers are not allowed
+    if (size == 0) return mc_hybrid_buffer_create(device, sizeof(uint32_t));
+    return mc_hybrid_buffer_create_from(device, size, (void*)data);
+}
+
+mc_Graph* mc_graph_create(
+    mc_Device* device,
+    uint32_t vertexCount,
+    uint32_t edgeCount,
+    const uint32_t* offsets,
+    const uint32_t* edges,
+    const float* weights
+) {
+    if (!device) return NULL;
+
+    mc_Graph* graph = malloc(sizeof *graph);
+    *graph = (mc_Graph){
+        ._instance = device->_instance,
+        .device = device,
+        .vertexCount = vertexCount,
+        .edgeCount = edgeCount,
+        .maxGroups = device->maxWgCount[0],
+        .outOffsets = NULL,
+        .outEdges = NULL,
+        .inOffsets = NULL,
+        .inEdges = NULL,
+        .weights = NULL,
+        .values = NULL,
+        .ctrl = NULL,
+        .near = NULL,
+        .far = NULL,
+        .nearStamps = NULL,
+        .farStamps = NULL,
+        .bfs = NULL,
+        .sssp = NULL,
+    };
+
+    DEBUG(
+        graph,
+        "creating graph, vertices: %d, edges: %d",
+        vertexCount,
+        edgeCount
+    );
+
+    if (vertexCount == 0 || !offsets || (edgeCount && !edges)) {
+        ERROR(graph, "invalid graph");
+        mc_graph_destroy(graph);
+        return NULL;
+    }
+
+    bool valid = offsets[0] == 0 && offsets[vertexCount] == edgeCount;
+    for (uint32_t i = 0; i < vertexCount && valid; i++)
+        valid = offsets[i] <= offsets[i + 1];
+    for (uint32_t i = 0; i < edgeCount && valid; i++)
+        valid = edges[i] < vertexCount
+             && (!weights || (weights[i] >= 0.0f && isfinite(weights[i])));
+
+    if (!valid) {
+        ERROR(graph, "invalid offsets, edges or weights");
+        mc_graph_destroy(graph);
+        return NULL;
+    }
+
+    // transpose the graph, so that pulling can go through the in edges
+    uint32_t* inOffsets = calloc(vertexCount + 1, sizeof *inOffsets);
+    uint32_t* inEdges = malloc(sizeof *inEdges * (edgeCount + 1));
+    for (uint32_t i = 0; i < edgeCount; i++) inOffsets[edges[i] + 1]++;
+    for (uint32_t i = 0; i < vertexCount; i++) inOffsets[i + 1] += inOffsets[i];
+
+    uint32_t* next = malloc(sizeof *next * vertexCount);
+    memcpy(next, inOffsets, sizeof *next * vertexCount);
+    for (uint32_t u = 0; u < vertexCount; u++)
+        for (uint32_t e = offsets[u]; e < offsets[u + 1]; e++)
+            inEdges[next[edges[e]]++] = u;
+    free(next);
+
+    uint64_t offsetsSize = sizeof *offsets * ((uint64_t)vertexCount + 1);
+    uint64_t edgesSize = sizeof *edges * (uint64_t)edgeCount;
+    uint64_t vertsSize = sizeof(uint32_t) * (uint64_t)vertexCount;
+
+    graph->outOffsets = mc_graph_upload(device, offsetsSize, offsets);
+    graph->outEdges = mc_graph_upload(device, edgesSize, edges);
+    graph->inOffsets = mc_graph_upload(device, offsetsSize, inOffsets);
+    graph->inEdges = mc_graph_upload(device, edgesSize, inEdges);
+    if (weights) graph->weights = mc_graph_upload(device, edgesSize, weights);
+    free(inOffsets);
+    free(inEdges);
+
+    graph->values = mc_hybrid_buffer_create(device, vertsSize);
+    graph->ctrl = mc_hybrid_buffer_create(device, sizeof(mc_SsspControl));
+    graph->near = mc_buffer_create(device, MC_BUFFER_TYPE_GPU, 2 * vertsSize);
+
+    if (!graph->outOffsets || !graph->outEdges || !graph->inOffsets
+        || !graph->inEdges || (weights && !graph->weights) || !graph->values
+        || !graph->ctrl || !graph->near) {
+        mc_graph_destroy(graph);
+        return NULL;
+    }
+
+    return graph;
+}
+
+void mc_graph_destroy(mc_Graph* graph) {
+    if (!graph) return;
+    DEBUG(graph, "destroying graph");
+
+    mc_dispatch_destroy(graph->bfs);
+    mc_dispatch_destroy(graph->sssp);
+    mc_buffer_destroy(graph->farStamps);
+    mc_buffer_destroy(graph->nearStamps);
+    mc_buffer_destroy(graph->far);
+    mc_buffer_destroy(graph->near);
+    mc_hybrid_buffer_destroy(graph->ctrl);
+    mc_hybrid_buffer_destroy(graph->values);
+    mc_hybrid_buffer_destroy(graph->weights);
+    mc_hybrid_buffer_destroy(graph->inEdges);
+    mc_hybrid_buffer_destroy(graph->inOffsets);
+    mc_hybrid_buffer_destroy(graph->outEdges);
+    mc_hybrid_buffer_destroy(graph->outOffsets);
+    free(graph);
+}
+
+double mc_graph_bfs(mc_Graph* graph, uint32_t source, uint32_t* depths) {
+    if (!graph) return -1.0;
+    DEBUG(graph, "running BFS from vertex %d", source);
+
+    if (source >= graph->vertexCount) {
+        ERROR(graph, "source vertex out of range");
+        return -1.0;
+    }
+
+    if (!graph->bfs) {
+        mc_Device* device = graph->device;
+        mc_Program* programs[3] = {
+            mc_program_get_builtin(device, "graph_bfs_push", bfsPushSource),
+            mc_program_get_builtin(device, "graph_bfs_pull", bfsPullSource),
+            mc_program_get_builtin(device, "graph_bfs_ctrl", bfsControlSource),
+        };
+        mc_Buffer* buffs[7] = {
+            &graph->ctrl->gpuBuff,
+            &graph->outOffsets->gpuBuff,
+            &graph->outEdges->gpuBuff,
+            &graph->inOffsets->gpuBuff,
+            &graph->inEdges->gpuBuff,
+            &graph->values->gpuBuff,
+            graph->near,
+        };
+        graph->bfs = mc_graph_record(graph, programs, 7, buffs);
+        if (!graph->bfs) return -1.0;
+    }
+
+    mc_BfsControl ctrl = {
+        .pushArgs = {1, 1, 1, 0},
+        .pullArgs = {0, 1, 1, 0},
+        .level = 0,
+        .done = 0,
+        .sel = 0,
+        .frontierSize = 1,
+        .nextSize = 0,
+        .frontierEdges = 0,
+        .nextEdges = 0,
+        .unexploredEdges = graph->edgeCount,
+        .pulling = 0,
+        .vertexCount = graph->vertexCount,
+        .maxGroups = graph->maxGroups,
+    };
+    if (mc_hybrid_buffer_write(graph->ctrl, 0, sizeof ctrl, &ctrl)
+        != sizeof ctrl)
+        return -1.0;
+
+    mc_Dispatch* init
+        = mc_graph_record_init(graph, source, MC_GRAPH_NO_DEPTH, false);
+    if (!init) return -1.0;
+
+    double time = mc_graph_run(
+        graph,
+        init,
+        graph->bfs,
+        offsetof(mc_BfsControl, done)
+    );
+
+    uint64_t size = sizeof *depths * graph->vertexCount;
+    if (time >= 0.0 && depths
+        && mc_hybrid_buffer_read(graph->values, 0, size, depths) != size)
+        return -1.0;
+    return time;
+}
+
+double mc_graph_sssp(
+    mc_Graph* graph,
+    uint32_t source,
+    float delta,
+    float* distances
+) {
+    if (!graph) return -1.0;
+    DEBUG(graph, "running SSSP from vertex %d", source);
+
+    if (source >= graph->vertexCount) {
+        ERROR(graph, "source vertex out of range");
+        return -1.0;
+    }
+
+    if (!graph->weights) {
+        ERROR(graph, "graph has no weights");
+        return -1.0;
+    }
+
+    if (!(delta > 0.0f) || !isfinite(delta)) {
+        ERROR(graph, "delta must be positive");
+        return -1.0;
+    }
+
+    if (!graph->sssp) {
+        mc_Device* device = graph->device;
+        // only the missing buffers are created, in case an earlier call
+        // failed part way
+        uint64_t size = sizeof(uint32_t) * graph->vertexCount;
+        if (!graph->far)
+            graph->far = mc_buffer_create(device, MC_BUFFER_TYPE_GPU, 2 * size);
+        if (!graph->nearStamps)
+            graph->nearStamps
+                = mc_buffer_create(device, MC_BUFFER_TYPE_GPU, size);
+        if (!graph->farStamps)
+            graph->farStamps
+                = mc_buffer_create(device, MC_BUFFER_TYPE_GPU, size);
+        if (!graph->far || !graph->nearStamps || !graph->farStamps)
+            return -1.0;
+
+        mc_Program* programs[3] = {
+            mc_program_get_builtin(device, "graph_sssp_relax", ssspRelaxSource),
+            mc_program_get_builtin(device, "graph_sssp_split", ssspSplitSource),
+            mc_program_get_builtin(
+                device,
+                "graph_sssp_ctrl",
+                ssspControlSource
+            ),
+        };
+        mc_Buffer* buffs[9] = {
+            &graph->ctrl->gpuBuff,
+            &graph->outOffsets->gpuBuff,
+            &graph->outEdges->gpuBuff,
+            &graph->weights->gpuBuff,
+            &graph->values->gpuBuff,
+            graph->near,
+            graph->far,
+            graph->nearStamps,
+            graph->farStamps,
+        };
+        graph->sssp = mc_graph_record(graph, programs, 9, buffs);
+        if (!graph->sssp) return -1.0;
+    }
+
+    mc_SsspControl ctrl = {
+        .relaxArgs = {1, 1, 1, 0},
+        .splitArgs = {0, 1, 1, 0},
+        .done = 0,
+        .splitting = 0,
+        .iteration = 1,
+        .epoch = 1,
+        .nearSel = 0,
+        .nearSize = 1,
+        .nextNear = 0,
+        .farSel = 0,
+        .farSize = 0,
+        .nextFar = 0,
+        .minFar = MC_GRAPH_NO_DIST,
+        .threshold = delta,
+        .prevThreshold = 0.0f,
+        .delta = delta,
+        .vertexCount = graph->vertexCount,
+        .maxGroups = graph->maxGroups,
+    };
+    if (mc_hybrid_buffer_write(graph->ctrl, 0, sizeof ctrl, &ctrl)
+        != sizeof ctrl)
+        return -1.0;
+
+    mc_Dispatch* init
+        = mc_graph_record_init(graph, source, MC_GRAPH_NO_DIST, true);
+    if (!init) return -1.0;
+
+    double time = mc_graph_run(
+        graph,
+        init,
+        graph->sssp,
+        offsetof(mc_SsspControl, done)
+    );
+
+    uint64_t size = sizeof *distances * graph->vertexCount;
+    if (time >= 0.0 && distances
+        && mc_hybrid_buffer_read(graph->values, 0, size, distances) != size)
+        return -1.0;
+    return time;
+}
@@ -0,0 +1,28 @@
+#ifndef MC_GRAPH_H
+#define MC_GRAPH_H
+
+#include "microcompute.h"
+#include "microcompute_extra.h"
+
+struct mc_Graph {
+    mc_Instance* _instance;
+    mc_Device* device;
+    uint32_t vertexCount;
+    uint32_t edgeCount;
+    uint32_t maxGroups;
+    mc_HBuffer* outOffsets;
+    mc_HBuffer* outEdges;
+    mc_HBuffer* inOffsets; // the transposed graph, for pulling
+    mc_HBuffer* inEdges;
+    mc_HBuffer* weights; // `NULL` for unweighted graphs
+    mc_HBuffer* values;  // the depths or distances of the last traversal
+    mc_HBuffer* ctrl;
+    mc_Buffer* near; // frontier, two halves of `vertexCount` vertices
+    mc_Buffer* far;  // far pile of delta-stepping, same layout as `near`
+    mc_Buffer* nearStamps;
+    mc_Buffer* farStamps;
+    mc_Dispatch* bfs; // recorded on first use, then submitted until done
+    mc_Dispatch* sssp;
+};
+
+#endif // MC_GRAPH_H
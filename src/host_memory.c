@@ -0,0 +1,102 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host_memory.h"
+#include "microcompute.h"
+
+#ifdef __linux__
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+// from linux/mempolicy.h, to avoid depending on libnuma
+#define MC_MPOL_BIND 2
+#define MC_MAX_NUMA_NODES 1024
+
+void* mc_host_memory_alloc(uint64_t size, uint64_t pageSize, int32_t numaNode) {
+    if (numaNode >= MC_MAX_NUMA_NODES) return NULL;
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (pageSize > 4096) {
+        int shift = 0;
+        while ((1ull << shift) < pageSize) shift++;
+        flags |= MAP_HUGETLB | shift << MAP_HUGE_SHIFT;
+    }
+
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (ptr == MAP_FAILED) return NULL;
+
+    // the pages are not touched yet, so they are all placed on the node when
+    // first faulted in (when the memory is imported)
+    if (numaNode >= 0) {
+        unsigned long mask[MC_MAX_NUMA_NODES / (8 * sizeof(unsigned long))]
+            = {0};
+        uint32_t bits = 8 * sizeof *mask;
+        mask[numaNode / bits] |= 1ul << numaNode % bits;
+        unsigned long maxNode = 8 * sizeof mask;
+        if (syscall(SYS_mbind, ptr, size, MC_MPOL_BIND, mask, maxNode, 0)) {
+            munmap(ptr, size);
+            return NULL;
+        }
+    }
+
+    return ptr;
+}
+
+void mc_host_memory_free(void* ptr, uint64_t size) {
+    if (ptr) munmap(ptr, size);
+}
+
+bool mc_pin_thread_to_numa_node(int32_t numaNode) {
+    char path[64];
+    snprintf(
+        path,
+        sizeof path,
+        "/sys/devices/system/node/node%d/cpulist",
+        numaNode
+    );
+
+    FILE* fp = fopen(path, "r");
+    if (!fp) return false;
+
+    // the list looks like "0-15,32-47"
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    uint32_t first, last;
+    int count;
+    while ((count = fscanf(fp, "%u-%u", &first, &last)) >= 1) {
+        if (count == 1) last = first;
+        for (uint32_t cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &set);
+        if (fgetc(fp) != ',') break;
+    }
+    fclose(fp);
+
+    if (CPU_COUNT(&set) == 0) return false;
+    return sched_setaffinity(0, sizeof set, &set) == 0;
+}
+
+#else
+
+void* mc_host_memory_alloc(uint64_t size, uint64_t pageSize, int32_t numaNode) {
+    return NULL;
+}
+
+void mc_host_memory_free(void* ptr, uint64_t size) {}
+
+bool mc_pin_thread_to_numa_node(int32_t numaNode) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef MC_HOST_MEMORY_H
+#define MC_HOST_MEMORY_H
+
+#include <stdint.h>
+
+// allocate page aligned host memory with the given page size (hugepages above
+// 4 KiB), bound to a NUMA node (-1 for any node). `size` must be a multiple of
+// the page size. returns `NULL` on error, or if not supported on this platform
+void* mc_host_memory_alloc(uint64_t size, uint64_t pageSize, int32_t numaNode);
+
+void mc_host_memory_free(void* ptr, uint64_t size);
+
+#endif // MC_HOST_MEMORY_H
@@ -14,6 +14,7 @@ mc_HBuffer* mc_hybrid_buffer_create(mc_Device* device, uint64_t size) {
         .gpuBuff = {0},
         .cpuBuff = NULL,
         .copier = NULL,
+        .scratch = NULL,
     };
 
     DEBUG(hBuffer, "Creating hybrid buffer of size %lu", size);
@@ -64,6 +65,7 @@ void mc_hybrid_buffer_destroy(mc_HBuffer* hBuffer) {
     }
     if (hBuffer->cpuBuff) mc_buffer_destroy(hBuffer->cpuBuff);
     if (hBuffer->copier) mc_buffer_copier_destroy(hBuffer->copier);
+    if (hBuffer->scratch) mc_hybrid_buffer_destroy(hBuffer->scratch);
     free(hBuffer);
 }
 
@@ -8,6 +8,7 @@ struct mc_HBuffer {
     mc_Instance* _instance;
     mc_Buffer* cpuBuff;
     mc_BufferCopier* copier;
+    mc_HBuffer* scratch; // for compressed transfers, see codec.c
 };
 
 #endif // TRANSFER_BUFFER_H
\ No newline at end of file
@@ -25,13 +25,28 @@ static VkBool32 mc_vk_log_callback(
     return VK_FALSE;
 }
 
+#define MC_DEFAULT_MAX_QUEUE_COUNT 4
+
 mc_Instance* mc_instance_create(mc_log_fn* log_fn, void* logArg) {
+    return mc_instance_create_with_queues(
+        log_fn,
+        logArg,
+        MC_DEFAULT_MAX_QUEUE_COUNT
+    );
+}
+
+mc_Instance* mc_instance_create_with_queues(
+    mc_log_fn* log_fn,
+    void* logArg,
+    uint32_t maxQueueCount
+) {
     mc_Instance* instance = malloc(sizeof *instance);
     *instance = (mc_Instance){
         ._instance = instance,
         .logArg = logArg,
         .log_fn = log_fn ? log_fn : mc_log_cb_sink,
         .instance = NULL,
+        .apiVersion = VK_API_VERSION_1_0,
         .devCount = 0,
         .devs = NULL,
         .msg = NULL,
@@ -44,6 +59,17 @@ mc_Instance* mc_instance_create(mc_log_fn* log_fn, void* logArg) {
     appI.pApplicationName = "microcompute";
     appI.apiVersion = VK_MAKE_VERSION(1, 0, 0);
 
+    // vulkan 1.1 is used when the loader supports it, for vkCmdDispatchBase()
+    PFN_vkEnumerateInstanceVersion enumerateVersion
+        = (PFN_vkEnumerateInstanceVersion)
+            vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
+    uint32_t loaderVersion = VK_API_VERSION_1_0;
+    if (enumerateVersion && enumerateVersion(&loaderVersion) == VK_SUCCESS
+        && loaderVersion >= VK_API_VERSION_1_1) {
+        instance->apiVersion = VK_API_VERSION_1_1;
+        appI.apiVersion = VK_API_VERSION_1_1;
+    }
+
     DEBUG(instance, "enabling vulkan validation layer");
 
     VkDebugUtilsMessengerCreateInfoEXT msgI = {0};
@@ -127,6 +153,13 @@ mc_Instance* mc_instance_create(mc_log_fn* log_fn, void* logArg) {
             if (VK_QUEUE_COMPUTE_BIT & queueProps[i].queueFlags) queueIdx = i;
         }
 
+        uint32_t queueCount = 0;
+        if (queueIdx != queuePropsCount) {
+            queueCount = queueProps[queueIdx].queueCount;
+            if (maxQueueCount && queueCount > maxQueueCount)
+                queueCount = maxQueueCount;
+        }
+
         free(queueProps);
 
         if (queueIdx == queuePropsCount) {
@@ -134,7 +167,8 @@ mc_Instance* mc_instance_create(mc_log_fn* log_fn, void* logArg) {
             continue;
         }
 
-        instance->devs[idx] = mc_device_create(instance, pDev, queueIdx);
+        instance->devs[idx]
+            = mc_device_create(instance, pDev, queueIdx, queueCount);
         if (!instance->devs[idx]) {
             WARN(instance, "- failed to create device %d", idx);
             physIdx++;
@@ -143,9 +177,10 @@ mc_Instance* mc_instance_create(mc_log_fn* log_fn, void* logArg) {
 
         DEBUG(
             instance,
-            "- found device %d: %s",
+            "- found device %d: %s (%d queue(s))",
             idx,
-            mc_device_get_name(instance->devs[idx])
+            mc_device_get_name(instance->devs[idx]),
+            queueCount
         );
 
         physIdx++;
@@ -10,6 +10,7 @@ struct mc_Instance {
     void* logArg;
     mc_log_fn* log_fn;
     VkInstance instance;
+    uint32_t apiVersion;
     uint32_t devCount;
     mc_Device** devs;
     VkDebugUtilsMessengerEXT msg;
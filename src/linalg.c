@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "dispatch.h"
+#include "log.h"
+#include "program.h"
+
+// the largest supported matrix size, and the invocations per workgroup
+#define MC_LINALG_MAX_SIZE 64
+#define MC_LINALG_WG_SIZE 64
+
+// solve flags, see the solve kernel
+#define MC_SOLVE_UPPER 1
+#define MC_SOLVE_UNIT 2
+#define MC_SOLVE_TRANSPOSED 4
+#define MC_SOLVE_PIVOTS 8
+
+// every kernel handles `M` matrices of size `N` per workgroup, with one
+// invocation per row; `N`, `M` and `NP` (`N` rounded up to a power of two)
+// are defined in front of the code, per matrix size
+#define MC_LINALG_COMMON                                                       \
+    "#extension GL_EXT_control_flow_attributes : require\n"                    \
+    "layout(local_size_x = N * M) in;\n"                                       \
+    "layout(std430, binding = 0) buffer matBuff {\n"                           \
+    "    float mats[];\n"                                                      \
+    "};\n"                                                                     \
+    "layout(std430, binding = 1) buffer pivotBuff {\n"                         \
+    "    uint pivots[];\n"                                                     \
+    "};\n"                                                                     \
+    "layout(std430, binding = 2) buffer rhsBuff {\n"                           \
+    "    float rhs[];\n"                                                       \
+    "};\n"                                                                     \
+    "layout(push_constant) uniform Push {\n"                                   \
+    "    uint count;\n"                                                        \
+    "    uint stride;\n"                                                       \
+    "    uint flags;\n"                                                        \
+    "};\n"                                                                     \
+    "#define SLOT (gl_LocalInvocationID.x / N)\n"                              \
+    "#define ROW (gl_LocalInvocationID.x % N)\n"                               \
+    "#define WG (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x)\n"  \
+    "#define BATCH (WG * M + SLOT)\n"                                          \
+    "#define VALID (BATCH < count)\n"                                          \
+    "#define BASE (BATCH * stride)\n"
+
+// right-looking LU with partial pivoting, each invocation keeping its row in
+// registers (the loops over a row are unrolled, so that it is never indexed
+// dynamically); rows are exchanged by swapping their logical positions, the
+// data only moves when it is written back
+static const char* luSource
+    = MC_LINALG_COMMON
+      "shared float sVal[M * NP];\n"
+      "shared uint sIdx[M * NP];\n"
+      "shared float sPivot[M * N];\n"
+      "shared uint sSwap[M];\n"
+      "void main(void) {\n"
+      "    float row[N];\n"
+      "    [[unroll]] for (uint j = 0u; j < N; j++)\n"
+      "        row[j] = VALID ? mats[BASE + ROW * N + j] : 0.0;\n"
+      "    uint pos = ROW;\n"
+      "    uint s = SLOT * NP;\n"
+      "    uint p0 = SLOT * N;\n"
+      "    for (uint k = 0u; k < N; k++) {\n"
+      "        float rk = 0.0;\n"
+      "        [[unroll]] for (uint j = 0u; j < N; j++)\n"
+      "            if (j == k) rk = row[j];\n"
+      "        // the pivot is the largest magnitude in column k, of the\n"
+      "        // rows not yet eliminated\n"
+      "        sVal[s + ROW] = pos >= k ? abs(rk) : -1.0;\n"
+      "        sIdx[s + ROW] = ROW;\n"
+      "        if (ROW < NP - N) {\n"
+      "            sVal[s + N + ROW] = -1.0;\n"
+      "            sIdx[s + N + ROW] = 0u;\n"
+      "        }\n"
+      "        barrier();\n"
+      "        for (uint off = NP / 2u; off > 0u; off >>= 1) {\n"
+      "            if (ROW < off && sVal[s + ROW + off] > sVal[s + ROW]) {\n"
+      "                sVal[s + ROW] = sVal[s + ROW + off];\n"
+      "                sIdx[s + ROW] = sIdx[s + ROW + off];\n"
+      "            }\n"
+      "            barrier();\n"
+      "        }\n"
+      "        if (ROW == sIdx[s]) {\n"
+      "            sSwap[SLOT] = pos;\n"
+      "            if (VALID) pivots[BATCH * N + k] = pos;\n"
+      "            [[unroll]] for (uint j = 0u; j < N; j++)\n"
+      "                sPivot[p0 + j] = row[j];\n"
+      "        }\n"
+      "        barrier();\n"
+      "        if (ROW == sIdx[s]) pos = k;\n"
+      "        else if (pos == k) pos = sSwap[SLOT];\n"
+      "        if (pos > k) {\n"
+      "            float l = rk / sPivot[p0 + k];\n"
+      "            [[unroll]] for (uint j = 0u; j < N; j++) {\n"
+      "                if (j == k) row[j] = l;\n"
+      "                if (j > k) row[j] -= l * sPivot[p0 + j];\n"
+      "            }\n"
+      "        }\n"
+      "        barrier();\n"
+      "    }\n"
+      "    if (!VALID) return;\n"
+      "    [[unroll]] for (uint j = 0u; j < N; j++)\n"
+      "        mats[BASE + pos * N + j] = row[j];\n"
+      "}\n";
+
+// right-looking Cholesky (lower factor), with each row in registers like LU;
+// the strictly upper part is zeroed
+static const char* choleskySource
+    = MC_LINALG_COMMON
+      "shared float sDiag[M];\n"
+      "shared float sCol[M * N];\n"
+      "void main(void) {\n"
+      "    float row[N];\n"
+      "    [[unroll]] for (uint j = 0u; j < N; j++)\n"
+      "        row[j] = VALID ? mats[BASE + ROW * N + j] : 1.0;\n"
+      "    uint c0 = SLOT * N;\n"
+      "    for (uint k = 0u; k < N; k++) {\n"
+      "        float rk = 0.0;\n"
+      "        [[unroll]] for (uint j = 0u; j < N; j++)\n"
+      "            if (j == k) rk = row[j];\n"
+      "        if (ROW == k) sDiag[SLOT] = sqrt(rk);\n"
+      "        barrier();\n"
+      "        if (ROW == k) rk = sDiag[SLOT];\n"
+      "        if (ROW > k) {\n"
+      "            rk /= sDiag[SLOT];\n"
+      "            sCol[c0 + ROW] = rk;\n"
+      "        }\n"
+      "        [[unroll]] for (uint j = 0u; j < N; j++)\n"
+      "            if (j == k && ROW >= k) row[j] = rk;\n"
+      "        barrier();\n"
+      "        if (ROW > k) {\n"
+      "            [[unroll]] for (uint j = 0u; j < N; j++)\n"
+      "                if (j > k && j <= ROW) row[j] -= rk * sCol[c0 + j];\n"
+      "        }\n"
+      "    }\n"
+      "    if (!VALID) return;\n"
+      "    [[unroll]] for (uint j = 0u; j < N; j++)\n"
+      "        mats[BASE + ROW * N + j] = j <= ROW ? row[j] : 0.0;\n"
+      "}\n";
+
+// triangular solve of one right hand side vector per matrix, column by
+// column: the invocation of row k finishes x[k], then the remaining rows
+// subtract its contribution; the vector is permuted first for LU factors
+static const char* solveSource
+    = MC_LINALG_COMMON
+      "shared float sX[M * N];\n"
+      "float get(uint i, uint j) {\n"
+      "    return (flags & 4u) != 0u ? mats[BASE + j * N + i]\n"
+      "                              : mats[BASE + i * N + j];\n"
+      "}\n"
+      "void main(void) {\n"
+      "    uint x0 = SLOT * N;\n"
+      "    float x = VALID ? rhs[BATCH * N + ROW] : 0.0;\n"
+      "    if ((flags & 8u) != 0u) {\n"
+      "        sX[x0 + ROW] = x;\n"
+      "        barrier();\n"
+      "        if (ROW == 0u && VALID) {\n"
+      "            for (uint k = 0u; k < N; k++) {\n"
+      "                uint r = pivots[BATCH * N + k];\n"
+      "                float tmp = sX[x0 + k];\n"
+      "                sX[x0 + k] = sX[x0 + r];\n"
+      "                sX[x0 + r] = tmp;\n"
+      "            }\n"
+      "        }\n"
+      "        barrier();\n"
+      "        x = sX[x0 + ROW];\n"
+      "        barrier();\n"
+      "    }\n"
+      "    // an upper matrix, or a transposed lower one, is solved backwards\n"
+      "    bool backward = ((flags & 1u) != 0u) != ((flags & 4u) != 0u);\n"
+      "    for (uint step = 0u; step < N; step++) {\n"
+      "        uint k = backward ? N - 1u - step : step;\n"
+      "        if (ROW == k) {\n"
+      "            if ((flags & 2u) == 0u && VALID) x /= get(k, k);\n"
+      "            sX[x0 + k] = x;\n"
+      "        }\n"
+      "        barrier();\n"
+      "        bool after = backward ? ROW < k : ROW > k;\n"
+      "        if (after && VALID) x -= get(ROW, k) * sX[x0 + k];\n"
+      "    }\n"
+      "    if (VALID) rhs[BATCH * N + ROW] = x;\n"
+      "}\n";
+
+typedef struct mc_LinalgPush {
+    uint32_t count;
+    uint32_t stride;
+    uint32_t flags;
+} mc_LinalgPush;
+
+static uint32_t mc_linalg_per_group(uint32_t n) {
+    return n < MC_LINALG_WG_SIZE ? MC_LINALG_WG_SIZE / n : 1;
+}
+
+// get the variant of a kernel for a matrix size, compiled on first use
+static mc_Pipeline* mc_linalg_get_pipeline(
+    mc_Device* device,
+    const char* kernel,
+    const char* source,
+    uint32_t n
+) {
+    uint32_t np = 1;
+    while (np < n) np <<= 1;
+
+    char name[32];
+    snprintf(name, sizeof name, "%s_%d", kernel, n);
+
+    char header[96];
+    int headerLen = snprintf(
+        header,
+        sizeof header,
+        "#version 450\n#define N %du\n#define M %du\n#define NP %du\n",
+        n,
+        mc_linalg_per_group(n),
+        np
+    );
+
+    size_t sourceLen = strlen(source);
+    char* code = malloc(headerLen + sourceLen + 1);
+    memcpy(code, header, headerLen);
+    memcpy(code + headerLen, source, sourceLen + 1);
+
+    mc_Program* program = mc_program_get_builtin(device, name, code);
+    free(code);
+    return program ? mc_program_get_pipeline(program, 3) : NULL;
+}
+
+static bool mc_linalg_check(
+    mc_Buffer* matrices,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride
+) {
+    if (!matrices) return false;
+    if (n == 0 || n > MC_LINALG_MAX_SIZE) {
+        ERROR(matrices, "matrix size must be 1 to %d", MC_LINALG_MAX_SIZE);
+        return false;
+    }
+    if (stride < n * n) {
+        ERROR(matrices, "matrix stride smaller than a matrix");
+        return false;
+    }
+    uint64_t size = count == 0 ? 0
+                               : sizeof(float)
+                                     * ((uint64_t)stride * (count - 1)
+                                        + (uint64_t)n * n);
+    if (matrices->size < size) {
+        ERROR(matrices, "matrix buffer too small");
+        return false;
+    }
+    return true;
+}
+
+static bool mc_linalg_check_vectors(
+    mc_Buffer* buff,
+    uint32_t n,
+    uint32_t count,
+    const char* name
+) {
+    if (!buff) return false;
+    if (buff->size < sizeof(uint32_t) * (uint64_t)n * count) {
+        ERROR(buff, "%s buffer too small", name);
+        return false;
+    }
+    return true;
+}
+
+// run up to two passes of one kernel over a batch of matrices, in one
+// submission
+static double mc_linalg_run(
+    const char* kernel,
+    const char* source,
+    mc_Buffer* matrices,
+    mc_Buffer* pivots,
+    mc_Buffer* rhs,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride,
+    uint32_t passCount,
+    const uint32_t* flags
+) {
+    mc_Device* device = matrices->device;
+    mc_Pipeline* pipeline
+        = mc_linalg_get_pipeline(device, kernel, source, n);
+    if (!pipeline) return -1.0;
+    if (count == 0) return 0.0;
+
+    // unused bindings alias the matrices
+    mc_Buffer* buffs[3] = {
+        matrices,
+        pivots ? pivots : matrices,
+        rhs ? rhs : matrices,
+    };
+
+    mc_Dispatch* dispatch = mc_dispatch_create(device);
+    VkDescriptorSet descSet = NULL;
+    if (dispatch)
+        descSet = mc_dispatch_create_set(dispatch, pipeline, 3, buffs);
+    bool ok = dispatch && descSet;
+
+    if (ok) {
+        // the workgroups are spread over y when there are too many for x
+        uint32_t perGroup = mc_linalg_per_group(n);
+        uint32_t groups = (count + perGroup - 1) / perGroup;
+        uint32_t groupsX = groups < device->maxWgCount[0]
+                             ? groups
+                             : device->maxWgCount[0];
+        uint32_t groupsY = (groups + groupsX - 1) / groupsX;
+
+        mc_dispatch_bind(dispatch, pipeline, descSet);
+        for (uint32_t i = 0; i < passCount; i++) {
+            mc_LinalgPush push = {count, stride, flags[i]};
+            mc_dispatch_barrier(dispatch);
+            mc_dispatch_push(dispatch, pipeline, sizeof push, &push);
+            vkCmdDispatch(dispatch->cmdBuff, groupsX, groupsY, 1);
+        }
+        ok = mc_dispatch_finish(dispatch);
+    }
+
+    double time = ok ? mc_dispatch_submit(dispatch) : -1.0;
+    mc_dispatch_destroy(dispatch);
+    return time;
+}
+
+double mc_batched_lu(
+    mc_Buffer* matrices,
+    mc_Buffer* pivots,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride
+) {
+    if (!mc_linalg_check(matrices, n, count, stride)) return -1.0;
+    if (!mc_linalg_check_vectors(pivots, n, count, "pivot")) return -1.0;
+    DEBUG(matrices, "LU factorizing %d matrices of size %d", count, n);
+
+    uint32_t flags = 0;
+    return mc_linalg_run(
+        "lu",
+        luSource,
+        matrices,
+        pivots,
+        NULL,
+        n,
+        count,
+        stride,
+        1,
+        &flags
+    );
+}
+
+double mc_batched_cholesky(
+    mc_Buffer* matrices,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride
+) {
+    if (!mc_linalg_check(matrices, n, count, stride)) return -1.0;
+    DEBUG(matrices, "Cholesky factorizing %d matrices of size %d", count, n);
+
+    uint32_t flags = 0;
+    return mc_linalg_run(
+        "cholesky",
+        choleskySource,
+        matrices,
+        NULL,
+        NULL,
+        n,
+        count,
+        stride,
+        1,
+        &flags
+    );
+}
+
+double mc_batched_triangular_solve(
+    mc_Buffer* matrices,
+    mc_Buffer* rhs,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride,
+    bool upper,
+    bool transposed,
+    bool unitDiagonal
+) {
+    if (!mc_linalg_check(matrices, n, count, stride)) return -1.0;
+    if (!mc_linalg_check_vectors(rhs, n, count, "right hand side"))
+        return -1.0;
+    DEBUG(matrices, "solving %d triangular systems of size %d", count, n);
+
+    uint32_t flags = (upper ? MC_SOLVE_UPPER : 0)
+                   | (transposed ? MC_SOLVE_TRANSPOSED : 0)
+                   | (unitDiagonal ? MC_SOLVE_UNIT : 0);
+    return mc_linalg_run(
+        "solve",
+        solveSource,
+        matrices,
+        NULL,
+        rhs,
+        n,
+        count,
+        stride,
+        1,
+        &flags
+    );
+}
+
+double mc_batched_lu_solve(
+    mc_Buffer* matrices,
+    mc_Buffer* pivots,
+    mc_Buffer* rhs,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride
+) {
+    if (!mc_linalg_check(matrices, n, count, stride)) return -1.0;
+    if (!mc_linalg_check_vectors(pivots, n, count, "pivot")) return -1.0;
+    if (!mc_linalg_check_vectors(rhs, n, count, "right hand side"))
+        return -1.0;
+    DEBUG(matrices, "solving %d LU factorized systems of size %d", count, n);
+
+    // P A = L U: permute, then solve with the unit lower and the upper factor
+    uint32_t flags[2] = {MC_SOLVE_PIVOTS | MC_SOLVE_UNIT, MC_SOLVE_UPPER};
+    return mc_linalg_run(
+        "solve",
+        solveSource,
+        matrices,
+        pivots,
+        rhs,
+        n,
+        count,
+        stride,
+        2,
+        flags
+    );
+}
+
+double mc_batched_cholesky_solve(
+    mc_Buffer* matrices,
+    mc_Buffer* rhs,
+    uint32_t n,
+    uint32_t count,
+    uint32_t stride
+) {
+    if (!mc_linalg_check(matrices, n, count, stride)) return -1.0;
+    if (!mc_linalg_check_vectors(rhs, n, count, "right hand side"))
+        return -1.0;
+    DEBUG(matrices, "solving %d Cholesky systems of size %d", count, n);
+
+    // A = L L^T: solve with L, then with L transposed
+    uint32_t flags[2] = {0, MC_SOLVE_TRANSPOSED};
+    return mc_linalg_run(
+        "solve",
+        solveSource,
+        matrices,
+        NULL,
+        rhs,
+        n,
+        count,
+        stride,
+        2,
+        flags
+    );
+}
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "dispatch.h"
+#include "hybrid_buffer.h"
+#include "log.h"
+#include "pattern_matcher.h"
+#include "program.h"
+#include "vector.h"
+
+// the size of the chunks files are scanned in (plus the overlap with the
+// previous chunk)
+#define MC_MATCHER_CHUNK_SIZE (16 * 1024 * 1024)
+
+// the min number of bytes scanned by an invocation
+#define MC_MATCHER_SEGMENT_SIZE 1024
+
+// a missing transition, while building the automaton
+#define MC_MATCHER_NONE 0xffffffffu
+
+// each invocation runs the automaton over a segment of the text, starting
+// `overlap` bytes early so that it is in the right state at the start of the
+// segment, and appends the matches ending in the segment to the vector. the
+// table holds:
+// - the byte classes (256 words)
+// - the transitions (`classCount` words per state)
+// - the offsets of the output list of each state (`stateCount + 1` words)
+// - the output lists (the ids of the patterns ending at each state)
+// - the pattern lengths
+static const char* matcherSource
+    = "#version 450\n"
+      "layout(local_size_x = 64) in;\n"
+      "layout(std430, binding = 0) buffer textBuff {\n"
+      "    uint text[];\n"
+      "};\n"
+      "layout(std430, binding = 1) buffer tableBuff {\n"
+      "    uint table[];\n"
+      "};\n"
+      "layout(std430, binding = 2) buffer matchBuff {\n"
+      "    uvec4 matches[];\n"
+      "};\n"
+      "layout(std430, binding = 3) buffer counterBuff {\n"
+      "    uint size;\n"
+      "    uint capacity;\n"
+      "};\n"
+      "layout(push_constant) uniform Push {\n"
+      "    uint textSize;\n"
+      "    uint first;\n"
+      "    uint baseLo;\n"
+      "    uint baseHi;\n"
+      "    uint segment;\n"
+      "    uint overlap;\n"
+      "    uint classCount;\n"
+      "    uint outOffset;\n"
+      "    uint idOffset;\n"
+      "    uint lenOffset;\n"
+      "};\n"
+      "void main(void) {\n"
+      "    uint idx = (gl_GlobalInvocationID.y * gl_NumWorkGroups.x\n"
+      "                * gl_WorkGroupSize.x) + gl_GlobalInvocationID.x;\n"
+      "    uint start = first + idx * segment;\n"
+      "    if (idx >= (textSize - first + segment - 1u) / segment) return;\n"
+      "    uint end = min(start + segment, textSize);\n"
+      "    uint p = start - min(start, overlap);\n"
+      "    uint word = text[p >> 2];\n"
+      "    uint state = 0u;\n"
+      "    for (; p < end; p++) {\n"
+      "        if ((p & 3u) == 0u) word = text[p >> 2];\n"
+      "        uint byte = (word >> ((p & 3u) * 8u)) & 0xffu;\n"
+      "        state = table[256u + state * classCount + table[byte]];\n"
+      "        if (p < start) continue;\n"
+      "        uint o = table[outOffset + state];\n"
+      "        uint oEnd = table[outOffset + state + 1u];\n"
+      "        for (; o < oEnd; o++) {\n"
+      "            uint id = table[idOffset + o];\n"
+      "            uint len = table[lenOffset + id];\n"
+      "            uint i = atomicAdd(size, 1u);\n"
+      "            if (i >= capacity) continue;\n"
+      "            uint carry;\n"
+      "            uint lo = uaddCarry(baseLo, p + 1u - len, carry);\n"
+      "            matches[i] = uvec4(lo, baseHi + carry, id, len);\n"
+      "        }\n"
+      "    }\n"
+      "}\n";
+
+typedef struct mc_MatcherPush {
+    uint32_t textSize;
+    uint32_t first;
+    uint32_t baseLo;
+    uint32_t baseHi;
+    uint32_t segment;
+    uint32_t overlap;
+    uint32_t classCount;
+    uint32_t outOffset;
+    uint32_t idOffset;
+    uint32_t lenOffset;
+} mc_MatcherPush;
+
+// builds the Aho-Corasick automaton of the patterns, as a dense transition
+// table over byte classes (the bytes that appear in no pattern share a class)
+static uint32_t* mc_pattern_matcher_build(
+    mc_PatternMatcher* matcher,
+    const char* const* patterns,
+    const uint32_t* lengths,
+    uint64_t* wordCount
+) {
+    uint32_t patternCount = matcher->patternCount;
+    uint32_t classes[256] = {0};
+    uint32_t classCount = 1;
+    uint64_t maxStates = 1;
+    uint32_t maxLength = 0;
+    for (uint32_t p = 0; p < patternCount; p++) {
+        const uint8_t* pattern = (const uint8_t*)patterns[p];
+        for (uint32_t i = 0; i < lengths[p]; i++)
+            if (!classes[pattern[i]]) classes[pattern[i]] = classCount++;
+        maxStates += lengths[p];
+        if (lengths[p] > maxLength) maxLength = lengths[p];
+    }
+
+    if (maxStates * classCount + maxStates > UINT32_MAX) {
+        ERROR(matcher, "too many patterns");
+        return NULL;
+    }
+
+    uint32_t* next = malloc(sizeof *next * maxStates * classCount);
+    uint32_t* own = malloc(sizeof *own * maxStates);
+    uint32_t* sameNext = malloc(sizeof *sameNext * patternCount);
+    memset(next, 0xff, sizeof *next * maxStates * classCount);
+    memset(own, 0xff, sizeof *own * maxStates);
+
+    // the trie, with the patterns ending at each state as a linked list
+    uint32_t stateCount = 1;
+    for (uint32_t p = 0; p < patternCount; p++) {
+        const uint8_t* pattern = (const uint8_t*)patterns[p];
+        uint32_t s = 0;
+        for (uint32_t i = 0; i < lengths[p]; i++) {
+            uint32_t* t = &next[s * classCount + classes[pattern[i]]];
+            if (*t == MC_MATCHER_NONE) *t = stateCount++;
+            s = *t;
+        }
+        sameNext[p] = own[s];
+        own[s] = p;
+    }
+
+    // the failure links, in BFS order, filling the missing transitions with
+    // the transitions of the failure state
+    uint32_t* fail = calloc(stateCount, sizeof *fail);
+    uint32_t* order = malloc(sizeof *order * stateCount);
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    for (uint32_t c = 0; c < classCount; c++) {
+        if (next[c] == MC_MATCHER_NONE) next[c] = 0;
+        else order[tail++] = next[c];
+    }
+    while (head < tail) {
+        uint32_t s = order[head++];
+        for (uint32_t c = 0; c < classCount; c++) {
+            uint32_t* t = &next[s * classCount + c];
+            uint32_t u = next[fail[s] * classCount + c];
+            if (*t == MC_MATCHER_NONE) {
+                *t = u;
+            } else {
+                fail[*t] = u;
+                order[tail++] = *t;
+            }
+        }
+    }
+
+    // the outputs of a state are its own patterns, then the outputs of its
+    // failure state
+    uint32_t* outOffsets = calloc(stateCount + 1, sizeof *outOffsets);
+    uint64_t* outCounts = calloc(stateCount, sizeof *outCounts);
+    for (uint32_t i = 0; i < tail; i++) {
+        uint32_t s = order[i];
+        outCounts[s] = outCounts[fail[s]];
+        for (uint32_t p = own[s]; p != MC_MATCHER_NONE; p = sameNext[p])
+            outCounts[s]++;
+    }
+    uint64_t outTotal = 0;
+    for (uint32_t s = 0; s < stateCount; s++) {
+        outOffsets[s] = outTotal;
+        outTotal += outCounts[s];
+        if (outTotal > UINT32_MAX) break;
+    }
+    outOffsets[stateCount] = outTotal;
+
+    uint32_t* words = NULL;
+    *wordCount = 256 + (uint64_t)stateCount * classCount + stateCount + 1
+               + outTotal + patternCount;
+    if (outTotal > UINT32_MAX || *wordCount > UINT32_MAX) {
+        ERROR(matcher, "too many patterns");
+    } else {
+        matcher->stateCount = stateCount;
+        matcher->classCount = classCount;
+        matcher->overlap = maxLength - 1;
+        matcher->outOffset = 256 + stateCount * classCount;
+        matcher->idOffset = matcher->outOffset + stateCount + 1;
+        matcher->lenOffset = matcher->idOffset + outTotal;
+
+        words = malloc(sizeof *words * *wordCount);
+        memcpy(words, classes, sizeof classes);
+        memcpy(&words[256], next, sizeof *next * stateCount * classCount);
+        memcpy(
+            &words[matcher->outOffset],
+            outOffsets,
+            sizeof *outOffsets * (stateCount + 1)
+        );
+        uint32_t* ids = &words[matcher->idOffset];
+        for (uint32_t i = 0; i < tail; i++) {
+            uint32_t s = order[i];
+            uint32_t o = outOffsets[s];
+            for (uint32_t p = own[s]; p != MC_MATCHER_NONE; p = sameNext[p])
+                ids[o++] = p;
+            uint32_t f = fail[s];
+            memcpy(&ids[o], &ids[outOffsets[f]], sizeof *ids * outCounts[f]);
+        }
+        memcpy(
+            &words[matcher->lenOffset],
+            lengths,
+            sizeof *lengths * patternCount
+        );
+    }
+
+    free(outCounts);
+    free(outOffsets);
+    free(order);
+    free(fail);
+    free(sameNext);
+    free(own);
+    free(next);
+    return words;
+}
+
+mc_PatternMatcher* mc_pattern_matcher_create(
+    mc_Device* device,
+    uint32_t patternCount,
+    const char* const* patterns,
+    const uint32_t* lengths
+) {
+    if (!device) return NULL;
+
+    mc_PatternMatcher* matcher = malloc(sizeof *matcher);
+    *matcher = (mc_PatternMatcher){
+        ._instance = device->_instance,
+        .device = device,
+        .patternCount = patternCount,
+        .stateCount = 0,
+        .classCount = 0,
+        .overlap = 0,
+        .outOffset = 0,
+        .idOffset = 0,
+        .lenOffset = 0,
+        .table = NULL,
+        .staging = NULL,
+    };
+
+    DEBUG(matcher, "creating pattern matcher, patterns: %d", patternCount);
+
+    bool valid = patternCount > 0 && patterns && lengths;
+    for (uint32_t p = 0; p < patternCount && valid; p++)
+        valid = patterns[p] && lengths[p] > 0;
+    if (!valid) {
+        ERROR(matcher, "invalid or empty patterns");
+        mc_pattern_matcher_destroy(matcher);
+        return NULL;
+    }
+
+    uint64_t wordCount = 0;
+    uint32_t* words
+        = mc_pattern_matcher_build(matcher, patterns, lengths, &wordCount);
+    if (!words) {
+        mc_pattern_matcher_destroy(matcher);
+        return NULL;
+    }
+
+    DEBUG(
+        matcher,
+        "pattern matcher states: %d, byte classes: %d",
+        matcher->stateCount,
+        matcher->classCount
+    );
+
+    matcher->table = mc_hybrid_buffer_create_from(
+        device,
+        sizeof *words * wordCount,
+        words
+    );
+    free(words);
+
+    if (!matcher->table) {
+        mc_pattern_matcher_destroy(matcher);
+        return NULL;
+    }
+
+    return matcher;
+}
+
+void mc_pattern_matcher_destroy(mc_PatternMatcher* matcher) {
+    if (!matcher) return;
+    DEBUG(matcher, "destroying pattern matcher");
+
+    mc_buffer_destroy(matcher->staging);
+    mc_hybrid_buffer_destroy(matcher->table);
+    free(matcher);
+}
+
+uint32_t mc_pattern_matcher_get_overlap(mc_PatternMatcher* matcher) {
+    return matcher ? matcher->overlap : 0;
+}
+
+// appends the matches of one chunk, returns `false` if some did not fit
+static bool mc_pattern_matcher_run(
+    mc_PatternMatcher* matcher,
+    mc_Buffer* text,
+    uint32_t size,
+    uint32_t first,
+    uint64_t baseOffset,
+    mc_Vector* matches,
+    bool* ok
+) {
+    mc_Device* device = matcher->device;
+    mc_Program* program = mc_program_get_builtin(
+        device,
+        "pattern_matcher",
+        matcherSource
+    );
+    mc_Pipeline* pipeline
+        = program ? mc_program_get_pipeline(program, 4) : NULL;
+    *ok = pipeline != NULL;
+    if (!*ok || first >= size) return true;
+
+    // long patterns get longer segments, so that the overlap stays cheap
+    uint32_t segment = 4 * matcher->overlap;
+    if (segment < MC_MATCHER_SEGMENT_SIZE) segment = MC_MATCHER_SEGMENT_SIZE;
+
+    uint32_t segments = (size - first + segment - 1) / segment;
+    uint32_t groups = (segments + 63) / 64;
+    uint32_t groupsX = groups < device->maxWgCount[0]
+                         ? groups
+                         : device->maxWgCount[0];
+    uint32_t groupsY = (groups + groupsX - 1) / groupsX;
+
+    mc_Buffer* buffs[4] = {
+        text,
+        (mc_Buffer*)matcher->table,
+        mc_vector_get_buffer(matches),
+        mc_vector_get_counter(matches),
+    };
+    mc_MatcherPush push = {
+        .textSize = size,
+        .first = first,
+        .baseLo = (uint32_t)baseOffset,
+        .baseHi = (uint32_t)(baseOffset >> 32),
+        .segment = segment,
+        .overlap = matcher->overlap,
+        .classCount = matcher->classCount,
+        .outOffset = matcher->outOffset,
+        .idOffset = matcher->idOffset,
+        .lenOffset = matcher->lenOffset,
+    };
+
+    mc_Dispatch* dispatch = mc_dispatch_create(device);
+    *ok = dispatch
+       && mc_dispatch_add_pushed(
+              dispatch,
+              program,
+              (uint32_t[]){groupsX, groupsY, 1},
+              4,
+              buffs,
+              sizeof push,
+              &push
+       )
+       && mc_dispatch_finish(dispatch)
+       && mc_dispatch_submit(dispatch) >= 0.0;
+    mc_dispatch_destroy(dispatch);
+
+    return !*ok || mc_vector_sync(matches) == 0;
+}
+
+// scans a chunk, again if the vector was too small (it has grown since)
+static bool mc_pattern_matcher_scan_chunk(
+    mc_PatternMatcher* matcher,
+    mc_Buffer* text,
+    uint32_t size,
+    uint32_t first,
+    uint64_t baseOffset,
+    mc_Vector* matches
+) {
+    bool ok = true;
+    uint64_t capacity = mc_vector_get_capacity(matches);
+    while (!mc_pattern_matcher_run(
+        matcher,
+        text,
+        size,
+        first,
+        baseOffset,
+        matches,
+        &ok
+    )) {
+        // the vector has grown, unless growing it failed
+        if (mc_vector_get_capacity(matches) == capacity) return false;
+        capacity = mc_vector_get_capacity(matches);
+    }
+    return ok;
+}
+
+bool mc_pattern_matcher_scan(
+    mc_PatternMatcher* matcher,
+    mc_Buffer* text,
+    uint64_t size,
+    uint32_t first,
+    uint64_t baseOffset,
+    mc_Vector* matches
+) {
+    if (!matcher || !text || !matches) return false;
+    DEBUG(matcher, "scanning %ld bytes", size);
+
+    if (size > UINT32_MAX - 3 || text->size < (size + 3) / 4 * 4) {
+        ERROR(matcher, "text too large, or text buffer too small");
+        return false;
+    }
+
+    if (matches->elemSize != sizeof(mc_PatternMatch)) {
+        ERROR(matcher, "the match vector must hold mc_PatternMatch elements");
+        return false;
+    }
+
+    return mc_pattern_matcher_scan_chunk(
+        matcher,
+        text,
+        size,
+        first,
+        baseOffset,
+        matches
+    );
+}
+
+bool mc_pattern_matcher_scan_file(
+    mc_PatternMatcher* matcher,
+    const char* filename,
+    mc_Vector* matches
+) {
+    if (!matcher || !matches) return false;
+    DEBUG(matcher, "scanning file %s", filename);
+
+    if (matches->elemSize != sizeof(mc_PatternMatch)) {
+        ERROR(matcher, "the match vector must hold mc_PatternMatch elements");
+        return false;
+    }
+
+    FILE* fp = filename ? fopen(filename, "rb") : NULL;
+    if (!fp) {
+        ERROR(matcher, "failed to open %s", filename);
+        return false;
+    }
+    // unbuffered, so the reads go straight to the staging buffer
+    setvbuf(fp, NULL, _IONBF, 0);
+
+    // the chunks are read straight into the (device visible) staging buffer,
+    // behind the last `overlap` bytes of the previous chunk
+    uint64_t capacity = MC_MATCHER_CHUNK_SIZE + matcher->overlap;
+    if (!matcher->staging) {
+        matcher->staging = mc_buffer_create(
+            matcher->device,
+            MC_BUFFER_TYPE_CPU,
+            (capacity + 3) / 4 * 4
+        );
+    }
+    if (!matcher->staging) {
+        fclose(fp);
+        return false;
+    }
+
+    char* staging = matcher->staging->map;
+    uint64_t offset = 0; // the file offset of the start of the staging buffer
+    uint32_t kept = 0;   // the bytes kept from the previous chunk
+    bool ok = true;
+    while (ok) {
+        uint64_t size = kept;
+        size += fread(staging + size, 1, capacity - size, fp);
+        ok = !ferror(fp);
+        if (!ok) ERROR(matcher, "failed to read %s", filename);
+        if (!ok || size == kept) break;
+
+        ok = mc_pattern_matcher_scan_chunk(
+            matcher,
+            matcher->staging,
+            size,
+            kept,
+            offset,
+            matches
+        );
+
+        kept = size < matcher->overlap ? size : matcher->overlap;
+        memmove(staging, staging + size - kept, kept);
+        offset += size - kept;
+    }
+
+    fclose(fp);
+    return ok;
+}
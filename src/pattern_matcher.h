@@ -0,0 +1,21 @@
+#ifndef MC_PATTERN_MATCHER_H
+#define MC_PATTERN_MATCHER_H
+
+#include "microcompute.h"
+#include "microcompute_extra.h"
+
+struct mc_PatternMatcher {
+    mc_Instance* _instance;
+    mc_Device* device;
+    uint32_t patternCount;
+    uint32_t stateCount;
+    uint32_t classCount;
+    uint32_t overlap;   // the length of the longest pattern, minus one
+    uint32_t outOffset; // the offsets of the parts of the table, in words
+    uint32_t idOffset;
+    uint32_t lenOffset;
+    mc_HBuffer* table;
+    mc_Buffer* staging; // for scanning files, created on first use
+};
+
+#endif // MC_PATTERN_MATCHER_H
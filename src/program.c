@@ -5,39 +5,28 @@
 
 #include "buffer.h"
 #include "device.h"
+#include "dispatch.h"
 #include "log.h"
 #include "program.h"
 
 #include <program_code.h>
 
-static void mc_program_clear(mc_Program* program) {
-    DEBUG(program, "clearing program");
-    VkDevice dev = program->device->dev;
-    if (program->cmdBuff)
-        vkFreeCommandBuffers(dev, program->cmdPool, 1, &program->cmdBuff);
-    if (program->cmdPool) //
-        vkDestroyCommandPool(dev, program->cmdPool, NULL);
-    if (program->descSet)
-        vkFreeDescriptorSets(dev, program->descPool, 1, &program->descSet);
-    if (program->descPool) //
-        vkDestroyDescriptorPool(dev, program->descPool, NULL);
-    if (program->pipeline) //
-        vkDestroyPipeline(dev, program->pipeline, NULL);
-    if (program->pipelineLayout)
-        vkDestroyPipelineLayout(dev, program->pipelineLayout, NULL);
-    if (program->descSetLayout)
-        vkDestroyDescriptorSetLayout(dev, program->descSetLayout, 0);
-}
-
-static void mc_program_setup(mc_Program* program) {
-    mc_program_clear(program);
-
-    DEBUG(program, "setting up program with %d buffer(s):", program->buffCount);
+bool mc_program_create_layouts(
+    mc_Program* program,
+    int32_t buffCount,
+    mc_Pipeline* pipeline
+) {
+    *pipeline = (mc_Pipeline){
+        .buffCount = buffCount,
+        .descSetLayout = NULL,
+        .pipelineLayout = NULL,
+        .pipeline = NULL,
+    };
 
     VkDescriptorSetLayoutBinding* descBindings
-        = malloc(sizeof *descBindings * program->buffCount);
+        = malloc(sizeof *descBindings * buffCount);
 
-    for (int32_t i = 0; i < program->buffCount; i++) {
+    for (int32_t i = 0; i < buffCount; i++) {
         descBindings[i] = (VkDescriptorSetLayoutBinding){0};
         descBindings[i].binding = i;
         descBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -47,193 +36,186 @@ static void mc_program_setup(mc_Program* program) {
 
     VkDescriptorSetLayoutCreateInfo descLayoutInfo = {0};
     descLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descLayoutInfo.bindingCount = program->buffCount;
+    descLayoutInfo.bindingCount = buffCount;
     descLayoutInfo.pBindings = descBindings;
 
     if (vkCreateDescriptorSetLayout(
             program->device->dev,
             &descLayoutInfo,
             NULL,
-            &program->descSetLayout
+            &pipeline->descSetLayout
         )) {
         ERROR(program, "failed to create descriptor set layout");
         free(descBindings);
-        return;
+        return false;
     }
 
     free(descBindings);
 
+    VkPushConstantRange pushRange = {0};
+    pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushRange.offset = 0;
+    pushRange.size = MC_PUSH_CONSTANT_SIZE;
+
     VkPipelineLayoutCreateInfo pipelineInfo = {0};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineInfo.setLayoutCount = 1;
-    pipelineInfo.pSetLayouts = &program->descSetLayout;
+    pipelineInfo.pSetLayouts = &pipeline->descSetLayout;
+    pipelineInfo.pushConstantRangeCount = 1;
+    pipelineInfo.pPushConstantRanges = &pushRange;
 
     if (vkCreatePipelineLayout(
             program->device->dev,
             &pipelineInfo,
             NULL,
-            &program->pipelineLayout
+            &pipeline->pipelineLayout
         )) {
         ERROR(program, "failed to create pipeline layout");
-        return;
+        mc_program_destroy_pipeline(program, pipeline);
+        return false;
     }
 
+    return true;
+}
+
+VkPipelineShaderStageCreateInfo mc_program_get_stage_info(mc_Program* program) {
     VkPipelineShaderStageCreateInfo shaderStageInfo = {0};
     shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
     shaderStageInfo.module = program->shaderModule;
     shaderStageInfo.pName = program->entryPoint;
+    return shaderStageInfo;
+}
 
-    VkComputePipelineCreateInfo computePipelineInfo = {0};
-    computePipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    computePipelineInfo.stage = shaderStageInfo;
-    computePipelineInfo.layout = program->pipelineLayout;
-
-    if (vkCreateComputePipelines(
-            program->device->dev,
-            0,
-            1,
-            &computePipelineInfo,
-            NULL,
-            &program->pipeline
-        )) {
-        ERROR(program, "failed to create compute pipeline");
-        return;
+mc_Pipeline* mc_program_add_pipeline(
+    mc_Program* program,
+    mc_Pipeline pipeline
+) {
+    mtx_lock(&program->pipelineLock);
+
+    // another thread might have created the same pipeline in the meantime
+    for (uint32_t i = 0; i < program->pipelineCount; i++) {
+        if (program->pipelines[i]->buffCount == pipeline.buffCount) {
+            mc_Pipeline* existing = program->pipelines[i];
+            mtx_unlock(&program->pipelineLock);
+            mc_program_destroy_pipeline(program, &pipeline);
+            return existing;
+        }
     }
 
-    VkDescriptorPoolSize descPoolSize = {0};
-    descPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    descPoolSize.descriptorCount = program->buffCount;
-
-    VkDescriptorPoolCreateInfo descPoolInfo = {0};
-    descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descPoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    descPoolInfo.maxSets = 1;
-    descPoolInfo.poolSizeCount = 1;
-    descPoolInfo.pPoolSizes = &descPoolSize;
+    mc_Pipeline* new = malloc(sizeof *new);
+    *new = pipeline;
 
-    if (vkCreateDescriptorPool(
-            program->device->dev,
-            &descPoolInfo,
-            NULL,
-            &program->descPool
-        )) {
-        ERROR(program, "failed to create descriptor pool");
-        return;
-    }
+    program->pipelines = realloc(
+        program->pipelines,
+        sizeof *program->pipelines * (program->pipelineCount + 1)
+    );
+    program->pipelines[program->pipelineCount++] = new;
 
-    VkDescriptorSetAllocateInfo descAllocInfo = {0};
-    descAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descAllocInfo.descriptorPool = program->descPool;
-    descAllocInfo.descriptorSetCount = 1;
-    descAllocInfo.pSetLayouts = &program->descSetLayout;
+    mtx_unlock(&program->pipelineLock);
+    return new;
+}
 
-    if (vkAllocateDescriptorSets(
-            program->device->dev,
-            &descAllocInfo,
-            &program->descSet
-        )) {
-        ERROR(program, "failed to allocate descriptor sets");
-        return;
+mc_Pipeline* mc_program_find_pipeline(mc_Program* program, int32_t buffCount) {
+    mc_Pipeline* pipeline = NULL;
+    mtx_lock(&program->pipelineLock);
+    for (uint32_t i = 0; i < program->pipelineCount && !pipeline; i++) {
+        if (program->pipelines[i]->buffCount == buffCount)
+            pipeline = program->pipelines[i];
     }
+    mtx_unlock(&program->pipelineLock);
+    return pipeline;
+}
 
-    VkCommandPoolCreateInfo cmdPoolInfo = {0};
-    cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    cmdPoolInfo.queueFamilyIndex = program->device->queueFamilyIdx;
+VkPipelineCreateFlags mc_program_get_pipeline_flags(mc_Program* program) {
+    // allows non-zero bases in vkCmdDispatchBase()
+    if (program->device->cmdDispatchBase)
+        return VK_PIPELINE_CREATE_DISPATCH_BASE_BIT;
+    return 0;
+}
 
-    if (vkCreateCommandPool(
-            program->device->dev,
-            &cmdPoolInfo,
-            NULL,
-            &program->cmdPool
-        )) {
-        ERROR(program, "failed to create command pool");
-        return;
-    }
+mc_Pipeline* mc_program_get_pipeline(mc_Program* program, int32_t buffCount) {
+    mc_Pipeline* existing = mc_program_find_pipeline(program, buffCount);
+    if (existing) return existing;
 
-    VkDescriptorBufferInfo* descBuffInfo
-        = malloc(sizeof *descBuffInfo * program->buffCount);
-    VkWriteDescriptorSet* wrtDescSet
-        = malloc(sizeof *wrtDescSet * program->buffCount);
-
-    for (int32_t i = 0; i < program->buffCount; i++) {
-        mc_Buffer* buffer = program->buffs[i];
-        DEBUG(program, "- buffer %d: size=%ld", i, mc_buffer_get_size(buffer));
-
-        descBuffInfo[i] = (VkDescriptorBufferInfo){0};
-        descBuffInfo[i].buffer = buffer->buf;
-        descBuffInfo[i].range = VK_WHOLE_SIZE;
-
-        wrtDescSet[i] = (VkWriteDescriptorSet){0};
-        wrtDescSet[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        wrtDescSet[i].dstSet = program->descSet;
-        wrtDescSet[i].dstBinding = i;
-        wrtDescSet[i].descriptorCount = 1;
-        wrtDescSet[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        wrtDescSet[i].pBufferInfo = &descBuffInfo[i];
-    }
+    DEBUG(program, "creating pipeline for %d buffer(s)", buffCount);
 
-    vkUpdateDescriptorSets(
-        program->device->dev,
-        program->buffCount,
-        wrtDescSet,
-        0,
-        NULL
-    );
-    free(descBuffInfo);
-    free(wrtDescSet);
+    mc_Pipeline pipeline;
+    if (!mc_program_create_layouts(program, buffCount, &pipeline)) return NULL;
 
-    VkCommandBufferAllocateInfo cmdBuffAllocInfo = {0};
-    cmdBuffAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmdBuffAllocInfo.commandPool = program->cmdPool;
-    cmdBuffAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmdBuffAllocInfo.commandBufferCount = 1;
+    VkComputePipelineCreateInfo computePipelineInfo = {0};
+    computePipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computePipelineInfo.stage = mc_program_get_stage_info(program);
+    computePipelineInfo.layout = pipeline.pipelineLayout;
+    computePipelineInfo.flags = mc_program_get_pipeline_flags(program);
 
-    if (vkAllocateCommandBuffers(
+    if (vkCreateComputePipelines(
             program->device->dev,
-            &cmdBuffAllocInfo,
-            &program->cmdBuff
+            program->device->pipelineCache,
+            1,
+            &computePipelineInfo,
+            NULL,
+            &pipeline.pipeline
         )) {
-        ERROR(program, "failed to allocate command buffers");
-        return;
+        ERROR(program, "failed to create compute pipeline");
+        mc_program_destroy_pipeline(program, &pipeline);
+        return NULL;
     }
 
-    VkCommandBufferBeginInfo cmdBuffBeginInfo = {0};
-    cmdBuffBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    return mc_program_add_pipeline(program, pipeline);
+}
 
-    if (vkBeginCommandBuffer(program->cmdBuff, &cmdBuffBeginInfo)) {
-        ERROR(program, "failed to begin command buffer");
-        return;
-    }
+void mc_program_destroy_pipeline(mc_Program* program, mc_Pipeline* pipeline) {
+    VkDevice dev = program->device->dev;
+    if (pipeline->pipeline) //
+        vkDestroyPipeline(dev, pipeline->pipeline, NULL);
+    if (pipeline->pipelineLayout)
+        vkDestroyPipelineLayout(dev, pipeline->pipelineLayout, NULL);
+    if (pipeline->descSetLayout)
+        vkDestroyDescriptorSetLayout(dev, pipeline->descSetLayout, NULL);
+}
 
-    vkCmdBindPipeline(
-        program->cmdBuff,
-        VK_PIPELINE_BIND_POINT_COMPUTE,
-        program->pipeline
-    );
+mc_Program* mc_program_get_builtin(
+    mc_Device* device,
+    const char* name,
+    const char* source
+) {
+    mtx_lock(&device->builtinLock);
 
-    vkCmdBindDescriptorSets(
-        program->cmdBuff,
-        VK_PIPELINE_BIND_POINT_COMPUTE,
-        program->pipelineLayout,
-        0,
-        1,
-        &program->descSet,
-        0,
-        NULL
-    );
+    for (uint32_t i = 0; i < device->builtinCount; i++) {
+        if (strcmp(device->builtins[i].name, name) == 0) {
+            mc_Program* program = device->builtins[i].program;
+            mtx_unlock(&device->builtinLock);
+            return program;
+        }
+    }
 
-    vkCmdDispatch(
-        program->cmdBuff,
-        program->dim[0],
-        program->dim[1],
-        program->dim[2]
+    // compile while holding the lock, so that a builtin is only compiled once
+    mc_ProgramCode* code = mc_program_code_create_from_glsl(
+        device->_instance,
+        name,
+        source,
+        "main"
     );
-    if (vkEndCommandBuffer(program->cmdBuff)) {
-        ERROR(program, "failed to end command buffer");
-        return;
+    mc_Program* program = mc_program_create(device, code);
+    mc_program_code_destroy(code);
+
+    if (program) {
+        device->builtins = realloc(
+            device->builtins,
+            sizeof *device->builtins * (device->builtinCount + 1)
+        );
+        // the name is copied, so that sized variants can use built names
+        char* nameCopy = malloc(strlen(name) + 1);
+        strcpy(nameCopy, name);
+        device->builtins[device->builtinCount++] = (mc_Builtin){
+            .name = nameCopy,
+            .program = program,
+        };
     }
+
+    mtx_unlock(&device->builtinLock);
+    return program;
 }
 
 mc_Program* mc_program_create(mc_Device* device, mc_ProgramCode* code) {
@@ -243,21 +225,23 @@ mc_Program* mc_program_create(mc_Device* device, mc_ProgramCode* code) {
     mc_Program* program = malloc(sizeof *program);
     *program = (mc_Program){
         ._instance = device->_instance,
-        .entryPoint = code->entry,
+        .entryPoint = NULL,
         .device = device,
         .dim = {1, 1, 1},
         .buffCount = -1,
+        .buffCap = 0,
         .buffs = NULL,
         .shaderModule = NULL,
-        .descSetLayout = NULL,
-        .pipelineLayout = NULL,
-        .pipeline = NULL,
-        .descPool = NULL,
-        .descSet = NULL,
-        .cmdPool = NULL,
-        .cmdBuff = NULL,
+        .pipelineCount = 0,
+        .pipelines = NULL,
+        .dispatch = NULL,
     };
 
+    mtx_init(&program->pipelineLock, mtx_plain);
+
+    program->entryPoint = malloc(strlen(code->entry) + 1);
+    memcpy(program->entryPoint, code->entry, strlen(code->entry) + 1);
+
     VkShaderModuleCreateInfo moduleInfo = {0};
     moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     moduleInfo.codeSize = code->size;
@@ -281,13 +265,21 @@ void mc_program_destroy(mc_Program* program) {
     if (!program) return;
     DEBUG(program, "destroying program");
 
-    mc_program_clear(program);
+    mc_dispatch_destroy(program->dispatch);
+    for (uint32_t i = 0; i < program->pipelineCount; i++) {
+        mc_program_destroy_pipeline(program, program->pipelines[i]);
+        free(program->pipelines[i]);
+    }
     if (program->shaderModule)
         vkDestroyShaderModule(
             program->device->dev,
             program->shaderModule,
             NULL
         );
+    mtx_destroy(&program->pipelineLock);
+    free(program->pipelines);
+    free(program->buffs);
+    free(program->entryPoint);
     free(program);
 }
 
@@ -306,68 +298,52 @@ double mc_program_run__(
         return -1.0;
     }
 
-    bool configChanged = false;
-
     // check if the dimensions have been changed
-    if (dimX != program->dim[0] || dimY != program->dim[1]
-        || dimZ != program->dim[2]) {
-        program->dim[0] = dimX;
-        program->dim[1] = dimY;
-        program->dim[2] = dimZ;
-        configChanged = true;
-    }
+    bool configChanged = dimX != program->dim[0] || dimY != program->dim[1]
+                      || dimZ != program->dim[2];
+    program->dim[0] = dimX;
+    program->dim[1] = dimY;
+    program->dim[2] = dimZ;
 
-    // check if the buffers have been changed
+    // collect the buffers, checking if they have been changed
     int32_t buffCount = 0;
+    mc_Buffer* buff;
     va_list args;
     va_start(args, dimZ);
-    while (va_arg(args, mc_Buffer*)) buffCount++;
-    va_end(args);
-
-    if (buffCount != program->buffCount) configChanged = true;
-
-    if (buffCount != program->buffCount) {
-        program->buffCount = buffCount;
-        program->buffs
-            = realloc(program->buffs, sizeof *program->buffs * buffCount);
-        memset(program->buffs, 0, sizeof *program->buffs * buffCount);
-    }
-
-    va_start(args, dimZ);
-    for (int32_t i = 0; i < buffCount; i++) {
-        mc_Buffer* buff = va_arg(args, mc_Buffer*);
-        if (buff != program->buffs[i]) {
-            program->buffs[i] = buff;
-            configChanged = true;
+    while ((buff = va_arg(args, mc_Buffer*))) {
+        if (buffCount == program->buffCap) {
+            program->buffCap = program->buffCap ? program->buffCap * 2 : 4;
+            program->buffs = realloc(
+                program->buffs,
+                sizeof *program->buffs * program->buffCap
+            );
         }
+        bool same = buffCount < program->buffCount
+                 && buff == program->buffs[buffCount];
+        if (!same) configChanged = true;
+        program->buffs[buffCount++] = buff;
     }
     va_end(args);
 
-    if (configChanged) mc_program_setup(program);
-
-    VkQueue queue;
-    vkGetDeviceQueue(
-        program->device->dev,
-        program->device->queueFamilyIdx,
-        0,
-        &queue
-    );
-
-    VkSubmitInfo submitInfo = {0};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &program->cmdBuff;
-
-    if (vkQueueSubmit(queue, 1, &submitInfo, 0)) {
-        ERROR(program, "failed to submit queue");
-        return -1.0;
+    if (buffCount != program->buffCount) configChanged = true;
+    program->buffCount = buffCount;
+
+    if (configChanged) {
+        mc_dispatch_destroy(program->dispatch);
+        program->dispatch = mc_program_prepare(
+            program,
+            dimX,
+            dimY,
+            dimZ,
+            (uint32_t)buffCount,
+            program->buffs
+        );
     }
 
-    double startTime = mc_get_time();
-    if (vkQueueWaitIdle(queue)) {
-        ERROR(program, "failed to wait for queue completion");
+    if (!program->dispatch) {
+        program->buffCount = -1; // force a new setup on the next run
         return -1.0;
     }
 
-    return mc_get_time() - startTime;
-}
\ No newline at end of file
+    return mc_dispatch_submit(program->dispatch);
+}
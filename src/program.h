@@ -1,25 +1,60 @@
 #ifndef MC_PROGRAM_H
 #define MC_PROGRAM_H
 
+#include <threads.h>
 #include <vulkan/vulkan.h>
 
 #include "microcompute.h"
 
+// the size of the push constant range of every pipeline layout (the minimum
+// guaranteed by vulkan)
+#define MC_PUSH_CONSTANT_SIZE 128
+
+// a pipeline of a program, for a given number of buffers
+typedef struct mc_Pipeline {
+    int32_t buffCount;
+    VkDescriptorSetLayout descSetLayout;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+} mc_Pipeline;
+
 struct mc_Program {
     mc_Instance* _instance;
-    const char* entryPoint;
+    char* entryPoint;
     mc_Device* device;
     uint32_t dim[3];
     int32_t buffCount;
+    int32_t buffCap;
     mc_Buffer** buffs;
     VkShaderModule shaderModule;
-    VkDescriptorSetLayout descSetLayout;
-    VkPipelineLayout pipelineLayout;
-    VkPipeline pipeline;
-    VkDescriptorPool descPool;
-    VkDescriptorSet descSet;
-    VkCommandPool cmdPool;
-    VkCommandBuffer cmdBuff;
+    mtx_t pipelineLock;
+    uint32_t pipelineCount;
+    mc_Pipeline** pipelines;
+    mc_Dispatch* dispatch; // the dispatch used by mc_program_run()
 };
 
-#endif // MC_PROGRAM_H
\ No newline at end of file
+bool mc_program_create_layouts(
+    mc_Program* program,
+    int32_t buffCount,
+    mc_Pipeline* pipeline
+);
+
+VkPipelineShaderStageCreateInfo mc_program_get_stage_info(mc_Program* program);
+
+VkPipelineCreateFlags mc_program_get_pipeline_flags(mc_Program* program);
+
+mc_Pipeline* mc_program_add_pipeline(mc_Program* program, mc_Pipeline pipeline);
+
+mc_Pipeline* mc_program_find_pipeline(mc_Program* program, int32_t buffCount);
+
+mc_Pipeline* mc_program_get_pipeline(mc_Program* program, int32_t buffCount);
+
+void mc_program_destroy_pipeline(mc_Program* program, mc_Pipeline* pipeline);
+
+mc_Program* mc_program_get_builtin(
+    mc_Device* device,
+    const char* name,
+    const char* source
+);
+
+#endif // MC_PROGRAM_H
@@ -4,9 +4,39 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "glsl_include.h"
 #include "log.h"
 #include "program_code.h"
 
+static shaderc_include_result* mc_include_resolve(
+    void* arg,
+    const char* requested,
+    int type,
+    const char* requesting,
+    size_t depth
+) {
+    shaderc_include_result* result = malloc(sizeof *result);
+    *result = (shaderc_include_result){0};
+
+    const mc_GlslInclude* include = mc_glsl_include_find(requested);
+    if (include) {
+        result->source_name = include->name;
+        result->source_name_length = strlen(include->name);
+        result->content = include->source;
+        result->content_length = strlen(include->source);
+    } else {
+        // an empty source name signals an error, content is the message
+        result->content = "unknown microcompute include";
+        result->content_length = strlen(result->content);
+    }
+
+    return result;
+}
+
+static void mc_include_release(void* arg, shaderc_include_result* result) {
+    free(result);
+}
+
 mc_ProgramCode* mc_program_code_create_from_spirv(
     mc_Instance* instance,
     size_t size,
@@ -17,6 +47,7 @@ mc_ProgramCode* mc_program_code_create_from_spirv(
     mc_ProgramCode* programCode = malloc(sizeof *programCode);
     *programCode = (mc_ProgramCode){
         ._instance = instance,
+        .entry = NULL,
         .size = size,
         .code = NULL,
     };
@@ -27,8 +58,12 @@ mc_ProgramCode* mc_program_code_create_from_spirv(
         programCode->size
     );
 
+    programCode->code = malloc(programCode->size);
     memcpy(programCode->code, code, programCode->size);
 
+    programCode->entry = malloc(sizeof "main");
+    memcpy(programCode->entry, "main", sizeof "main");
+
     return programCode;
 }
 
@@ -38,6 +73,40 @@ mc_ProgramCode* mc_program_code_create_from_glsl__(
     const char* code,
     const char* entry,
     ...
+) {
+    uint32_t defCount = 0;
+    mc_CompileDefinition* defs = NULL;
+
+    va_list args;
+    va_start(args, entry);
+    while (true) {
+        mc_CompileDefinition def = va_arg(args, mc_CompileDefinition);
+        if (!def.key || !def.value) break;
+        defs = realloc(defs, sizeof *defs * (defCount + 1));
+        defs[defCount++] = def;
+    }
+    va_end(args);
+
+    mc_ProgramCode* programCode = mc_program_code_create_from_glsl_defs(
+        instance,
+        name,
+        code,
+        entry,
+        defCount,
+        defs
+    );
+
+    free(defs);
+    return programCode;
+}
+
+mc_ProgramCode* mc_program_code_create_from_glsl_defs(
+    mc_Instance* instance,
+    const char* name,
+    const char* code,
+    const char* entry,
+    uint32_t defCount,
+    const mc_CompileDefinition* defs
 ) {
     if (!instance) return NULL;
 
@@ -75,11 +144,8 @@ mc_ProgramCode* mc_program_code_create_from_glsl__(
         return NULL;
     }
 
-    va_list args;
-    va_start(args, entry);
-    while (true) {
-        mc_CompileDefinition option = va_arg(args, mc_CompileDefinition);
-        if (!option.key || !option.value) break;
+    for (uint32_t i = 0; i < defCount; i++) {
+        mc_CompileDefinition option = defs[i];
 
         DEBUG(
             programCode,
@@ -96,13 +162,19 @@ mc_ProgramCode* mc_program_code_create_from_glsl__(
             strlen(option.value)
         );
     }
-    va_end(args);
 
     shaderc_compile_options_set_optimization_level(
         options,
         shaderc_optimization_level_performance
     );
 
+    shaderc_compile_options_set_include_callbacks(
+        options,
+        mc_include_resolve,
+        mc_include_release,
+        NULL
+    );
+
     shaderc_compiler_t compiler = shaderc_compiler_initialize();
     if (!compiler) {
         ERROR(programCode, "failed to initialize shader compiler");
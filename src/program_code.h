@@ -10,4 +10,14 @@ typedef struct mc_ProgramCode {
     char* code;
 } mc_ProgramCode;
 
+// same as mc_program_code_create_from_glsl(), with the definitions in an array
+mc_ProgramCode* mc_program_code_create_from_glsl_defs(
+    mc_Instance* instance,
+    const char* name,
+    const char* code,
+    const char* entry,
+    uint32_t defCount,
+    const mc_CompileDefinition* defs
+);
+
 #endif // PROGRAM_CODE_H
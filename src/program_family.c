@@ -0,0 +1,373 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "device.h"
+#include "log.h"
+#include "program.h"
+#include "program_family.h"
+
+static char* mc_copy_string(const char* str) {
+    char* copy = malloc(strlen(str) + 1);
+    memcpy(copy, str, strlen(str) + 1);
+    return copy;
+}
+
+// must be called with the lock held
+static mc_Variant* mc_program_family_find(
+    mc_ProgramFamily* family,
+    const int32_t* values
+) {
+    size_t size = sizeof *values * family->keyCount;
+    for (uint32_t i = 0; i < family->variantCount; i++) {
+        mc_Variant* variant = family->variants[i];
+        if (!memcmp(variant->values, values, size)) return variant;
+    }
+    return NULL;
+}
+
+// called without the lock held, only by the thread that set the variant to
+// `MC_VARIANT_COMPILING`
+static mc_Program* mc_program_family_build(
+    mc_ProgramFamily* family,
+    mc_Variant* variant
+) {
+    if (!variant->code) {
+        DEBUG(family, "compiling a variant of program family %s", family->name);
+
+        char(*strs)[16] = malloc(sizeof *strs * (family->keyCount + 1));
+        mc_CompileDefinition* defs = malloc(
+            sizeof *defs * (family->keyCount + 1)
+        );
+        for (uint32_t i = 0; i < family->keyCount; i++) {
+            snprintf(strs[i], sizeof strs[i], "%" PRId32, variant->values[i]);
+            defs[i] = (mc_CompileDefinition){family->keys[i], strs[i]};
+        }
+
+        variant->code = mc_program_code_create_from_glsl_defs(
+            family->_instance,
+            family->name,
+            family->code,
+            family->entry,
+            family->keyCount,
+            defs
+        );
+
+        free(defs);
+        free(strs);
+        if (!variant->code) return NULL;
+    }
+
+    mc_Program* program = mc_program_create(family->device, variant->code);
+    if (!program) return NULL;
+
+    // create the pipeline as well, so that the first run does not block
+    if (family->buffCount
+        && !mc_program_get_pipeline(program, family->buffCount)) {
+        mc_program_destroy(program);
+        return NULL;
+    }
+
+    return program;
+}
+
+// evict the least recently used programs that are not in use, until at most
+// `maxLive` are left. must be called with the lock held, and the returned
+// programs destroyed once the lock is released
+static uint32_t mc_program_family_evict(
+    mc_ProgramFamily* family,
+    mc_Program** evicted
+) {
+    uint32_t count = 0;
+    while (family->maxLive && family->liveCount > family->maxLive) {
+        mc_Variant* oldest = NULL;
+        for (uint32_t i = 0; i < family->variantCount; i++) {
+            mc_Variant* variant = family->variants[i];
+            if (variant->state != MC_VARIANT_READY) continue;
+            if (!variant->program || variant->pins) continue;
+            if (!oldest || variant->lastUse < oldest->lastUse) oldest = variant;
+        }
+        if (!oldest) break;
+
+        evicted[count++] = oldest->program;
+        oldest->program = NULL;
+        family->liveCount--;
+    }
+    return count;
+}
+
+static void mc_program_family_destroy_evicted(
+    mc_ProgramFamily* family,
+    uint32_t count,
+    mc_Program** evicted
+) {
+    for (uint32_t i = 0; i < count; i++) {
+        DEBUG(family, "evicting a variant of program family %s", family->name);
+        mc_program_destroy(evicted[i]);
+    }
+    free(evicted);
+}
+
+static mc_Program* mc_program_family_acquire(
+    mc_ProgramFamily* family,
+    const int32_t* values,
+    bool pin
+) {
+    mtx_lock(&family->lock);
+
+    mc_Variant* variant = mc_program_family_find(family, values);
+    if (!variant) {
+        variant = malloc(sizeof *variant);
+        *variant = (mc_Variant){
+            .values = malloc(sizeof *values * (family->keyCount + 1)),
+            .state = MC_VARIANT_COMPILING,
+            .code = NULL,
+            .program = NULL,
+            .pins = 0,
+            .lastUse = 0,
+        };
+        memcpy(variant->values, values, sizeof *values * family->keyCount);
+
+        family->variants = realloc(
+            family->variants,
+            sizeof *family->variants * (family->variantCount + 1)
+        );
+        family->variants[family->variantCount++] = variant;
+    } else {
+        // another thread is compiling the same variant, wait for it instead of
+        // compiling it twice
+        while (variant->state == MC_VARIANT_COMPILING)
+            cnd_wait(&family->compiled, &family->lock);
+
+        if (variant->state == MC_VARIANT_READY && !variant->program)
+            variant->state = MC_VARIANT_COMPILING;
+    }
+
+    if (variant->state == MC_VARIANT_COMPILING) {
+        mtx_unlock(&family->lock);
+        mc_Program* program = mc_program_family_build(family, variant);
+        mtx_lock(&family->lock);
+
+        variant->program = program;
+        variant->state = program ? MC_VARIANT_READY : MC_VARIANT_FAILED;
+        if (program) family->liveCount++;
+        cnd_broadcast(&family->compiled);
+    }
+
+    mc_Program* program = variant->program;
+    if (program) {
+        variant->lastUse = ++family->useClock;
+        if (pin) variant->pins++;
+    }
+
+    mc_Program** evicted = malloc(sizeof *evicted * (family->liveCount + 1));
+    uint32_t evictedCount = mc_program_family_evict(family, evicted);
+
+    mtx_unlock(&family->lock);
+    mc_program_family_destroy_evicted(family, evictedCount, evicted);
+
+    if (!program) ERROR(family, "failed to build program variant");
+    return program;
+}
+
+static int mc_program_family_prefetch_worker(void* arg) {
+    mc_ProgramFamily* family = arg;
+    int32_t* values = malloc(sizeof *values * (family->keyCount + 1));
+
+    mtx_lock(&family->lock);
+    while (true) {
+        while (!family->stopping && !family->prefetchCount)
+            cnd_wait(&family->queued, &family->lock);
+        if (family->stopping) break;
+
+        size_t size = sizeof *values * family->keyCount;
+        family->prefetchCount--;
+        memcpy(values, family->prefetchValues, size);
+        memmove(
+            family->prefetchValues,
+            family->prefetchValues + family->keyCount,
+            size * family->prefetchCount
+        );
+
+        mtx_unlock(&family->lock);
+        mc_program_family_acquire(family, values, false);
+        mtx_lock(&family->lock);
+    }
+    mtx_unlock(&family->lock);
+
+    free(values);
+    return 0;
+}
+
+mc_ProgramFamily* mc_program_family_create(
+    mc_Device* device,
+    const char* name,
+    const char* code,
+    const char* entry,
+    uint32_t keyCount,
+    const char** keys,
+    uint32_t buffCount,
+    uint32_t maxLive
+) {
+    if (!device) return NULL;
+
+    mc_ProgramFamily* family = malloc(sizeof *family);
+    *family = (mc_ProgramFamily){
+        ._instance = device->_instance,
+        .device = device,
+        .name = NULL,
+        .code = NULL,
+        .entry = NULL,
+        .keyCount = keyCount,
+        .keys = NULL,
+        .buffCount = buffCount,
+        .maxLive = maxLive,
+        .useClock = 0,
+        .liveCount = 0,
+        .variantCount = 0,
+        .variants = NULL,
+        .prefetchCount = 0,
+        .prefetchCap = 0,
+        .prefetchValues = NULL,
+        .prefetchRunning = false,
+        .stopping = false,
+    };
+
+    mtx_init(&family->lock, mtx_plain);
+    cnd_init(&family->compiled);
+    cnd_init(&family->queued);
+
+    DEBUG(family, "creating program family %s", name);
+
+    if (!name || !code || !entry || (keyCount && !keys)) {
+        ERROR(family, "name, code, entry and keys must not be NULL");
+        mc_program_family_destroy(family);
+        return NULL;
+    }
+
+    family->name = mc_copy_string(name);
+    family->code = mc_copy_string(code);
+    family->entry = mc_copy_string(entry);
+    family->keys = malloc(sizeof *family->keys * (keyCount + 1));
+    for (uint32_t i = 0; i < keyCount; i++)
+        family->keys[i] = mc_copy_string(keys[i]);
+
+    return family;
+}
+
+void mc_program_family_destroy(mc_ProgramFamily* family) {
+    if (!family) return;
+    DEBUG(family, "destroying program family");
+
+    mtx_lock(&family->lock);
+    family->stopping = true;
+    cnd_broadcast(&family->queued);
+    mtx_unlock(&family->lock);
+    if (family->prefetchRunning) thrd_join(family->prefetchThread, NULL);
+
+    for (uint32_t i = 0; i < family->variantCount; i++) {
+        mc_Variant* variant = family->variants[i];
+        mc_program_destroy(variant->program);
+        mc_program_code_destroy(variant->code);
+        free(variant->values);
+        free(variant);
+    }
+
+    if (family->keys)
+        for (uint32_t i = 0; i < family->keyCount; i++) free(family->keys[i]);
+
+    cnd_destroy(&family->queued);
+    cnd_destroy(&family->compiled);
+    mtx_destroy(&family->lock);
+    free(family->prefetchValues);
+    free(family->variants);
+    free(family->keys);
+    free(family->entry);
+    free(family->code);
+    free(family->name);
+    free(family);
+}
+
+mc_Program* mc_program_family_get(
+    mc_ProgramFamily* family,
+    const int32_t* values
+) {
+    if (!family) return NULL;
+    if (family->keyCount && !values) {
+        ERROR(family, "values is NULL");
+        return NULL;
+    }
+    return mc_program_family_acquire(family, values, true);
+}
+
+void mc_program_family_release(mc_ProgramFamily* family, mc_Program* program) {
+    if (!family || !program) return;
+
+    mtx_lock(&family->lock);
+    for (uint32_t i = 0; i < family->variantCount; i++) {
+        mc_Variant* variant = family->variants[i];
+        if (variant->program == program && variant->pins) variant->pins--;
+    }
+
+    mc_Program** evicted = malloc(sizeof *evicted * (family->liveCount + 1));
+    uint32_t evictedCount = mc_program_family_evict(family, evicted);
+
+    mtx_unlock(&family->lock);
+    mc_program_family_destroy_evicted(family, evictedCount, evicted);
+}
+
+bool mc_program_family_prefetch(
+    mc_ProgramFamily* family,
+    uint32_t count,
+    const int32_t* values
+) {
+    if (!family) return false;
+    if (count && family->keyCount && !values) {
+        ERROR(family, "values is NULL");
+        return false;
+    }
+
+    mtx_lock(&family->lock);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const int32_t* tuple = values + (size_t)i * family->keyCount;
+        mc_Variant* variant = mc_program_family_find(family, tuple);
+        if (variant && variant->program) continue;
+        if (variant && variant->state != MC_VARIANT_READY) continue;
+
+        if (family->prefetchCount == family->prefetchCap) {
+            family->prefetchCap = family->prefetchCap * 2 + 8;
+            family->prefetchValues = realloc(
+                family->prefetchValues,
+                sizeof *values * (family->keyCount * family->prefetchCap + 1)
+            );
+        }
+
+        memcpy(
+            family->prefetchValues + family->prefetchCount * family->keyCount,
+            tuple,
+            sizeof *values * family->keyCount
+        );
+        family->prefetchCount++;
+    }
+
+    if (!family->prefetchRunning && family->prefetchCount) {
+        if (thrd_create(
+                &family->prefetchThread,
+                mc_program_family_prefetch_worker,
+                family
+            )
+            != thrd_success) {
+            ERROR(family, "failed to start prefetch thread");
+            family->prefetchCount = 0;
+            mtx_unlock(&family->lock);
+            return false;
+        }
+        family->prefetchRunning = true;
+    }
+
+    cnd_broadcast(&family->queued);
+    mtx_unlock(&family->lock);
+    return true;
+}
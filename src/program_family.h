@@ -0,0 +1,51 @@
+#ifndef MC_PROGRAM_FAMILY_H
+#define MC_PROGRAM_FAMILY_H
+
+#include <stdbool.h>
+#include <threads.h>
+
+#include "microcompute.h"
+#include "program_code.h"
+
+typedef enum mc_VariantState {
+    MC_VARIANT_COMPILING,
+    MC_VARIANT_READY,
+    MC_VARIANT_FAILED,
+} mc_VariantState;
+
+// a variant of a program family, for one tuple of definition values
+typedef struct mc_Variant {
+    int32_t* values;
+    mc_VariantState state;
+    mc_ProgramCode* code; // kept when the program is evicted, to skip compiling
+    mc_Program* program;  // `NULL` while evicted
+    uint32_t pins;
+    uint64_t lastUse;
+} mc_Variant;
+
+struct mc_ProgramFamily {
+    mc_Instance* _instance;
+    mc_Device* device;
+    char* name;
+    char* code;
+    char* entry;
+    uint32_t keyCount;
+    char** keys;
+    uint32_t buffCount;
+    uint32_t maxLive;
+    mtx_t lock;
+    cnd_t compiled; // signaled when a variant finishes compiling
+    cnd_t queued;   // signaled when variants are queued for prefetching
+    uint64_t useClock;
+    uint32_t liveCount;
+    uint32_t variantCount;
+    mc_Variant** variants;
+    uint32_t prefetchCount; // prefetch queue, `keyCount` values per entry
+    uint32_t prefetchCap;
+    int32_t* prefetchValues;
+    bool prefetchRunning;
+    bool stopping;
+    thrd_t prefetchThread;
+};
+
+#endif // MC_PROGRAM_FAMILY_H
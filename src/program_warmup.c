@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "device.h"
+#include "log.h"
+#include "program_warmup.h"
+
+// the max number of pipelines created per vkCreateComputePipelines() call
+#define MC_WARMUP_BATCH_SIZE 8
+
+// the max number of background threads per warmup
+#define MC_WARMUP_MAX_THREADS 4
+
+static void mc_program_warmup_batch(mc_ProgramWarmup* warmup, uint32_t idx) {
+    uint32_t start = warmup->batchStarts[idx];
+    uint32_t count = warmup->batchStarts[idx + 1] - start;
+    mc_WarmupJob* jobs = &warmup->jobs[start];
+    mc_Device* device = jobs[0].program->device;
+
+    VkComputePipelineCreateInfo infos[MC_WARMUP_BATCH_SIZE];
+    VkPipeline pipelines[MC_WARMUP_BATCH_SIZE];
+    mc_WarmupJob* infoJobs[MC_WARMUP_BATCH_SIZE];
+    uint32_t infoCount = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        mc_WarmupJob* job = &jobs[i];
+        if (!mc_program_create_layouts(
+                job->program,
+                job->pipeline.buffCount,
+                &job->pipeline
+            )) {
+            atomic_store(&warmup->failed, true);
+            continue;
+        }
+
+        infos[infoCount] = (VkComputePipelineCreateInfo){0};
+        infos[infoCount].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        infos[infoCount].stage = mc_program_get_stage_info(job->program);
+        infos[infoCount].layout = job->pipeline.pipelineLayout;
+        infos[infoCount].flags = mc_program_get_pipeline_flags(job->program);
+        pipelines[infoCount] = NULL;
+        infoJobs[infoCount] = job;
+        infoCount++;
+    }
+
+    if (infoCount == 0) return;
+
+    if (vkCreateComputePipelines(
+            device->dev,
+            device->pipelineCache,
+            infoCount,
+            infos,
+            NULL,
+            pipelines
+        )) {
+        ERROR(warmup, "failed to create some compute pipelines");
+        atomic_store(&warmup->failed, true);
+    }
+
+    // on failure, the pipelines that could be created are still valid
+    for (uint32_t i = 0; i < infoCount; i++) {
+        mc_WarmupJob* job = infoJobs[i];
+        job->pipeline.pipeline = pipelines[i];
+        if (pipelines[i]) mc_program_add_pipeline(job->program, job->pipeline);
+        else mc_program_destroy_pipeline(job->program, &job->pipeline);
+    }
+}
+
+static int mc_program_warmup_worker(void* arg) {
+    mc_ProgramWarmup* warmup = arg;
+
+    while (true) {
+        uint32_t idx = atomic_fetch_add(&warmup->nextBatch, 1);
+        if (idx >= warmup->batchCount) break;
+        mc_program_warmup_batch(warmup, idx);
+        atomic_fetch_add(&warmup->doneBatches, 1);
+    }
+
+    return 0;
+}
+
+mc_ProgramWarmup* mc_program_warmup(
+    mc_Program** programs,
+    uint32_t* buffCounts,
+    uint32_t count
+) {
+    if (!programs || !buffCounts || count == 0) return NULL;
+
+    mc_ProgramWarmup* warmup = malloc(sizeof *warmup);
+    *warmup = (mc_ProgramWarmup){
+        ._instance = programs[0]->_instance,
+        .jobCount = 0,
+        .jobs = malloc(sizeof *warmup->jobs * count),
+        .batchCount = 0,
+        .batchStarts = malloc(sizeof *warmup->batchStarts * (count + 1)),
+        .threadCount = 0,
+        .threads = NULL,
+    };
+    atomic_init(&warmup->nextBatch, 0);
+    atomic_init(&warmup->doneBatches, 0);
+    atomic_init(&warmup->failed, false);
+
+    // group the jobs by device, since a batch can only contain pipelines of a
+    // single device, skipping pipelines that already exist
+    bool* queued = calloc(count, sizeof *queued);
+    for (uint32_t i = 0; i < count; i++) {
+        if (queued[i]) continue;
+        mc_Device* device = programs[i]->device;
+        uint32_t batchSize = MC_WARMUP_BATCH_SIZE;
+
+        for (uint32_t j = i; j < count; j++) {
+            if (queued[j] || programs[j]->device != device) continue;
+            queued[j] = true;
+
+            int32_t buffCount = (int32_t)buffCounts[j];
+            if (mc_program_find_pipeline(programs[j], buffCount)) continue;
+
+            if (batchSize == MC_WARMUP_BATCH_SIZE) {
+                warmup->batchStarts[warmup->batchCount++] = warmup->jobCount;
+                batchSize = 0;
+            }
+
+            warmup->jobs[warmup->jobCount++] = (mc_WarmupJob){
+                .program = programs[j],
+                .pipeline = {.buffCount = buffCount},
+            };
+            batchSize++;
+        }
+    }
+    warmup->batchStarts[warmup->batchCount] = warmup->jobCount;
+    free(queued);
+
+    DEBUG(
+        warmup,
+        "warming up %d pipeline(s) in %d batch(es)",
+        warmup->jobCount,
+        warmup->batchCount
+    );
+
+    uint32_t threadCount = warmup->batchCount < MC_WARMUP_MAX_THREADS
+                             ? warmup->batchCount
+                             : MC_WARMUP_MAX_THREADS;
+    warmup->threads = malloc(sizeof *warmup->threads * (threadCount + 1));
+
+    // if a thread cannot be created, its batches are picked up by the other
+    // threads, or by mc_program_warmup_wait()
+    for (uint32_t i = 0; i < threadCount; i++) {
+        if (thrd_create(
+                &warmup->threads[warmup->threadCount],
+                mc_program_warmup_worker,
+                warmup
+            )
+            != thrd_success) {
+            WARN(warmup, "failed to create warmup thread");
+            break;
+        }
+        warmup->threadCount++;
+    }
+
+    return warmup;
+}
+
+bool mc_program_warmup_is_done(mc_ProgramWarmup* warmup) {
+    if (!warmup) return true;
+    return atomic_load(&warmup->doneBatches) == warmup->batchCount;
+}
+
+bool mc_program_warmup_wait(mc_ProgramWarmup* warmup) {
+    if (!warmup) return false;
+
+    // help with the remaining batches instead of just blocking
+    mc_program_warmup_worker(warmup);
+    for (uint32_t i = 0; i < warmup->threadCount; i++)
+        thrd_join(warmup->threads[i], NULL);
+
+    bool success = !atomic_load(&warmup->failed);
+    DEBUG(warmup, "warmup done");
+
+    free(warmup->threads);
+    free(warmup->batchStarts);
+    free(warmup->jobs);
+    free(warmup);
+    return success;
+}
@@ -0,0 +1,28 @@
+#ifndef MC_PROGRAM_WARMUP_H
+#define MC_PROGRAM_WARMUP_H
+
+#include <stdatomic.h>
+#include <threads.h>
+
+#include "microcompute.h"
+#include "program.h"
+
+typedef struct mc_WarmupJob {
+    mc_Program* program;
+    mc_Pipeline pipeline;
+} mc_WarmupJob;
+
+struct mc_ProgramWarmup {
+    mc_Instance* _instance;
+    uint32_t jobCount;
+    mc_WarmupJob* jobs;
+    uint32_t batchCount;
+    uint32_t* batchStarts; // batch i is jobs[batchStarts[i], batchStarts[i+1])
+    atomic_uint nextBatch;
+    atomic_uint doneBatches;
+    atomic_bool failed;
+    uint32_t threadCount;
+    thrd_t* threads;
+};
+
+#endif // MC_PROGRAM_WARMUP_H
@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "dispatch.h"
+#include "log.h"
+#include "microcompute_extra.h"
+#include "program.h"
+
+// the longest supported row, its elements are kept in registers
+#define MC_ROWWISE_MAX_LENGTH 16384
+
+// the max invocations per workgroup (one workgroup per row)
+#define MC_ROWWISE_WG_SIZE 256
+
+// one workgroup per row: each invocation loads `E` units of the row (a float,
+// or two packed halves) into registers, reduces them with the rest of the
+// workgroup, and writes the results, so the row is read and written once.
+// `N`, `OP`, `HALF`, `WG` and `E` are defined in front of the code
+static const char* rowwiseSource
+    = "#extension GL_EXT_control_flow_attributes : require\n"
+      "layout(local_size_x = WG) in;\n"
+      "layout(std430, binding = 0) buffer inBuff {\n"
+      "    uint inData[];\n"
+      "};\n"
+      "layout(std430, binding = 1) buffer outBuff {\n"
+      "    uint outData[];\n"
+      "};\n"
+      "layout(std430, binding = 2) buffer gammaBuff {\n"
+      "    float gamma[];\n"
+      "};\n"
+      "layout(std430, binding = 3) buffer betaBuff {\n"
+      "    float beta[];\n"
+      "};\n"
+      "layout(push_constant) uniform Push {\n"
+      "    uint rowCount;\n"
+      "    uint hasGamma;\n"
+      "    uint hasBeta;\n"
+      "    float epsilon;\n"
+      "};\n"
+      "#if HALF\n"
+      "#define UNITS (N / 2u)\n"
+      "#define W 2u\n"
+      "#else\n"
+      "#define UNITS N\n"
+      "#define W 1u\n"
+      "#endif\n"
+      "shared float sA[WG];\n"
+      "shared float sB[WG];\n"
+      "// merges the running (max, sum of exp) of two parts of a row\n"
+      "vec2 merge_softmax(vec2 a, vec2 b) {\n"
+      "    float m = max(a.x, b.x);\n"
+      "    float s = (a.x == m ? a.y : a.y * exp(a.x - m))\n"
+      "            + (b.x == m ? b.y : b.y * exp(b.x - m));\n"
+      "    return vec2(m, s);\n"
+      "}\n"
+      "vec2 reduce(vec2 v) {\n"
+      "    uint lane = gl_LocalInvocationID.x;\n"
+      "    sA[lane] = v.x;\n"
+      "    sB[lane] = v.y;\n"
+      "    barrier();\n"
+      "    for (uint off = WG / 2u; off > 0u; off >>= 1) {\n"
+      "        if (lane < off) {\n"
+      "            vec2 a = vec2(sA[lane], sB[lane]);\n"
+      "            vec2 b = vec2(sA[lane + off], sB[lane + off]);\n"
+      "#if OP <= 1\n"
+      "            a = merge_softmax(a, b);\n"
+      "#else\n"
+      "            a += b;\n"
+      "#endif\n"
+      "            sA[lane] = a.x;\n"
+      "            sB[lane] = a.y;\n"
+      "        }\n"
+      "        barrier();\n"
+      "    }\n"
+      "    vec2 r = vec2(sA[0], sB[0]);\n"
+      "    barrier();\n"
+      "    return r;\n"
+      "}\n"
+      "void main(void) {\n"
+      "    uint lane = gl_LocalInvocationID.x;\n"
+      "    uint row = gl_WorkGroupID.y * gl_NumWorkGroups.x\n"
+      "             + gl_WorkGroupID.x;\n"
+      "    if (row >= rowCount) return;\n"
+      "    uint base = row * UNITS;\n"
+      "    float x[E * W];\n"
+      "    [[unroll]] for (uint k = 0u; k < E; k++) {\n"
+      "        uint u = lane + k * WG;\n"
+      "        uint bits = u < UNITS ? inData[base + u] : 0u;\n"
+      "#if HALF\n"
+      "        vec2 v = unpackHalf2x16(bits);\n"
+      "        x[2u * k] = v.x;\n"
+      "        x[2u * k + 1u] = v.y;\n"
+      "#else\n"
+      "        x[k] = uintBitsToFloat(bits);\n"
+      "#endif\n"
+      "    }\n"
+      "#if OP <= 1\n"
+      "    // online softmax: a running max and sum of exp, the sum is\n"
+      "    // rescaled when the max changes\n"
+      "    vec2 ms = vec2(uintBitsToFloat(0xff800000u), 0.0);\n"
+      "    [[unroll]] for (uint i = 0u; i < E * W; i++) {\n"
+      "        if (lane + i / W * WG >= UNITS) continue;\n"
+      "        float v = x[i];\n"
+      "        if (v > ms.x) ms = vec2(v, ms.y * exp(ms.x - v) + 1.0);\n"
+      "        else ms.y += v == ms.x ? 1.0 : exp(v - ms.x);\n"
+      "    }\n"
+      "    ms = reduce(ms);\n"
+      "    float logSum = log(ms.y);\n"
+      "#else\n"
+      "    float sum = 0.0;\n"
+      "    [[unroll]] for (uint i = 0u; i < E * W; i++)\n"
+      "        sum += OP == 3 ? x[i] * x[i] : x[i];\n"
+      "    sum = reduce(vec2(sum, 0.0)).x;\n"
+      "#if OP == 2\n"
+      "    // the variance is reduced from the registers, around the mean\n"
+      "    float mean = sum / float(N);\n"
+      "    float dev = 0.0;\n"
+      "    [[unroll]] for (uint i = 0u; i < E * W; i++) {\n"
+      "        if (lane + i / W * WG < UNITS)\n"
+      "            dev += (x[i] - mean) * (x[i] - mean);\n"
+      "    }\n"
+      "    dev = reduce(vec2(dev, 0.0)).x;\n"
+      "    float scale = inversesqrt(dev / float(N) + epsilon);\n"
+      "#else\n"
+      "    float mean = 0.0;\n"
+      "    float scale = inversesqrt(sum / float(N) + epsilon);\n"
+      "#endif\n"
+      "#endif\n"
+      "    [[unroll]] for (uint i = 0u; i < E * W; i++) {\n"
+      "        uint e = (lane + i / W * WG) * W + i % W;\n"
+      "#if OP == 0\n"
+      "        x[i] = exp(x[i] - ms.x) / ms.y;\n"
+      "#elif OP == 1\n"
+      "        x[i] = x[i] - ms.x - logSum;\n"
+      "#else\n"
+      "        x[i] = (x[i] - mean) * scale;\n"
+      "        if (e < N && hasGamma != 0u) x[i] *= gamma[e];\n"
+      "        if (e < N && hasBeta != 0u) x[i] += beta[e];\n"
+      "#endif\n"
+      "    }\n"
+      "    [[unroll]] for (uint k = 0u; k < E; k++) {\n"
+      "        uint u = lane + k * WG;\n"
+      "        if (u >= UNITS) continue;\n"
+      "#if HALF\n"
+      "        vec2 v = vec2(x[2u * k], x[2u * k + 1u]);\n"
+      "        outData[base + u] = packHalf2x16(v);\n"
+      "#else\n"
+      "        outData[base + u] = floatBitsToUint(x[k]);\n"
+      "#endif\n"
+      "    }\n"
+      "}\n";
+
+typedef struct mc_RowwisePush {
+    uint32_t rowCount;
+    uint32_t hasGamma;
+    uint32_t hasBeta;
+    float epsilon;
+} mc_RowwisePush;
+
+// the operations, as numbered in the kernel
+typedef enum mc_RowwiseOp {
+    MC_ROWWISE_SOFTMAX,
+    MC_ROWWISE_LOG_SOFTMAX,
+    MC_ROWWISE_LAYER_NORM,
+    MC_ROWWISE_RMS_NORM,
+} mc_RowwiseOp;
+
+static const char* mc_rowwise_op_names[] = {
+    "softmax",
+    "log_softmax",
+    "layer_norm",
+    "rms_norm",
+};
+
+// get the variant of the kernel for an operation, row length and format,
+// compiled on first use
+static mc_Program* mc_rowwise_get_program(
+    mc_Device* device,
+    mc_RowwiseOp op,
+    uint32_t length,
+    bool half
+) {
+    // small rows get smaller workgroups
+    uint32_t units = half ? length / 2 : length;
+    uint32_t wgSize = 32;
+    while (wgSize < units && wgSize < MC_ROWWISE_WG_SIZE) wgSize <<= 1;
+    uint32_t perInvocation = (units + wgSize - 1) / wgSize;
+
+    char name[64];
+    snprintf(
+        name,
+        sizeof name,
+        "%s_%d_%s",
+        mc_rowwise_op_names[op],
+        length,
+        half ? "f16" : "f32"
+    );
+
+    char header[128];
+    int headerLen = snprintf(
+        header,
+        sizeof header,
+        "#version 450\n#define N %du\n#define OP %d\n#define HALF %d\n"
+        "#define WG %du\n#define E %du\n",
+        length,
+        op,
+        half,
+        wgSize,
+        perInvocation
+    );
+
+    size_t sourceLen = strlen(rowwiseSource);
+    char* code = malloc(headerLen + sourceLen + 1);
+    memcpy(code, header, headerLen);
+    memcpy(code + headerLen, rowwiseSource, sourceLen + 1);
+
+    mc_Program* program = mc_program_get_builtin(device, name, code);
+    free(code);
+    return program;
+}
+
+static double mc_rowwise_run(
+    mc_RowwiseOp op,
+    mc_Buffer* input,
+    mc_Buffer* output,
+    uint32_t rowCount,
+    uint32_t rowLength,
+    mc_FloatFormat format,
+    mc_Buffer* gamma,
+    mc_Buffer* beta,
+    float epsilon
+) {
+    if (!input || !output) return -1.0;
+    DEBUG(
+        input,
+        "running %s over %d rows of %d",
+        mc_rowwise_op_names[op],
+        rowCount,
+        rowLength
+    );
+
+    bool half = format == MC_FLOAT_FORMAT_F16;
+    if (rowLength == 0 || rowLength > MC_ROWWISE_MAX_LENGTH
+        || (half && rowLength % 2)) {
+        ERROR(
+            input,
+            "row length must be 1 to %d (and even for f16)",
+            MC_ROWWISE_MAX_LENGTH
+        );
+        return -1.0;
+    }
+
+    uint64_t size = (uint64_t)rowCount * rowLength * (half ? 2 : 4);
+    if (input->size < size || output->size < size) {
+        ERROR(input, "input or output buffer too small");
+        return -1.0;
+    }
+
+    uint64_t weightsSize = sizeof(float) * (uint64_t)rowLength;
+    if ((gamma && gamma->size < weightsSize)
+        || (beta && beta->size < weightsSize)) {
+        ERROR(input, "gamma or beta buffer too small");
+        return -1.0;
+    }
+
+    mc_Device* device = input->device;
+    mc_Program* program
+        = mc_rowwise_get_program(device, op, rowLength, half);
+    if (!program) return -1.0;
+    if (rowCount == 0) return 0.0;
+
+    // the rows are spread over y when there are too many for x
+    uint32_t groupsX = rowCount < device->maxWgCount[0]
+                         ? rowCount
+                         : device->maxWgCount[0];
+    uint32_t groupsY = (rowCount + groupsX - 1) / groupsX;
+
+    mc_Buffer* buffs[4] = {
+        input,
+        output,
+        gamma ? gamma : input,
+        beta ? beta : input,
+    };
+    mc_RowwisePush push = {rowCount, gamma != NULL, beta != NULL, epsilon};
+
+    mc_Dispatch* dispatch = mc_dispatch_create(device);
+    bool ok = dispatch
+           && mc_dispatch_add_pushed(
+                  dispatch,
+                  program,
+                  (uint32_t[]){groupsX, groupsY, 1},
+                  4,
+                  buffs,
+                  sizeof push,
+                  &push
+           )
+           && mc_dispatch_finish(dispatch);
+
+    double time = ok ? mc_dispatch_submit(dispatch) : -1.0;
+    mc_dispatch_destroy(dispatch);
+    return time;
+}
+
+double mc_softmax(
+    mc_Buffer* input,
+    mc_Buffer* output,
+    uint32_t rowCount,
+    uint32_t rowLength,
+    mc_FloatFormat format
+) {
+    return mc_rowwise_run(
+        MC_ROWWISE_SOFTMAX,
+        input,
+        output,
+        rowCount,
+        rowLength,
+        format,
+        NULL,
+        NULL,
+        0.0f
+    );
+}
+
+double mc_log_softmax(
+    mc_Buffer* input,
+    mc_Buffer* output,
+    uint32_t rowCount,
+    uint32_t rowLength,
+    mc_FloatFormat format
+) {
+    return mc_rowwise_run(
+        MC_ROWWISE_LOG_SOFTMAX,
+        input,
+        output,
+        rowCount,
+        rowLength,
+        format,
+        NULL,
+        NULL,
+        0.0f
+    );
+}
+
+double mc_layer_norm(
+    mc_Buffer* input,
+    mc_Buffer* output,
+    uint32_t rowCount,
+    uint32_t rowLength,
+    mc_FloatFormat format,
+    mc_Buffer* gamma,
+    mc_Buffer* beta,
+    float epsilon
+) {
+    return mc_rowwise_run(
+        MC_ROWWISE_LAYER_NORM,
+        input,
+        output,
+        rowCount,
+        rowLength,
+        format,
+        gamma,
+        beta,
+        epsilon
+    );
+}
+
+double mc_rms_norm(
+    mc_Buffer* input,
+    mc_Buffer* output,
+    uint32_t rowCount,
+    uint32_t rowLength,
+    mc_FloatFormat format,
+    mc_Buffer* gamma,
+    float epsilon
+) {
+    return mc_rowwise_run(
+        MC_ROWWISE_RMS_NORM,
+        input,
+        output,
+        rowCount,
+        rowLength,
+        format,
+        gamma,
+        NULL,
+        epsilon
+    );
+}
@@ -0,0 +1,357 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "dispatch.h"
+#include "log.h"
+#include "program.h"
+
+// segments up to `SMALL` elements are sorted in the registers of one
+// invocation, up to `MEDIUM` in the shared memory of one workgroup, and the
+// larger ones by a radix sort through global memory, one workgroup each
+#define MC_SEGMENTED_SORT_SMALL 16
+#define MC_SEGMENTED_SORT_MEDIUM 2048
+
+// the control buffer: the indirect arguments of the 3 bins (4 words each),
+// the bin sizes, then the segment lists of the bins (`count` words each)
+#define MC_SEGMENTED_SORT_CTRL_WORDS 16
+
+// passes: 0 bins the segments, 1 writes the dispatch arguments of the bins,
+// 2 to 4 sort the small, medium and large segments. The elements are sorted
+// by (key, original index), so the sort is stable, and the padding (keys
+// `~0u`, indices past the end) always goes last
+static const char* segmentedSortSource
+    = "#version 450\n"
+      "#extension GL_EXT_control_flow_attributes : require\n"
+      "layout(local_size_x = 256) in;\n"
+      "layout(std430, binding = 0) coherent buffer keyBuff {\n"
+      "    uint keys[];\n"
+      "};\n"
+      "layout(std430, binding = 1) coherent buffer valueBuff {\n"
+      "    uint values[];\n"
+      "};\n"
+      "layout(std430, binding = 2) buffer offsetBuff {\n"
+      "    uint offsets[];\n"
+      "};\n"
+      "layout(std430, binding = 3) buffer ctrlBuff {\n"
+      "    uvec4 args[3];\n"
+      "    uint binSizes[4];\n"
+      "    uint bins[];\n"
+      "};\n"
+      "layout(std430, binding = 4) coherent buffer tmpKeyBuff {\n"
+      "    uint tmpKeys[];\n"
+      "};\n"
+      "layout(std430, binding = 5) coherent buffer tmpValueBuff {\n"
+      "    uint tmpValues[];\n"
+      "};\n"
+      "layout(push_constant) uniform Push {\n"
+      "    uint count;\n"
+      "    uint pass;\n"
+      "    uint hasValues;\n"
+      "    uint maxGroups;\n"
+      "};\n"
+      "#define WG 256u\n"
+      "#define SMALL 16u\n"
+      "#define MEDIUM 2048u\n"
+      "// medium: keys and indices; large: the 8 words of 16-bit digit\n"
+      "// counts of each invocation in sA, the histogram and bases in sB\n"
+      "shared uint sA[MEDIUM];\n"
+      "shared uint sB[MEDIUM];\n"
+      "bool greater(uint ka, uint ia, uint kb, uint ib) {\n"
+      "    return ka > kb || (ka == kb && ia > ib);\n"
+      "}\n"
+      "void bin_segments(uint s) {\n"
+      "    if (s >= count) return;\n"
+      "    uint len = offsets[s + 1u] - offsets[s];\n"
+      "    if (len <= 1u) return;\n"
+      "    uint bin = len <= SMALL ? 0u : len <= MEDIUM ? 1u : 2u;\n"
+      "    bins[bin * count + atomicAdd(binSizes[bin], 1u)] = s;\n"
+      "}\n"
+      "void write_args(void) {\n"
+      "    for (uint b = 0u; b < 3u; b++) {\n"
+      "        uint n = b == 0u ? (binSizes[0] + WG - 1u) / WG\n"
+      "                         : binSizes[b];\n"
+      "        uint x = min(n, maxGroups);\n"
+      "        args[b] = uvec4(x, x == 0u ? 1u : (n + x - 1u) / x, 1u, 0u);\n"
+      "    }\n"
+      "}\n"
+      "void sort_small(uint j) {\n"
+      "    if (j >= binSizes[0]) return;\n"
+      "    uint s = bins[j];\n"
+      "    uint base = offsets[s];\n"
+      "    uint len = offsets[s + 1u] - base;\n"
+      "    uint k[SMALL], v[SMALL], o[SMALL];\n"
+      "    [[unroll]] for (uint i = 0u; i < SMALL; i++) {\n"
+      "        k[i] = i < len ? keys[base + i] : ~0u;\n"
+      "        v[i] = i < len && hasValues != 0u ? values[base + i] : 0u;\n"
+      "        o[i] = i;\n"
+      "    }\n"
+      "    // bitonic sorting network\n"
+      "    [[unroll]] for (uint size = 2u; size <= SMALL; size <<= 1) {\n"
+      "        [[unroll]] for (uint d = size >> 1; d > 0u; d >>= 1) {\n"
+      "            [[unroll]] for (uint i = 0u; i < SMALL; i++) {\n"
+      "                uint l = i ^ d;\n"
+      "                if (l <= i) continue;\n"
+      "                bool up = (i & size) == 0u;\n"
+      "                if (greater(k[i], o[i], k[l], o[l]) == up) {\n"
+      "                    uvec3 t = uvec3(k[i], v[i], o[i]);\n"
+      "                    k[i] = k[l], v[i] = v[l], o[i] = o[l];\n"
+      "                    k[l] = t.x, v[l] = t.y, o[l] = t.z;\n"
+      "                }\n"
+      "            }\n"
+      "        }\n"
+      "    }\n"
+      "    [[unroll]] for (uint i = 0u; i < SMALL; i++) {\n"
+      "        if (i >= len) continue;\n"
+      "        keys[base + i] = k[i];\n"
+      "        if (hasValues != 0u) values[base + i] = v[i];\n"
+      "    }\n"
+      "}\n"
+      "void sort_medium(uint g) {\n"
+      "    uint lane = gl_LocalInvocationID.x;\n"
+      "    uint s = bins[count + g];\n"
+      "    uint base = offsets[s];\n"
+      "    uint len = offsets[s + 1u] - base;\n"
+      "    uint size = 1u << (findMSB(len - 1u) + 1);\n"
+      "    for (uint i = lane; i < size; i += WG) {\n"
+      "        sA[i] = i < len ? keys[base + i] : ~0u;\n"
+      "        sB[i] = i;\n"
+      "    }\n"
+      "    barrier();\n"
+      "    // bitonic sort, each invocation compares pairs `t`\n"
+      "    for (uint k = 2u; k <= size; k <<= 1) {\n"
+      "        for (uint d = k >> 1; d > 0u; d >>= 1) {\n"
+      "            for (uint t = lane; t < size / 2u; t += WG) {\n"
+      "                uint i = t / d * 2u * d + t % d;\n"
+      "                uint l = i + d;\n"
+      "                bool up = (i & k) == 0u;\n"
+      "                if (greater(sA[i], sB[i], sA[l], sB[l]) == up) {\n"
+      "                    uvec2 tmp = uvec2(sA[i], sB[i]);\n"
+      "                    sA[i] = sA[l], sB[i] = sB[l];\n"
+      "                    sA[l] = tmp.x, sB[l] = tmp.y;\n"
+      "                }\n"
+      "            }\n"
+      "            barrier();\n"
+      "        }\n"
+      "    }\n"
+      "    // the values are gathered before any of them is overwritten\n"
+      "    uint v[MEDIUM / WG];\n"
+      "    [[unroll]] for (uint r = 0u; r < MEDIUM / WG; r++) {\n"
+      "        uint i = lane + r * WG;\n"
+      "        bool gather = i < len && hasValues != 0u;\n"
+      "        v[r] = gather ? values[base + sB[i]] : 0u;\n"
+      "    }\n"
+      "    memoryBarrierBuffer();\n"
+      "    barrier();\n"
+      "    [[unroll]] for (uint r = 0u; r < MEDIUM / WG; r++) {\n"
+      "        uint i = lane + r * WG;\n"
+      "        if (i >= len) continue;\n"
+      "        keys[base + i] = sA[i];\n"
+      "        if (hasValues != 0u) values[base + i] = v[r];\n"
+      "    }\n"
+      "}\n"
+      "uint load_key(uint p, uint i) {\n"
+      "    return p % 2u == 0u ? keys[i] : tmpKeys[i];\n"
+      "}\n"
+      "uint load_value(uint p, uint i) {\n"
+      "    if (hasValues == 0u) return 0u;\n"
+      "    return p % 2u == 0u ? values[i] : tmpValues[i];\n"
+      "}\n"
+      "void store(uint p, uint i, uint k, uint v) {\n"
+      "    if (p % 2u == 0u) {\n"
+      "        tmpKeys[i] = k;\n"
+      "        if (hasValues != 0u) tmpValues[i] = v;\n"
+      "    } else {\n"
+      "        keys[i] = k;\n"
+      "        if (hasValues != 0u) values[i] = v;\n"
+      "    }\n"
+      "}\n"
+      "// least significant digit first radix sort: 8 passes of 4 bits\n"
+      "// between the segment and the same range of the temporary buffers,\n"
+      "// so it ends back in place. Each tile of 256 elements gets its stable\n"
+      "// ranks from a scan of the one-hot digit counts (16 counts of 16 bits\n"
+      "// in 8 words)\n"
+      "void sort_large(uint g) {\n"
+      "    uint lane = gl_LocalInvocationID.x;\n"
+      "    uint s = bins[2u * count + g];\n"
+      "    uint base = offsets[s];\n"
+      "    uint len = offsets[s + 1u] - base;\n"
+      "    for (uint p = 0u; p < 8u; p++) {\n"
+      "        uint shift = 4u * p;\n"
+      "        if (lane < 16u) sB[lane] = 0u;\n"
+      "        barrier();\n"
+      "        for (uint i = lane; i < len; i += WG) {\n"
+      "            uint d = (load_key(p, base + i) >> shift) & 15u;\n"
+      "            atomicAdd(sB[d], 1u);\n"
+      "        }\n"
+      "        barrier();\n"
+      "        if (lane == 0u) {\n"
+      "            uint sum = 0u;\n"
+      "            for (uint d = 0u; d < 16u; d++) {\n"
+      "                sB[16u + d] = sum;\n"
+      "                sum += sB[d];\n"
+      "            }\n"
+      "        }\n"
+      "        barrier();\n"
+      "        for (uint t = 0u; t < len; t += WG) {\n"
+      "            uint i = t + lane;\n"
+      "            bool valid = i < len;\n"
+      "            uint k = valid ? load_key(p, base + i) : 0u;\n"
+      "            uint v = valid ? load_value(p, base + i) : 0u;\n"
+      "            uint d = (k >> shift) & 15u;\n"
+      "            uint bit = valid ? 1u << (d % 2u * 16u) : 0u;\n"
+      "            [[unroll]] for (uint w = 0u; w < 8u; w++)\n"
+      "                sA[w * WG + lane] = w == d / 2u ? bit : 0u;\n"
+      "            barrier();\n"
+      "            for (uint off = 1u; off < WG; off <<= 1) {\n"
+      "                uint r[8];\n"
+      "                [[unroll]] for (uint w = 0u; w < 8u; w++) {\n"
+      "                    r[w] = sA[w * WG + lane];\n"
+      "                    if (lane >= off) r[w] += sA[w * WG + lane - off];\n"
+      "                }\n"
+      "                barrier();\n"
+      "                [[unroll]] for (uint w = 0u; w < 8u; w++)\n"
+      "                    sA[w * WG + lane] = r[w];\n"
+      "                barrier();\n"
+      "            }\n"
+      "            uint word = sA[d / 2u * WG + lane];\n"
+      "            uint rank = ((word >> (d % 2u * 16u)) & 0xffffu) - 1u;\n"
+      "            if (valid) store(p, base + sB[16u + d] + rank, k, v);\n"
+      "            barrier();\n"
+      "            if (lane < 16u) {\n"
+      "                uint last = sA[lane / 2u * WG + WG - 1u];\n"
+      "                last >>= lane % 2u * 16u;\n"
+      "                sB[16u + lane] += last & 0xffffu;\n"
+      "            }\n"
+      "            barrier();\n"
+      "        }\n"
+      "        memoryBarrierBuffer();\n"
+      "        barrier();\n"
+      "    }\n"
+      "}\n"
+      "void main(void) {\n"
+      "    uint lane = gl_LocalInvocationID.x;\n"
+      "    uint group = gl_WorkGroupID.y * gl_NumWorkGroups.x\n"
+      "               + gl_WorkGroupID.x;\n"
+      "    if (pass == 0u) bin_segments(group * WG + lane);\n"
+      "    else if (pass == 1u) {\n"
+      "        if (group == 0u && lane == 0u) write_args();\n"
+      "    } else if (pass == 2u) sort_small(group * WG + lane);\n"
+      "    else if (pass == 3u) {\n"
+      "        if (group < binSizes[1]) sort_medium(group);\n"
+      "    } else if (group < binSizes[2]) sort_large(group);\n"
+      "}\n";
+
+typedef struct mc_SegmentedSortPush {
+    uint32_t count;
+    uint32_t pass;
+    uint32_t hasValues;
+    uint32_t maxGroups;
+} mc_SegmentedSortPush;
+
+double mc_segmented_sort(
+    mc_Buffer* keys,
+    mc_Buffer* values,
+    mc_Buffer* segmentOffsets,
+    uint32_t count
+) {
+    if (!keys || !segmentOffsets) return -1.0;
+    DEBUG(keys, "sorting %d segments", count);
+
+    if (segmentOffsets->size < sizeof(uint32_t) * ((uint64_t)count + 1)) {
+        ERROR(keys, "segment offset buffer too small");
+        return -1.0;
+    }
+
+    if (values && values->size < keys->size) {
+        ERROR(keys, "value buffer smaller than the key buffer");
+        return -1.0;
+    }
+
+    if (count == 0) return 0.0;
+
+    mc_Device* device = keys->device;
+    mc_Program* program = mc_program_get_builtin(
+        device,
+        "segmented_sort",
+        segmentedSortSource
+    );
+    mc_Pipeline* pipeline
+        = program ? mc_program_get_pipeline(program, 6) : NULL;
+    if (!pipeline) return -1.0;
+
+    // the temporary buffers are only touched by the large segments
+    uint64_t ctrlSize = sizeof(uint32_t)
+                      * (MC_SEGMENTED_SORT_CTRL_WORDS + 3 * (uint64_t)count);
+    mc_Buffer* ctrl = mc_buffer_create(device, MC_BUFFER_TYPE_GPU, ctrlSize);
+    mc_Buffer* tmpKeys
+        = mc_buffer_create(device, MC_BUFFER_TYPE_GPU, keys->size);
+    mc_Buffer* tmpValues = NULL;
+    if (values)
+        tmpValues = mc_buffer_create(device, MC_BUFFER_TYPE_GPU, keys->size);
+    mc_Dispatch* dispatch = mc_dispatch_create(device);
+    bool ok = ctrl && tmpKeys && (tmpValues || !values) && dispatch;
+
+    mc_Buffer* buffs[6] = {
+        keys,
+        values ? values : keys,
+        segmentOffsets,
+        ctrl,
+        tmpKeys,
+        tmpValues ? tmpValues : tmpKeys,
+    };
+    VkDescriptorSet descSet = NULL;
+    if (ok) descSet = mc_dispatch_create_set(dispatch, pipeline, 6, buffs);
+    ok = ok && descSet;
+
+    if (ok) {
+        // the segments are spread over y when there are too many for x
+        uint32_t groups = (count + 255) / 256;
+        uint32_t groupsX = groups < device->maxWgCount[0]
+                             ? groups
+                             : device->maxWgCount[0];
+        uint32_t groupsY = (groups + groupsX - 1) / groupsX;
+
+        vkCmdFillBuffer(
+            dispatch->cmdBuff,
+            ctrl->buf,
+            0,
+            sizeof(uint32_t) * MC_SEGMENTED_SORT_CTRL_WORDS,
+            0
+        );
+        mc_dispatch_barrier(dispatch);
+        mc_dispatch_bind(dispatch, pipeline, descSet);
+
+        mc_SegmentedSortPush push
+            = {count, 0, values != NULL, device->maxWgCount[0]};
+        mc_dispatch_push(dispatch, pipeline, sizeof push, &push);
+        vkCmdDispatch(dispatch->cmdBuff, groupsX, groupsY, 1);
+
+        push.pass = 1;
+        mc_dispatch_barrier(dispatch);
+        mc_dispatch_push(dispatch, pipeline, sizeof push, &push);
+        vkCmdDispatch(dispatch->cmdBuff, 1, 1, 1);
+        mc_dispatch_barrier(dispatch);
+
+        // the bins hold distinct segments, so they are sorted concurrently
+        for (uint32_t bin = 0; bin < 3; bin++) {
+            push.pass = 2 + bin;
+            mc_dispatch_push(dispatch, pipeline, sizeof push, &push);
+            vkCmdDispatchIndirect(
+                dispatch->cmdBuff,
+                ctrl->buf,
+                4 * sizeof(uint32_t) * bin
+            );
+        }
+    }
+
+    double time = -1.0;
+    if (ok && mc_dispatch_finish(dispatch)) time = mc_dispatch_submit(dispatch);
+
+    mc_dispatch_destroy(dispatch);
+    mc_buffer_destroy(tmpValues);
+    mc_buffer_destroy(tmpKeys);
+    mc_buffer_destroy(ctrl);
+    return time;
+}
@@ -0,0 +1,336 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "dispatch.h"
+#include "hybrid_buffer.h"
+#include "log.h"
+#include "program.h"
+#include "tiled_program.h"
+
+static void mc_tiled_program_mark(mc_TiledProgram* tp, uint32_t tile) {
+    if (tp->dirty[tile]) return;
+    tp->dirty[tile] = true;
+    tp->dirtyCount++;
+}
+
+mc_TiledProgram* mc_tiled_program_create(
+    mc_Program* program,
+    mc_HBuffer* output,
+    uint32_t elemSize,
+    uint32_t width,
+    uint32_t height,
+    uint32_t wgWidth,
+    uint32_t wgHeight,
+    uint32_t tileSize
+) {
+    if (!program) return NULL;
+
+    mc_TiledProgram* tp = malloc(sizeof *tp);
+    *tp = (mc_TiledProgram){
+        ._instance = program->_instance,
+        .device = program->device,
+        .program = program,
+        .output = output,
+        .elemSize = elemSize,
+        .size = {width, height},
+        .wgSize = {wgWidth, wgHeight},
+        .tileSize = tileSize,
+        .tileCount = {0, 0},
+        .dirty = NULL,
+        .dirtyCount = 0,
+        .scratch = NULL,
+    };
+
+    DEBUG(
+        tp,
+        "creating tiled program, size: %dx%d, tile size: %d",
+        width,
+        height,
+        tileSize
+    );
+
+    if (!tp->device->cmdDispatchBase) {
+        ERROR(tp, "tiled programs need vulkan 1.1 (vkCmdDispatchBase)");
+        mc_tiled_program_destroy(tp);
+        return NULL;
+    }
+
+    if (!output || !elemSize || !width || !height || !wgWidth || !wgHeight
+        || !tileSize || tileSize % wgWidth || tileSize % wgHeight) {
+        ERROR(tp, "tile size must be a multiple of the workgroup size");
+        mc_tiled_program_destroy(tp);
+        return NULL;
+    }
+
+    if ((uint64_t)elemSize * width * height
+        > mc_hybrid_buffer_get_size(output)) {
+        ERROR(tp, "output buffer too small");
+        mc_tiled_program_destroy(tp);
+        return NULL;
+    }
+
+    tp->tileCount[0] = (width + tileSize - 1) / tileSize;
+    tp->tileCount[1] = (height + tileSize - 1) / tileSize;
+    tp->dirty = calloc(tp->tileCount[0] * tp->tileCount[1], sizeof *tp->dirty);
+    mc_tiled_program_invalidate_all(tp);
+
+    return tp;
+}
+
+void mc_tiled_program_destroy(mc_TiledProgram* tp) {
+    if (!tp) return;
+    DEBUG(tp, "destroying tiled program");
+    mc_buffer_destroy(tp->scratch);
+    free(tp->dirty);
+    free(tp);
+}
+
+void mc_tiled_program_invalidate(
+    mc_TiledProgram* tp,
+    int64_t x,
+    int64_t y,
+    int64_t width,
+    int64_t height
+) {
+    if (!tp) return;
+
+    // clip the region to the grid, then mark every tile it touches
+    int64_t x0 = x < 0 ? 0 : x;
+    int64_t y0 = y < 0 ? 0 : y;
+    int64_t x1 = x + width < tp->size[0] ? x + width : tp->size[0];
+    int64_t y1 = y + height < tp->size[1] ? y + height : tp->size[1];
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int64_t ty = y0 / tp->tileSize; ty <= (y1 - 1) / tp->tileSize; ty++)
+        for (int64_t tx = x0 / tp->tileSize; tx <= (x1 - 1) / tp->tileSize;
+             tx++)
+            mc_tiled_program_mark(tp, ty * tp->tileCount[0] + tx);
+}
+
+void mc_tiled_program_invalidate_all(mc_TiledProgram* tp) {
+    if (!tp) return;
+    for (uint32_t i = 0; i < tp->tileCount[0] * tp->tileCount[1]; i++)
+        mc_tiled_program_mark(tp, i);
+}
+
+uint32_t mc_tiled_program_get_dirty_count(mc_TiledProgram* tp) {
+    return tp ? tp->dirtyCount : 0;
+}
+
+bool mc_tiled_program_scroll(
+    mc_TiledProgram* tp,
+    int32_t dx,
+    int32_t dy,
+    void* image
+) {
+    if (!tp) return false;
+    DEBUG(tp, "scrolling tiled program by %d, %d", dx, dy);
+
+    int64_t w = tp->size[0];
+    int64_t h = tp->size[1];
+    if (dx == 0 && dy == 0) return true;
+    if (dx <= -w || dx >= w || dy <= -h || dy >= h) {
+        mc_tiled_program_invalidate_all(tp);
+        return true;
+    }
+
+    // the rows and columns that are kept, in the destination
+    uint64_t rowX = dx > 0 ? dx : 0;
+    uint64_t rowSize = tp->elemSize * (w - (dx > 0 ? dx : -dx));
+    int64_t firstY = dy > 0 ? dy : 0;
+    int64_t lastY = dy > 0 ? h : h + dy;
+
+    uint64_t size = (uint64_t)tp->elemSize * w * h;
+    if (!tp->scratch)
+        tp->scratch = mc_buffer_create(tp->device, MC_BUFFER_TYPE_GPU, size);
+    if (!tp->scratch) return false;
+
+    mc_Dispatch* dispatch = mc_dispatch_create(tp->device);
+    if (!dispatch) return false;
+
+    // copy the output aside, then back to its shifted position (copies within
+    // a buffer must not overlap)
+    VkBuffer outBuf = tp->output->gpuBuff.buf;
+    vkCmdCopyBuffer(
+        dispatch->cmdBuff,
+        outBuf,
+        tp->scratch->buf,
+        1,
+        &(VkBufferCopy){0, 0, size}
+    );
+    mc_dispatch_barrier(dispatch);
+
+    uint32_t regionCount = lastY - firstY;
+    VkBufferCopy* regions = malloc(sizeof *regions * regionCount);
+    for (int64_t y = firstY; y < lastY; y++) {
+        uint64_t dst = tp->elemSize * (y * w + rowX);
+        uint64_t src = tp->elemSize * ((y - dy) * w + rowX - dx);
+        regions[y - firstY] = (VkBufferCopy){src, dst, rowSize};
+    }
+    vkCmdCopyBuffer(
+        dispatch->cmdBuff,
+        tp->scratch->buf,
+        outBuf,
+        regionCount,
+        regions
+    );
+    free(regions);
+
+    bool ok = mc_dispatch_finish(dispatch);
+    if (ok) ok = mc_dispatch_submit(dispatch) >= 0.0;
+    mc_dispatch_destroy(dispatch);
+    if (!ok) return false;
+
+    // shift the host copy the same way
+    if (image) {
+        char* data = image;
+        uint64_t rowBytes = tp->elemSize * w;
+        for (int64_t i = 0; i < lastY - firstY; i++) {
+            int64_t y = dy > 0 ? lastY - 1 - i : firstY + i;
+            memmove(
+                data + rowBytes * y + tp->elemSize * rowX,
+                data + rowBytes * (y - dy) + tp->elemSize * (rowX - dx),
+                rowSize
+            );
+        }
+    }
+
+    // the dirty tiles move with their pixels, marking the tiles they land on
+    uint32_t tileCount = tp->tileCount[0] * tp->tileCount[1];
+    bool* prevDirty = tp->dirty;
+    bool* dirty = calloc(tileCount, sizeof *dirty);
+    if (!dirty) return false;
+    tp->dirty = dirty;
+    tp->dirtyCount = 0;
+    for (uint32_t i = 0; i < tileCount; i++) {
+        if (!prevDirty[i]) continue;
+        int64_t tx = i % tp->tileCount[0];
+        int64_t ty = i / tp->tileCount[0];
+        mc_tiled_program_invalidate(
+            tp,
+            tx * tp->tileSize + dx,
+            ty * tp->tileSize + dy,
+            tp->tileSize,
+            tp->tileSize
+        );
+    }
+    free(prevDirty);
+
+    // the uncovered strips have to be computed again
+    if (dx > 0) mc_tiled_program_invalidate(tp, 0, 0, dx, h);
+    if (dx < 0) mc_tiled_program_invalidate(tp, w + dx, 0, -dx, h);
+    if (dy > 0) mc_tiled_program_invalidate(tp, 0, 0, w, dy);
+    if (dy < 0) mc_tiled_program_invalidate(tp, 0, h + dy, w, -dy);
+
+    return true;
+}
+
+double mc_tiled_program_run(
+    mc_TiledProgram* tp,
+    uint32_t buffCount,
+    mc_Buffer** buffs,
+    void* image
+) {
+    if (!tp) return -1.0;
+    DEBUG(tp, "running %d dirty tile(s)", tp->dirtyCount);
+
+    if (tp->dirtyCount == 0) return 0.0;
+
+    mc_Pipeline* pipeline = mc_program_get_pipeline(tp->program, buffCount);
+    if (!pipeline) return -1.0;
+
+    mc_Dispatch* dispatch = mc_dispatch_create(tp->device);
+    if (!dispatch) return -1.0;
+
+    VkDescriptorSet descSet
+        = mc_dispatch_create_set(dispatch, pipeline, buffCount, buffs);
+    if (!descSet) {
+        mc_dispatch_destroy(dispatch);
+        return -1.0;
+    }
+    mc_dispatch_bind(dispatch, pipeline, descSet);
+
+    // a run of dirty tiles in a row is one dispatch, and one copy per line
+    uint32_t tileSize = tp->tileSize;
+    uint32_t regionCount = 0;
+    VkBufferCopy* regions = malloc(
+        sizeof *regions * tp->dirtyCount * tileSize
+    );
+
+    for (uint32_t ty = 0; ty < tp->tileCount[1]; ty++) {
+        for (uint32_t tx = 0; tx < tp->tileCount[0]; tx++) {
+            if (!tp->dirty[ty * tp->tileCount[0] + tx]) continue;
+
+            uint32_t runEnd = tx + 1;
+            while (runEnd < tp->tileCount[0]
+                   && tp->dirty[ty * tp->tileCount[0] + runEnd])
+                runEnd++;
+
+            uint32_t x0 = tx * tileSize;
+            uint32_t y0 = ty * tileSize;
+            uint32_t x1 = runEnd * tileSize;
+            uint32_t y1 = y0 + tileSize;
+            if (x1 > tp->size[0]) x1 = tp->size[0];
+            if (y1 > tp->size[1]) y1 = tp->size[1];
+
+            tp->device->cmdDispatchBase(
+                dispatch->cmdBuff,
+                x0 / tp->wgSize[0],
+                y0 / tp->wgSize[1],
+                0,
+                (x1 - x0 + tp->wgSize[0] - 1) / tp->wgSize[0],
+                (y1 - y0 + tp->wgSize[1] - 1) / tp->wgSize[1],
+                1
+            );
+
+            for (uint32_t y = y0; y < y1; y++) {
+                uint64_t offset
+                    = (uint64_t)tp->elemSize * ((uint64_t)y * tp->size[0] + x0);
+                uint64_t size = (uint64_t)tp->elemSize * (x1 - x0);
+                regions[regionCount++] = (VkBufferCopy){offset, offset, size};
+            }
+
+            tx = runEnd - 1;
+        }
+    }
+
+    if (image) {
+        mc_dispatch_barrier(dispatch);
+        vkCmdCopyBuffer(
+            dispatch->cmdBuff,
+            tp->output->gpuBuff.buf,
+            tp->output->cpuBuff->buf,
+            regionCount,
+            regions
+        );
+    }
+
+    double time = -1.0;
+    if (mc_dispatch_finish(dispatch)) time = mc_dispatch_submit(dispatch);
+    mc_dispatch_destroy(dispatch);
+
+    if (time >= 0.0) {
+        if (image) {
+            char* map = tp->output->cpuBuff->map;
+            for (uint32_t i = 0; i < regionCount; i++) {
+                memcpy(
+                    (char*)image + regions[i].dstOffset,
+                    map + regions[i].srcOffset,
+                    regions[i].size
+                );
+            }
+        }
+
+        memset(
+            tp->dirty,
+            0,
+            sizeof *tp->dirty * tp->tileCount[0] * tp->tileCount[1]
+        );
+        tp->dirtyCount = 0;
+    }
+
+    free(regions);
+    return time;
+}
@@ -0,0 +1,22 @@
+#ifndef MC_TILED_PROGRAM_H
+#define MC_TILED_PROGRAM_H
+
+#include "microcompute.h"
+#include "microcompute_extra.h"
+
+struct mc_TiledProgram {
+    mc_Instance* _instance;
+    mc_Device* device;
+    mc_Program* program;
+    mc_HBuffer* output;
+    uint32_t elemSize;
+    uint32_t size[2];
+    uint32_t wgSize[2];
+    uint32_t tileSize; // in elements, a multiple of the workgroup size
+    uint32_t tileCount[2];
+    bool* dirty; // one per tile, row-major
+    uint32_t dirtyCount;
+    mc_Buffer* scratch; // copy of the output while scrolling
+};
+
+#endif // MC_TILED_PROGRAM_H
@@ -0,0 +1,306 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "dispatch.h"
+#include "log.h"
+#include "program.h"
+
+// the number of keys handled by a workgroup, 4 per invocation
+#define MC_UNIQUE_BLOCK_SIZE 1024
+
+// what is kept, and what is written
+#define MC_UNIQUE_MODE_UNIQUE 0  // the run heads
+#define MC_UNIQUE_MODE_RLE 1     // the run heads and run lengths
+#define MC_UNIQUE_MODE_VALUES 2  // the values selected by a bitmap
+#define MC_UNIQUE_MODE_INDICES 3 // the indices selected by a bitmap
+
+// flag-and-scan over blocks of keys (a key is flagged when it starts a run,
+// or when its bit is set in the selection bitmap):
+// - pass 0: count the run heads of each block
+// - pass 1: exclusive scan of the block counts (single workgroup), and write
+//   the total count
+// - pass 2: scatter the run heads (and run lengths) to their rank
+static const char* uniqueSource
+    = "#version 450\n"
+      "layout(local_size_x = 256) in;\n"
+      "layout(std430, binding = 0) buffer keyBuff {\n"
+      "    uint keys[];\n"
+      "};\n"
+      "layout(std430, binding = 1) buffer outKeyBuff {\n"
+      "    uint outKeys[];\n"
+      "};\n"
+      "layout(std430, binding = 2) buffer lengthBuff {\n"
+      "    uint lengths[];\n"
+      "};\n"
+      "layout(std430, binding = 3) buffer countBuff {\n"
+      "    uint total;\n"
+      "    uint argsX;\n"
+      "    uint argsY;\n"
+      "    uint argsZ;\n"
+      "};\n"
+      "layout(std430, binding = 4) buffer blockBuff {\n"
+      "    uint blockSums[];\n"
+      "};\n"
+      "layout(push_constant) uniform Push {\n"
+      "    uint count;\n"
+      "    uint blockCount;\n"
+      "    uint pass;\n"
+      "    uint mode;\n"
+      "};\n"
+      "shared uint sScan[256];\n"
+      "bool is_head(uint i) {\n"
+      "    if (mode >= 2u)\n"
+      "        return (lengths[i >> 5] & (1u << (i & 31u))) != 0u;\n"
+      "    return i == 0u || keys[i] != keys[i - 1u];\n"
+      "}\n"
+      "uint workgroup_scan(uint v) {\n"
+      "    uint lane = gl_LocalInvocationID.x;\n"
+      "    sScan[lane] = v;\n"
+      "    barrier();\n"
+      "    for (uint off = 1u; off < 256u; off <<= 1) {\n"
+      "        uint t = lane >= off ? sScan[lane - off] : 0u;\n"
+      "        barrier();\n"
+      "        sScan[lane] += t;\n"
+      "        barrier();\n"
+      "    }\n"
+      "    return sScan[lane];\n"
+      "}\n"
+      "void main(void) {\n"
+      "    uint lane = gl_LocalInvocationID.x;\n"
+      "    if (pass == 1u) {\n"
+      "        uint per = (blockCount + 255u) / 256u;\n"
+      "        uint first = min(lane * per, blockCount);\n"
+      "        uint last = min(first + per, blockCount);\n"
+      "        uint sum = 0u;\n"
+      "        for (uint b = first; b < last; b++) sum += blockSums[b];\n"
+      "        uint acc = workgroup_scan(sum) - sum;\n"
+      "        for (uint b = first; b < last; b++) {\n"
+      "            uint t = blockSums[b];\n"
+      "            blockSums[b] = acc;\n"
+      "            acc += t;\n"
+      "        }\n"
+      "        if (lane == 255u) {\n"
+      "            total = acc;\n"
+      "            argsX = (acc + 63u) / 64u;\n"
+      "            argsY = 1u;\n"
+      "            argsZ = 1u;\n"
+      "        }\n"
+      "        return;\n"
+      "    }\n"
+      "    uint block = gl_WorkGroupID.y * gl_NumWorkGroups.x\n"
+      "               + gl_WorkGroupID.x;\n"
+      "    if (block >= blockCount) return;\n"
+      "    uint first = block * 1024u + lane * 4u;\n"
+      "    uint flags = 0u;\n"
+      "    uint n = 0u;\n"
+      "    for (uint k = 0u; k < 4u; k++) {\n"
+      "        uint i = first + k;\n"
+      "        if (i < count && is_head(i)) {\n"
+      "            flags |= 1u << k;\n"
+      "            n++;\n"
+      "        }\n"
+      "    }\n"
+      "    uint rank = workgroup_scan(n) - n;\n"
+      "    if (pass == 0u) {\n"
+      "        if (lane == 255u) blockSums[block] = rank + n;\n"
+      "        return;\n"
+      "    }\n"
+      "    // a run length is its end minus its start, added by the\n"
+      "    // invocations holding its first and last keys (the lengths are\n"
+      "    // zeroed first)\n"
+      "    uint u = blockSums[block] + rank;\n"
+      "    for (uint k = 0u; k < 4u; k++) {\n"
+      "        uint i = first + k;\n"
+      "        if (i >= count) break;\n"
+      "        if ((flags & (1u << k)) != 0u) {\n"
+      "            outKeys[u] = mode == 3u ? i : keys[i];\n"
+      "            if (mode == 1u) atomicAdd(lengths[u], 0u - i);\n"
+      "            u++;\n"
+      "        }\n"
+      "        if (mode == 1u\n"
+      "            && (i + 1u == count || keys[i + 1u] != keys[i]))\n"
+      "            atomicAdd(lengths[u - 1u], i + 1u);\n"
+      "    }\n"
+      "}\n";
+
+typedef struct mc_UniquePush {
+    uint32_t count;
+    uint32_t blockCount;
+    uint32_t pass;
+    uint32_t mode;
+} mc_UniquePush;
+
+static bool mc_unique_check(
+    mc_Buffer* buff,
+    uint64_t size,
+    const char* name
+) {
+    if (!buff) return false;
+    if (buff->size < size) {
+        ERROR(buff, "%s buffer too small", name);
+        return false;
+    }
+    return true;
+}
+
+// `aux` is the run lengths for RLE, or the selection bitmap
+static bool mc_unique_run(
+    mc_Buffer* keys,
+    uint32_t count,
+    mc_Buffer* outKeys,
+    mc_Buffer* aux,
+    uint32_t mode,
+    mc_Buffer* outCount,
+    uint32_t* hostCount
+) {
+    uint64_t size = sizeof(uint32_t) * (uint64_t)count;
+    uint64_t bitmapSize = sizeof(uint32_t) * (((uint64_t)count + 31) / 32);
+    bool rle = mode == MC_UNIQUE_MODE_RLE;
+    bool select = mode >= MC_UNIQUE_MODE_VALUES;
+    bool indices = mode == MC_UNIQUE_MODE_INDICES;
+    if ((!indices && !mc_unique_check(keys, size, "key"))
+        || !mc_unique_check(outKeys, size, "output key")
+        || (rle && !mc_unique_check(aux, size, "run length"))
+        || (select && !mc_unique_check(aux, bitmapSize, "selection"))
+        || !mc_unique_check(outCount, 4 * sizeof(uint32_t), "count"))
+        return false;
+
+    mc_Device* device = outKeys->device;
+    uint32_t blockCount
+        = (count + MC_UNIQUE_BLOCK_SIZE - 1) / MC_UNIQUE_BLOCK_SIZE;
+
+    mc_Program* program
+        = mc_program_get_builtin(device, "unique", uniqueSource);
+    mc_Pipeline* pipeline
+        = program ? mc_program_get_pipeline(program, 5) : NULL;
+    if (!pipeline) return false;
+
+    mc_Buffer* blockSums = mc_buffer_create(
+        device,
+        MC_BUFFER_TYPE_GPU,
+        sizeof(uint32_t) * (blockCount + 1)
+    );
+    mc_Buffer* readback = NULL;
+    if (hostCount)
+        readback = mc_buffer_create(device, MC_BUFFER_TYPE_CPU, 4);
+    mc_Dispatch* dispatch = mc_dispatch_create(device);
+    bool ok = blockSums && (readback || !hostCount) && dispatch;
+
+    mc_Buffer* buffs[5] = {
+        keys ? keys : aux,
+        outKeys,
+        aux ? aux : outKeys,
+        outCount,
+        blockSums,
+    };
+    VkDescriptorSet descSet = NULL;
+    if (ok) descSet = mc_dispatch_create_set(dispatch, pipeline, 5, buffs);
+    ok = ok && descSet;
+
+    if (ok && count == 0) {
+        vkCmdFillBuffer(dispatch->cmdBuff, outCount->buf, 0, 16, 0);
+    } else if (ok) {
+        // the blocks are spread over y when there are too many for x
+        uint32_t groupsX = blockCount < device->maxWgCount[0]
+                             ? blockCount
+                             : device->maxWgCount[0];
+        uint32_t groupsY = (blockCount + groupsX - 1) / groupsX;
+
+        if (rle)
+            vkCmdFillBuffer(dispatch->cmdBuff, aux->buf, 0, size, 0);
+        mc_dispatch_bind(dispatch, pipeline, descSet);
+
+        mc_UniquePush push = {count, blockCount, 0, mode};
+        for (push.pass = 0; push.pass < 3; push.pass++) {
+            mc_dispatch_barrier(dispatch);
+            mc_dispatch_push(dispatch, pipeline, sizeof push, &push);
+            if (push.pass == 1) vkCmdDispatch(dispatch->cmdBuff, 1, 1, 1);
+            else vkCmdDispatch(dispatch->cmdBuff, groupsX, groupsY, 1);
+        }
+    }
+
+    if (ok && readback) {
+        mc_dispatch_barrier(dispatch);
+        vkCmdCopyBuffer(
+            dispatch->cmdBuff,
+            outCount->buf,
+            readback->buf,
+            1,
+            &(VkBufferCopy){0, 0, sizeof(uint32_t)}
+        );
+    }
+
+    if (ok) ok = mc_dispatch_finish(dispatch);
+    if (ok) ok = mc_dispatch_submit(dispatch) >= 0.0;
+    if (ok && hostCount) memcpy(hostCount, readback->map, sizeof *hostCount);
+
+    mc_dispatch_destroy(dispatch);
+    mc_buffer_destroy(readback);
+    mc_buffer_destroy(blockSums);
+    return ok;
+}
+
+bool mc_unique(
+    mc_Buffer* keys,
+    uint32_t count,
+    mc_Buffer* outKeys,
+    mc_Buffer* outCount,
+    uint32_t* hostCount
+) {
+    if (!keys) return false;
+    DEBUG(keys, "finding the unique keys of %d sorted keys", count);
+    return mc_unique_run(
+        keys,
+        count,
+        outKeys,
+        NULL,
+        MC_UNIQUE_MODE_UNIQUE,
+        outCount,
+        hostCount
+    );
+}
+
+bool mc_rle(
+    mc_Buffer* keys,
+    uint32_t count,
+    mc_Buffer* outKeys,
+    mc_Buffer* outLengths,
+    mc_Buffer* outCount,
+    uint32_t* hostCount
+) {
+    if (!keys) return false;
+    DEBUG(keys, "run-length encoding %d keys", count);
+    if (!outLengths) return false;
+    return mc_unique_run(
+        keys,
+        count,
+        outKeys,
+        outLengths,
+        MC_UNIQUE_MODE_RLE,
+        outCount,
+        hostCount
+    );
+}
+
+bool mc_compact(
+    mc_Buffer* values,
+    uint32_t count,
+    mc_Buffer* selection,
+    mc_Buffer* outValues,
+    mc_Buffer* outCount,
+    uint32_t* hostCount
+) {
+    if (!selection) return false;
+    DEBUG(selection, "compacting %d values", count);
+    return mc_unique_run(
+        values,
+        count,
+        outValues,
+        selection,
+        values ? MC_UNIQUE_MODE_VALUES : MC_UNIQUE_MODE_INDICES,
+        outCount,
+        hostCount
+    );
+}
@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "hybrid_buffer.h"
+#include "log.h"
+#include "vector.h"
+
+static bool mc_vector_write_counter(mc_Vector* vector) {
+    uint32_t counter[2] = {(uint32_t)vector->size, (uint32_t)vector->capacity};
+    return mc_hybrid_buffer_write(vector->counter, 0, sizeof counter, counter)
+        == sizeof counter;
+}
+
+mc_Vector* mc_vector_create(
+    mc_Device* device,
+    uint64_t elemSize,
+    uint64_t capacity
+) {
+    if (!device) return NULL;
+
+    mc_Vector* vector = malloc(sizeof *vector);
+    *vector = (mc_Vector){
+        ._instance = device->_instance,
+        .device = device,
+        .elemSize = elemSize,
+        .size = 0,
+        .capacity = capacity ? capacity : 1,
+        .data = NULL,
+        .counter = NULL,
+    };
+
+    DEBUG(
+        vector,
+        "creating vector, element size: %ld, capacity: %ld",
+        elemSize,
+        vector->capacity
+    );
+
+    if (elemSize == 0 || vector->capacity > UINT32_MAX) {
+        ERROR(vector, "invalid element size or capacity");
+        mc_vector_destroy(vector);
+        return NULL;
+    }
+
+    vector->data
+        = mc_hybrid_buffer_create(device, vector->elemSize * vector->capacity);
+    vector->counter = mc_hybrid_buffer_create(device, 2 * sizeof(uint32_t));
+
+    if (!vector->data || !vector->counter || !mc_vector_write_counter(vector)) {
+        mc_vector_destroy(vector);
+        return NULL;
+    }
+
+    return vector;
+}
+
+void mc_vector_destroy(mc_Vector* vector) {
+    if (!vector) return;
+    DEBUG(vector, "destroying vector");
+    mc_hybrid_buffer_destroy(vector->data);
+    mc_hybrid_buffer_destroy(vector->counter);
+    free(vector);
+}
+
+uint64_t mc_vector_get_size(mc_Vector* vector) {
+    return vector ? vector->size : 0;
+}
+
+uint64_t mc_vector_get_capacity(mc_Vector* vector) {
+    return vector ? vector->capacity : 0;
+}
+
+mc_Buffer* mc_vector_get_buffer(mc_Vector* vector) {
+    return vector ? &vector->data->gpuBuff : NULL;
+}
+
+mc_Buffer* mc_vector_get_counter(mc_Vector* vector) {
+    return vector ? &vector->counter->gpuBuff : NULL;
+}
+
+bool mc_vector_reserve(mc_Vector* vector, uint64_t capacity) {
+    if (!vector) return false;
+    if (capacity <= vector->capacity) return true;
+
+    // grow geometrically, so that repeated appends are amortized O(1)
+    uint64_t newCapacity = vector->capacity * 2;
+    if (newCapacity < capacity) newCapacity = capacity;
+    if (newCapacity > UINT32_MAX) newCapacity = UINT32_MAX;
+    if (newCapacity < capacity) {
+        ERROR(vector, "capacity too large");
+        return false;
+    }
+
+    DEBUG(
+        vector,
+        "growing vector: %ld -> %ld",
+        vector->capacity,
+        newCapacity
+    );
+
+    uint64_t dataSize = vector->elemSize * newCapacity;
+    mc_HBuffer* data = mc_hybrid_buffer_create(vector->device, dataSize);
+    if (!data) return false;
+
+    // only the used part needs to be copied
+    uint64_t usedSize = vector->elemSize * vector->size;
+    if (usedSize
+        && mc_buffer_copier_copy(
+               data->copier,
+               &vector->data->gpuBuff,
+               &data->gpuBuff,
+               0,
+               0,
+               usedSize
+           ) != usedSize) {
+        mc_hybrid_buffer_destroy(data);
+        return false;
+    }
+
+    mc_hybrid_buffer_destroy(vector->data);
+    vector->data = data;
+    vector->capacity = newCapacity;
+    return mc_vector_write_counter(vector);
+}
+
+bool mc_vector_resize(mc_Vector* vector, uint64_t size) {
+    if (!mc_vector_reserve(vector, size)) return false;
+    vector->size = size;
+    return mc_vector_write_counter(vector);
+}
+
+uint64_t mc_vector_push_back_many(
+    mc_Vector* vector,
+    uint64_t count,
+    void* data
+) {
+    if (!vector) return 0;
+    if (!mc_vector_reserve(vector, vector->size + count)) return 0;
+
+    uint64_t offset = vector->elemSize * vector->size;
+    uint64_t size = vector->elemSize * count;
+    if (mc_hybrid_buffer_write(vector->data, offset, size, data) != size)
+        return 0;
+
+    vector->size += count;
+    return mc_vector_write_counter(vector) ? count : 0;
+}
+
+uint64_t mc_vector_read(
+    mc_Vector* vector,
+    uint64_t first,
+    uint64_t count,
+    void* data
+) {
+    if (!vector) return 0;
+    if (first + count > vector->size) {
+        ERROR(vector, "first + count > vector size");
+        return 0;
+    }
+
+    uint64_t offset = vector->elemSize * first;
+    uint64_t size = vector->elemSize * count;
+    uint64_t res = mc_hybrid_buffer_read(vector->data, offset, size, data);
+    return res == size ? count : 0;
+}
+
+uint64_t mc_vector_sync(mc_Vector* vector) {
+    if (!vector) return 0;
+
+    uint32_t counter[2] = {0, 0};
+    mc_hybrid_buffer_read(vector->counter, 0, sizeof counter, counter);
+
+    // elements appended past the capacity were dropped by the program: the
+    // size goes back to what it was before the program ran (so that running
+    // it again does not append the elements that fit twice), and the vector
+    // grows so that they all fit next time
+    uint64_t appended = counter[0];
+    uint64_t dropped = 0;
+    if (appended > vector->capacity) {
+        dropped = appended - vector->capacity;
+        WARN(vector, "%ld element(s) did not fit in the vector", dropped);
+        mc_vector_reserve(vector, appended);
+    } else {
+        vector->size = appended;
+    }
+
+    mc_vector_write_counter(vector);
+    return dropped;
+}
@@ -0,0 +1,16 @@
+#ifndef MC_VECTOR_H
+#define MC_VECTOR_H
+
+#include "microcompute_extra.h"
+
+struct mc_Vector {
+    mc_Instance* _instance;
+    mc_Device* device;
+    uint64_t elemSize;
+    uint64_t size;
+    uint64_t capacity;
+    mc_HBuffer* data;
+    mc_HBuffer* counter; // {size, capacity}, as two uint32_t
+};
+
+#endif // MC_VECTOR_H
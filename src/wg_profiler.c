@@ -0,0 +1,227 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "hybrid_buffer.h"
+#include "log.h"
+#include "program_code.h"
+#include "wg_profiler.h"
+
+static int mc_compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+mc_WgProfiler* mc_wg_profiler_create(
+    mc_Device* device,
+    const char* name,
+    const char* code,
+    const char* entry,
+    uint32_t buffCount
+) {
+    if (!device) return NULL;
+
+    mc_WgProfiler* profiler = malloc(sizeof *profiler);
+    *profiler = (mc_WgProfiler){
+        ._instance = device->_instance,
+        .device = device,
+        .code = NULL,
+        .program = NULL,
+        .buffCount = buffCount,
+        .dim = {0, 0, 0},
+        .wgCount = 0,
+        .durations = NULL,
+        .times = NULL,
+    };
+
+    DEBUG(profiler, "creating workgroup profiler for %s", name);
+
+    if (!device->shaderClock) {
+        ERROR(profiler, "device does not support VK_KHR_shader_clock");
+        mc_wg_profiler_destroy(profiler);
+        return NULL;
+    }
+
+    // the profiling buffer is bound after the program's own buffers
+    char binding[16];
+    snprintf(binding, sizeof binding, "%u", buffCount);
+    mc_CompileDefinition defs[] = {
+        {"MC_PROFILE", "1"},
+        {"MC_PROFILE_BINDING", binding},
+        {"MC_PROFILE_DEVICE_CLOCK", "1"},
+    };
+    uint32_t defCount = device->shaderDeviceClock ? 3 : 2;
+
+    profiler->code = mc_program_code_create_from_glsl_defs(
+        profiler->_instance,
+        name,
+        code,
+        entry,
+        defCount,
+        defs
+    );
+    if (profiler->code)
+        profiler->program = mc_program_create(device, profiler->code);
+    if (!profiler->program) {
+        mc_wg_profiler_destroy(profiler);
+        return NULL;
+    }
+
+    return profiler;
+}
+
+void mc_wg_profiler_destroy(mc_WgProfiler* profiler) {
+    if (!profiler) return;
+    DEBUG(profiler, "destroying workgroup profiler");
+    mc_hybrid_buffer_destroy(profiler->times);
+    mc_program_destroy(profiler->program);
+    mc_program_code_destroy(profiler->code);
+    free(profiler->durations);
+    free(profiler);
+}
+
+double mc_wg_profiler_run(
+    mc_WgProfiler* profiler,
+    uint32_t dimX,
+    uint32_t dimY,
+    uint32_t dimZ,
+    mc_Buffer** buffs
+) {
+    if (!profiler) return -1.0;
+
+    uint64_t wgCount = (uint64_t)dimX * dimY * dimZ;
+    uint64_t size = sizeof(uint32_t) * 4 * wgCount;
+    if (!wgCount) {
+        ERROR(profiler, "at least one dimension is 0");
+        return -1.0;
+    }
+
+    if (wgCount != profiler->wgCount) {
+        mc_hybrid_buffer_destroy(profiler->times);
+        free(profiler->durations);
+        profiler->wgCount = 0;
+        profiler->durations = malloc(sizeof *profiler->durations * wgCount);
+        profiler->times = mc_hybrid_buffer_create(profiler->device, size);
+        if (!profiler->times) return -1.0;
+        profiler->wgCount = wgCount;
+    }
+    memcpy(profiler->dim, (uint32_t[]){dimX, dimY, dimZ}, sizeof profiler->dim);
+
+    mc_Buffer** allBuffs = malloc(sizeof *allBuffs * (profiler->buffCount + 1));
+    if (profiler->buffCount)
+        memcpy(allBuffs, buffs, sizeof *allBuffs * profiler->buffCount);
+    allBuffs[profiler->buffCount] = (mc_Buffer*)profiler->times;
+
+    mc_Dispatch* dispatch = mc_program_prepare(
+        profiler->program,
+        dimX,
+        dimY,
+        dimZ,
+        profiler->buffCount + 1,
+        allBuffs
+    );
+    free(allBuffs);
+    if (!dispatch) return -1.0;
+
+    double time = mc_dispatch_submit(dispatch);
+    mc_dispatch_destroy(dispatch);
+    if (time < 0.0) return -1.0;
+
+    uint32_t* times = malloc(size);
+    if (mc_hybrid_buffer_read(profiler->times, 0, size, times) != size) {
+        free(times);
+        return -1.0;
+    }
+
+    for (uint64_t i = 0; i < wgCount; i++) {
+        uint32_t* t = &times[4 * i];
+        uint64_t start = (uint64_t)t[1] << 32 | t[0];
+        uint64_t end = (uint64_t)t[3] << 32 | t[2];
+        profiler->durations[i] = end > start ? end - start : 0;
+    }
+
+    free(times);
+    return time;
+}
+
+const uint64_t* mc_wg_profiler_get_durations(mc_WgProfiler* profiler) {
+    return profiler ? profiler->durations : NULL;
+}
+
+mc_WgProfileSummary mc_wg_profiler_get_summary(mc_WgProfiler* profiler) {
+    mc_WgProfileSummary summary = {0};
+    if (!profiler || !profiler->wgCount) return summary;
+
+    uint64_t count = profiler->wgCount;
+    uint64_t* sorted = malloc(sizeof *sorted * count);
+    memcpy(sorted, profiler->durations, sizeof *sorted * count);
+    qsort(sorted, count, sizeof *sorted, mc_compare_u64);
+
+    double sum = 0.0;
+    double sumSq = 0.0;
+    for (uint64_t i = 0; i < count; i++) {
+        sum += (double)sorted[i];
+        sumSq += (double)sorted[i] * (double)sorted[i];
+    }
+
+    summary.wgCount = count;
+    summary.min = sorted[0];
+    summary.median = sorted[count / 2];
+    summary.p99 = sorted[(count - 1) * 99 / 100];
+    summary.max = sorted[count - 1];
+    summary.mean = sum / count;
+    double variance = sumSq / count - summary.mean * summary.mean;
+    summary.stddev = variance > 0.0 ? sqrt(variance) : 0.0;
+    summary.imbalance = summary.mean > 0.0 ? summary.max / summary.mean : 1.0;
+
+    free(sorted);
+    return summary;
+}
+
+bool mc_wg_profiler_write_heatmap(
+    mc_WgProfiler* profiler,
+    const char* filename
+) {
+    if (!profiler) return false;
+    if (!profiler->wgCount) {
+        ERROR(profiler, "the profiler has not been run");
+        return false;
+    }
+
+    FILE* fp = fopen(filename, "wb");
+    if (!fp) {
+        ERROR(profiler, "failed to open %s", filename);
+        return false;
+    }
+
+    // z slices are stacked vertically
+    uint32_t width = profiler->dim[0];
+    uint64_t height = (uint64_t)profiler->dim[1] * profiler->dim[2];
+    fprintf(fp, "P6\n%u %" PRIu64 "\n255\n", width, height);
+
+    uint64_t max = 1;
+    for (uint64_t i = 0; i < profiler->wgCount; i++)
+        if (profiler->durations[i] > max) max = profiler->durations[i];
+
+    // black -> red -> yellow -> white
+    unsigned char* pixels = malloc(3 * profiler->wgCount);
+    for (uint64_t i = 0; i < profiler->wgCount; i++) {
+        double t = 3.0 * profiler->durations[i] / max;
+        for (uint32_t c = 0; c < 3; c++) {
+            double v = t - c;
+            pixels[3 * i + c] = v <= 0.0 ? 0 : v >= 1.0 ? 255 : v * 255.0;
+        }
+    }
+
+    bool ok = fwrite(pixels, 3, profiler->wgCount, fp) == profiler->wgCount;
+    ok = fclose(fp) == 0 && ok;
+    free(pixels);
+
+    if (!ok) ERROR(profiler, "failed to write %s", filename);
+    return ok;
+}
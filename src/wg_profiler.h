@@ -0,0 +1,19 @@
+#ifndef MC_WG_PROFILER_H
+#define MC_WG_PROFILER_H
+
+#include "microcompute.h"
+#include "microcompute_extra.h"
+
+struct mc_WgProfiler {
+    mc_Instance* _instance;
+    mc_Device* device;
+    mc_ProgramCode* code;
+    mc_Program* program;
+    uint32_t buffCount;
+    uint32_t dim[3];   // of the last run
+    uint64_t wgCount;  // of the last run
+    uint64_t* durations;
+    mc_HBuffer* times; // (start, end) clock values, per workgroup
+};
+
+#endif // MC_WG_PROFILER_H
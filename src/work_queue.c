@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "device.h"
+#include "hybrid_buffer.h"
+#include "log.h"
+#include "work_queue.h"
+
+mc_WorkQueue* mc_work_queue_create(mc_Device* device, uint32_t capacity) {
+    if (!device) return NULL;
+
+    mc_WorkQueue* queue = malloc(sizeof *queue);
+    *queue = (mc_WorkQueue){
+        ._instance = device->_instance,
+        .device = device,
+        .capacity = 1,
+        .buff = NULL,
+    };
+
+    // the capacity must be a power of two, so that slots can be masked
+    while (queue->capacity < capacity && queue->capacity < (1u << 31))
+        queue->capacity <<= 1;
+
+    DEBUG(queue, "creating work queue, capacity: %d", queue->capacity);
+
+    uint64_t size = sizeof(uint32_t)
+                  * (MC_WORK_QUEUE_HEADER_SIZE + 2 * (uint64_t)queue->capacity);
+    queue->buff = mc_hybrid_buffer_create(device, size);
+    if (!queue->buff || !mc_work_queue_reset(queue, 0, NULL)) {
+        mc_work_queue_destroy(queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+void mc_work_queue_destroy(mc_WorkQueue* queue) {
+    if (!queue) return;
+    DEBUG(queue, "destroying work queue");
+    mc_hybrid_buffer_destroy(queue->buff);
+    free(queue);
+}
+
+mc_Buffer* mc_work_queue_get_buffer(mc_WorkQueue* queue) {
+    return queue ? &queue->buff->gpuBuff : NULL;
+}
+
+uint32_t mc_work_queue_get_capacity(mc_WorkQueue* queue) {
+    return queue ? queue->capacity : 0;
+}
+
+bool mc_work_queue_reset(mc_WorkQueue* queue, uint32_t count, uint32_t* items) {
+    if (!queue) return false;
+    if (count > queue->capacity) {
+        ERROR(queue, "too many initial items");
+        return false;
+    }
+
+    // all slots are rewritten, so that stale sequence numbers from a previous
+    // run cannot be mistaken for published items
+    uint64_t words = MC_WORK_QUEUE_HEADER_SIZE + 2 * (uint64_t)queue->capacity;
+    uint32_t* data = calloc(words, sizeof *data);
+
+    data[0] = 0;                   // head
+    data[1] = count;               // tail
+    data[2] = count;               // pending
+    data[3] = queue->capacity - 1; // mask
+    data[4] = 0;                   // overflow
+
+    uint32_t* slots = &data[MC_WORK_QUEUE_HEADER_SIZE];
+    for (uint32_t i = 0; i < count; i++) {
+        slots[2 * i] = i + 1;
+        slots[2 * i + 1] = items[i];
+    }
+
+    uint64_t size = sizeof *data * words;
+    uint64_t res = mc_hybrid_buffer_write(queue->buff, 0, size, data);
+    free(data);
+    return res == size;
+}
+
+uint32_t mc_work_queue_get_launch_size(mc_WorkQueue* queue, uint32_t wgSize) {
+    if (!queue) return 0;
+    mc_Device* device = queue->device;
+
+    // persistent workgroups only help while they are resident, so launch
+    // roughly as many invocations as the device can keep in flight (vulkan
+    // does not expose the number of compute units, so this is an estimate)
+    uint64_t invocations = device->maxWgSizeTotal;
+    if (device->type != MC_DEVICE_TYPE_CPU) invocations *= 64;
+
+    uint64_t count = invocations / (wgSize ? wgSize : 1);
+    if (count < 1) count = 1;
+    if (count > device->maxWgCount[0]) count = device->maxWgCount[0];
+    return (uint32_t)count;
+}
+
+static bool mc_work_queue_read_header(mc_WorkQueue* queue, uint32_t* header) {
+    uint64_t size = sizeof *header * MC_WORK_QUEUE_HEADER_SIZE;
+    return mc_hybrid_buffer_read(queue->buff, 0, size, header) == size;
+}
+
+uint32_t mc_work_queue_get_pending(mc_WorkQueue* queue) {
+    uint32_t header[MC_WORK_QUEUE_HEADER_SIZE];
+    if (!queue || !mc_work_queue_read_header(queue, header)) return 0;
+    return header[2];
+}
+
+bool mc_work_queue_has_overflowed(mc_WorkQueue* queue) {
+    uint32_t header[MC_WORK_QUEUE_HEADER_SIZE];
+    if (!queue || !mc_work_queue_read_header(queue, header)) return false;
+    return header[4] != 0;
+}
@@ -0,0 +1,17 @@
+#ifndef MC_WORK_QUEUE_H
+#define MC_WORK_QUEUE_H
+
+#include "microcompute_extra.h"
+
+// the number of uint32_t before the slots in the queue buffer, see
+// `microcompute/work_queue.glsl`
+#define MC_WORK_QUEUE_HEADER_SIZE 8
+
+struct mc_WorkQueue {
+    mc_Instance* _instance;
+    mc_Device* device;
+    uint32_t capacity;
+    mc_HBuffer* buff;
+};
+
+#endif // MC_WORK_QUEUE_H